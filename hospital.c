@@ -1,13 +1,65 @@
+// Expose the POSIX and BSD interfaces (mmap, madvise, rwlocks, recursive mutexes) in strict C modes
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <time.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define fsync _commit          // Flush a file's data to disk
+#define ftruncate _chsize      // Cut a file down to a given size
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>         // SSE2 compares for the patient query kernels
+#endif
+
+// Define the size of the fixed-size medication list embedded in patient records written by earlier versions
+#define LEGACY_MAX_MEDICATIONS 10    // Number of medication slots in an old patient record
+
+// Define the size of the chunks used by the record tables (a power of two so lookups are a shift and a mask)
+#define TABLE_CHUNK_SHIFT 6                        // Each chunk holds 2^6 = 64 records
+#define TABLE_CHUNK_SIZE (1 << TABLE_CHUNK_SHIFT)  // Number of records stored in each chunk
+
+// Structure to represent a growable table of fixed-size records
+
+/*
+ * Structure to represent a growable table of fixed-size records.
+ * Records are stored in separately allocated chunks of TABLE_CHUNK_SIZE records, so:
+ * - The table only grows by whole chunks when a record is added past the end, and only pays for chunks in use.
+ * - Existing chunks are never moved, so a pointer to a record stays valid while the table grows.
+ * - A table loaded from a data file starts with 'mappedCount' records that stay inside the memory-mapped
+ *   file; they are only read from disk when first touched, and changing them never writes to the file.
+ * - Record 'i' past the mapped records lives in chunk (i - mappedCount) >> TABLE_CHUNK_SHIFT.
+ */
 
-// Define maximum limits for various entities such as doctors, patients, medications, and appointments
-#define MAX_DOCTORS 100       // Maximum number of doctors allowed in the system
-#define MAX_PATIENTS 300      // Maximum number of patients the system can handle
-#define MAX_MEDICATIONS 10    // Maximum number of medications a single patient can have
-#define MAX_APPOINTMENTS 100  // Maximum number of appointments that can be scheduled
-#define MAX_STAFF 100         // Maximum number of staff members that can be added to the system
+typedef struct {
+    size_t recordSize;   // Size in bytes of a single record
+    char **chunks;       // Array of pointers to the allocated chunks
+    int chunkCount;      // Number of chunks allocated so far
+    int chunkCapacity;   // Number of chunk pointers the 'chunks' array can hold
+    char *mapped;        // Records mapped from a data file, or NULL
+    int mappedCount;     // Number of records in the mapped region
+} RecordTable;
 
 // Structure to represent an appointment
 
@@ -16,33 +68,172 @@
  * This struct stores information related to an appointment, including:
  * - patientID: The ID of the patient associated with the appointment.
  * - doctorID: The ID of the doctor associated with the appointment.
- * - appointmentDate: The date of the appointment in the format YYYY-MM-DD.
+ * - date: The date of the appointment as a day number (days since 1970-01-01, see parseDate).
+ * - slot: The time slot of the appointment within the doctor's day (see CALENDAR_SLOTS), or NO_SLOT.
  */
 
 typedef struct {
     int patientID;                  // ID of the patient associated with the appointment
     int doctorID;                   // ID of the doctor associated with the appointment
-    char appointmentDate[20];       // Appointment date in the format YYYY-MM-DD
+    int date;                       // Appointment date as a day number
+    int slot;                       // Time slot within the day, or NO_SLOT
 } Appointment;
 
-// Global array to store appointments and a counter to track the total number of appointments
-Appointment appointments[MAX_APPOINTMENTS];
+// Settings for the doctors' appointment calendars
+#define CALENDAR_DAY_START (8 * 60)  // Start of the first slot, in minutes since midnight (08:00)
+#define CALENDAR_SLOT_MINUTES 30     // Length of each slot in minutes
+#define CALENDAR_SLOTS 20            // Number of slots in a day (08:00-18:00); at most 32 fit in a bitmap
+#define CALENDAR_FULL_DAY ((unsigned int)((1ull << CALENDAR_SLOTS) - 1))  // Bitmap of a fully booked day
+#define CALENDAR_SEARCH_DAYS 30      // Number of days searched for a free slot when a day is full
+#define NO_SLOT -1                   // Slot of appointments that are not on the calendar
+
+#define INVALID_DATE INT_MIN  // Returned by parseDate for text that is not a valid date
+
+// Settings for the columnar appointment store
+#define APPOINTMENT_STORE_FILE "appointments.dat"  // Name of the appointment store file
+#define APPOINTMENT_STORE_MAGIC "HMSAPPT"          // First 8 bytes of the file (including the null character)
+#define APPOINTMENT_STORE_VERSION 2                // Version of the file layout
+#define APPOINTMENT_COLUMNS 4                      // Number of columns (patient, doctor, date, slot)
+#define APPOINTMENT_BLOCK_ROWS 4096                // Number of rows in each block
+#define APPOINTMENT_HEADER_SIZE 64                 // Bytes reserved for the header at the start of the file
+#define APPOINTMENT_BLOCK_BYTES (APPOINTMENT_COLUMNS * APPOINTMENT_BLOCK_ROWS * (int)sizeof(int))
+
+// Columns of the appointment store
+enum { APPOINTMENT_COLUMN_PATIENT, APPOINTMENT_COLUMN_DOCTOR, APPOINTMENT_COLUMN_DATE, APPOINTMENT_COLUMN_SLOT };
+
+#define APPOINTMENT_LEGACY_COLUMNS 3  // Number of columns in version 1 files, which had no slot column
+
+// Structure to represent the header of the appointment store
+
+/*
+ * Structure to represent the header of the appointment store.
+ * The store keeps appointments in columns rather than rows: after the header, the file is a sequence of
+ * blocks, and each block holds APPOINTMENT_BLOCK_ROWS patient IDs, then as many doctor IDs, dates and
+ * slots. A scan that filters on one column only has to read that column.
+ */
+
+typedef struct {
+    char magic[8];             // APPOINTMENT_STORE_MAGIC
+    unsigned int version;      // Layout version of the file
+    unsigned int columnCount;  // Number of columns in each block
+    unsigned int blockRows;    // Number of rows in each block
+    unsigned int rowCount;     // Number of appointments stored
+} AppointmentStoreHeader;
+
+// Structure to hold the state of the open appointment store
+typedef struct {
+    FILE *file;        // The store file, or NULL until it exists
+    char *map;         // Shared read-only mapping of the file's blocks
+    size_t mapSize;    // Size of the mapping in bytes
+    int blockCount;    // Number of blocks allocated in the file
+    int unsynced;      // 1 if rows were appended since the last sync
+    int damaged;       // 1 if the file is damaged and could not be moved aside, so it must not be recreated
+#ifdef _WIN32
+    int cachedBlock;                                           // Block held in 'cache'
+    int cachedColumnValid[APPOINTMENT_COLUMNS];                // 1 for each column of the block that was read
+    int cache[APPOINTMENT_COLUMNS][APPOINTMENT_BLOCK_ROWS];    // Columns of the cached block
+#endif
+} AppointmentStore;
+
+// The appointment store and the total number of appointments it holds
+AppointmentStore appointmentStore;
 int appointmentCount = 0;
 
-// Structure to represent medication details
+// Structure to represent one entry of a per-doctor or per-patient appointment list
+typedef struct {
+    int date;         // Date of the appointment as a day number
+    int appointment;  // Position of the appointment in the appointment store
+} DatePosting;
+
+// Structure to represent the appointments of one doctor or patient, sorted by date
+typedef struct {
+    DatePosting *entries;  // Array of entries sorted by date, then by appointment number
+    int count;             // Number of entries in use
+    int capacity;          // Number of entries allocated
+} PostingList;
+
+// Structure to represent a date index over the appointments of each doctor or patient
+
+/*
+ * Structure to represent a date index over one ID column of the appointment store.
+ * The index keeps one posting list per doctor (or patient), holding that doctor's appointments sorted
+ * by date. Finding a doctor's appointments in a range of dates is then a binary search for the first
+ * date followed by a walk over the matching entries, instead of a scan of the whole store.
+ * - column: The store column holding the ID (APPOINTMENT_COLUMN_DOCTOR or APPOINTMENT_COLUMN_PATIENT).
+ * - lists, listCount: One posting list for each ID from 0 to listCount - 1.
+ * - stale: Set when the store was opened; the index is built from the store on its first query,
+ *   so loading data never has to read every appointment up front.
+ */
+
+typedef struct {
+    int column;         // Store column holding the ID the index is keyed on
+    PostingList *lists; // Posting list of each ID
+    int listCount;      // Number of posting lists allocated
+    int stale;          // 1 if the index must be rebuilt before its next use
+} AppointmentIndex;
+
+// Global date indexes of the appointments of each doctor and each patient
+AppointmentIndex doctorAppointmentIndex = {APPOINTMENT_COLUMN_DOCTOR, NULL, 0, 1};
+AppointmentIndex patientAppointmentIndex = {APPOINTMENT_COLUMN_PATIENT, NULL, 0, 1};
+
+// Structure to represent one day of a doctor's calendar
+typedef struct {
+    int doctorID;        // ID of the doctor, or -1 if the entry is empty
+    int date;            // Date as a day number
+    unsigned int slots;  // Bitmap of the booked slots (bit i is slot i)
+} CalendarDay;
+
+// Structure to represent the calendars of all doctors
+
+/*
+ * Structure to represent the calendars of all doctors.
+ * Each (doctor, date) pair with at least one booking has an entry holding a bitmap of its booked slots,
+ * found through an open-addressing hash table, so checking or reserving a slot and measuring a day's
+ * utilisation each take O(1) time. Like the date indexes, the calendar is built from the appointment
+ * store on first use.
+ */
+
+typedef struct {
+    CalendarDay *days;  // Hash table of calendar days
+    int capacity;       // Number of entries (a power of two)
+    int used;           // Number of entries in use
+    int stale;          // 1 if the calendar must be rebuilt before its next use
+} DoctorCalendar;
+
+// Global calendar of the doctors' booked slots
+DoctorCalendar doctorCalendar = {NULL, 0, 0, 1};
+
+// Structures of the medication catalog
 
 /*
- * Structure to represent medication details.
- * This struct stores details about a medication, including:
- * - name: The name of the medication (e.g., Paracetamol).
- * - dosage: The dosage of the medication (e.g., 500mg).
+ * Structures of the medication catalog.
+ * Every distinct medication name and every distinct dosage is stored once, in the medication table and
+ * the dosage table, and patients refer to them by index:
+ * - Medication: The name of a medication (e.g., Paracetamol).
+ * - Dosage: A dosage parsed into an amount and a unit (e.g., 500 and mg). 'text' is the normalized
+ *   dosage ("500 mg"), which is the key the dosage is found by. A dosage that does not start with
+ *   a number (e.g., "as needed") keeps its text, with an amount of -1 and no unit.
+ * - Prescription: One medication assigned to a patient. A patient's prescriptions form a linked list
+ *   through the shared prescription table, like a staff member's shifts, so a patient can have any
+ *   number of medications and pays 12 bytes for each.
  */
 
 typedef struct {
     char name[100];  // Name of the medication
-    char dosage[50]; // Dosage of the medication
 } Medication;
 
+typedef struct {
+    char text[50];   // Normalized dosage (e.g., 500 mg)
+    double amount;   // Amount of the dosage, or -1 if the dosage has no amount
+    char unit[40];   // Unit of the amount (e.g., mg)
+} Dosage;
+
+typedef struct {
+    int next;          // Index of the patient's next prescription, or -1
+    int medicationID;  // Medication (index into the medication table)
+    int dosageID;      // Dosage (index into the dosage table)
+} Prescription;
+
 // Structure to store information about doctors
 
 /*
@@ -71,8 +262,13 @@ typedef struct {
  * - diagnosis: The patient's medical condition or diagnosis (e.g., Flu).
  * - roomNumber: The room number assigned to the patient (e.g., 101).
  * - doctorID: The ID of the doctor treating the patient (e.g., 2).
- * - medications: An array of medications assigned to the patient.
+ * - firstMedication, lastMedication: The first and last prescriptions of the patient in the prescription table (-1 if none).
  * - medicationCount: A counter to track the number of medications assigned to the patient.
+ * - id: The patient's stable ID. IDs are handed out in increasing order and never reused, so appointments
+ *   and journal records can refer to a patient by ID while the patient's slot in the table changes.
+ *   A slot whose patient was removed has an ID of -1 (a tombstone) until it is reused or compacted away.
+ * - admissionDate: The day the patient was admitted, as a day number, used to charge the stay. Patients
+ *   saved before admission dates were recorded load with 0 and are charged for a single day.
  */
 
 typedef struct {
@@ -80,29 +276,80 @@ typedef struct {
     int age;                   // Patient's age
     char diagnosis[100];       // Patient's diagnosis or medical condition
     int roomNumber;            // Room number assigned to the patient
-    int doctorID;              // ID of the doctor treating the patient
-    Medication medications[MAX_MEDICATIONS]; // List of medications assigned to the patient
+    int doctorID;              // ID of the doctor treating the patient (-1 if the doctor's data was lost)
+    int firstMedication;       // Index of the first prescription in the prescription table, or -1
+    int lastMedication;        // Index of the last prescription in the prescription table, or -1
     int medicationCount;       // Counter to track the number of medications assigned
+    int id;                    // Stable ID of the patient, or -1 if the slot is free
+    int admissionDate;         // Day number the patient was admitted on, or 0 if it was not recorded
 } Patient;
 
+// Structures describing the patient records written by earlier versions of the program
+
+/*
+ * Structures describing the patient records written by earlier versions of the program.
+ * Earlier versions stored up to LEGACY_MAX_MEDICATIONS medications as text inside every patient record.
+ * Records without IDs end at 'id', and records without admission dates at 'admissionDate'.
+ * These layouts are only used to read and convert old patients.dat files.
+ */
+
+typedef struct {
+    char name[100];   // Name of the medication
+    char dosage[50];  // Dosage of the medication
+} LegacyMedication;
+
+typedef struct {
+    char name[100];                                        // Patient's name
+    int age;                                               // Patient's age
+    char diagnosis[100];                                   // Patient's diagnosis
+    int roomNumber;                                        // Room number assigned to the patient
+    int doctorID;                                          // ID of the doctor treating the patient
+    LegacyMedication medications[LEGACY_MAX_MEDICATIONS];  // Fixed array holding the medications
+    int medicationCount;                                   // Number of medications in use
+    int id;                                                // Stable ID of the patient
+    int admissionDate;                                     // Day number the patient was admitted on
+} LegacyPatient;
+
+#define LEGACY_PATIENT_SIZE offsetof(LegacyPatient, id)  // Size of a patient record before IDs were added
+
+// Days of the week, numbered in the order used by the reports (Sunday first)
+typedef enum { SUNDAY, MONDAY, TUESDAY, WEDNESDAY, THURSDAY, FRIDAY, SATURDAY } Weekday;
+
+const char *const weekdayNames[] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+
 // Structure to define shifts for staff members
 
 /*
  * Structure to define shifts for staff members.
+ * Shifts live in one shared shift table and each staff member's shifts form a linked list through it,
+ * so a staff member can have any number of shifts and pays nothing for shifts they don't have.
  * This struct stores details about a shift for a staff member, including:
- * - day: The day of the week the shift is scheduled (e.g., Monday, Tuesday).
- * - startTime: The start time of the shift (e.g., 09:00 AM).
- * - endTime: The end time of the shift (e.g., 05:00 PM).
- * - role: The role assigned during the shift (e.g., Nurse, Admin).
+ * - next: The index of the staff member's next shift in the shift table, or -1 for the last one.
+ * - day: The day of the week the shift is scheduled (e.g., MONDAY).
+ * - startTime: The start time of the shift in minutes since midnight (e.g., 540 for 09:00).
+ * - endTime: The end time of the shift in minutes since midnight (e.g., 1020 for 17:00).
+ * - roleID: The role assigned during the shift, as an index into the role table (e.g., Nurse).
  */
 
 typedef struct {
-    char day[20];         // Day of the week for the shift (e.g., Monday, Tuesday)
-    char startTime[10];   // Start time of the shift (e.g., 09:00)
-    char endTime[10];     // End time of the shift (e.g., 17:00)
-    char role[50];        // Role assigned during the shift (e.g., Nurse, Admin)
+    int next;             // Index of the next shift of the same staff member, or -1
+    short startTime;      // Start time of the shift in minutes since midnight
+    short endTime;        // End time of the shift in minutes since midnight
+    short roleID;         // Role assigned during the shift (index into the role table)
+    unsigned char day;    // Day of the week for the shift (a Weekday value)
 } Shift;
 
+// Structure to store the name of a role used by shifts
+
+/*
+ * Structure to store the name of a role used by shifts.
+ * Every distinct role name is stored once in the role table and shifts refer to it by index.
+ */
+
+typedef struct {
+    char name[50];  // Name of the role (e.g., Nurse, Admin)
+} Role;
+
 // Structure to store information about staff members
 
 /*
@@ -111,7 +358,7 @@ typedef struct {
  * - name: The name of the staff member (e.g., Alice Johnson).
  * - role: The role of the staff member (e.g., Nurse, Admin).
  * - contactInfo: The contact information for the staff member (e.g., phone number or email).
- * - schedule: An array of shifts assigned to the staff member.
+ * - firstShift, lastShift: The first and last shifts of the staff member in the shift table (-1 if none).
  * - shiftCount: A counter to track the number of shifts assigned to the staff member.
  */
 
@@ -119,40 +366,1225 @@ typedef struct {
     char name[100];          // Name of the staff member
     char role[50];           // Role of the staff member (e.g., Nurse, Admin)
     char contactInfo[100];   // Contact information (e.g., phone or email)
-    Shift schedule[MAX_APPOINTMENTS]; // Array to hold the staff member's shift schedule
+    int firstShift;          // Index of the first shift in the shift table, or -1
+    int lastShift;           // Index of the last shift in the shift table, or -1
     int shiftCount;          // Counter to track the number of shifts assigned
 } Staff;
 
-// Global arrays to store doctors, patients, and staff
-Doctor doctors[MAX_DOCTORS];      // Array to store doctor information
-Patient patients[MAX_PATIENTS];  // Array to store patient information
-Staff staff[MAX_STAFF];          // Array to store staff information
+// Structures describing the staff records written by earlier versions of the program
+
+/*
+ * Structures describing the staff records written by earlier versions of the program.
+ * Earlier versions stored every shift as text inside a fixed array of 100 shifts per staff member.
+ * These layouts are only used to read and convert old staff.dat files.
+ */
+
+typedef struct {
+    char day[20];         // Day of the week for the shift (e.g., Monday)
+    char startTime[10];   // Start time of the shift (e.g., 09:00)
+    char endTime[10];     // End time of the shift (e.g., 17:00)
+    char role[50];        // Role assigned during the shift
+} LegacyShift;
+
+typedef struct {
+    char name[100];              // Name of the staff member
+    char role[50];               // Role of the staff member
+    char contactInfo[100];       // Contact information
+    LegacyShift schedule[100];   // Fixed array holding the shift schedule
+    int shiftCount;              // Number of shifts in use
+} LegacyStaff;
+
+// Global tables to store doctors, patients, and staff
+RecordTable doctorTable = {sizeof(Doctor), NULL, 0, 0, NULL, 0};    // Table to store doctor information
+RecordTable patientTable = {sizeof(Patient), NULL, 0, 0, NULL, 0};  // Table to store patient information
+RecordTable staffTable = {sizeof(Staff), NULL, 0, 0, NULL, 0};      // Table to store staff information
+RecordTable shiftTable = {sizeof(Shift), NULL, 0, 0, NULL, 0};      // Table shared by the shifts of all staff
+RecordTable roleTable = {sizeof(Role), NULL, 0, 0, NULL, 0};        // Table of the distinct shift role names
+RecordTable medicationTable = {sizeof(Medication), NULL, 0, 0, NULL, 0};      // Table of the distinct medication names
+RecordTable dosageTable = {sizeof(Dosage), NULL, 0, 0, NULL, 0};              // Table of the distinct dosages
+RecordTable prescriptionTable = {sizeof(Prescription), NULL, 0, 0, NULL, 0};  // Table shared by the prescriptions of all patients
 
 // Counters to track the total number of doctors, patients, and staff
 int doctorCount = 0;   // Total number of doctors
 int patientCount = 0;  // Total number of patients
+int patientSlotCount = 0;  // Number of slots used in the patient table, including free ones
 int staffCount = 0;    // Total number of staff
+int shiftCount = 0;    // Total number of shifts across all staff
+int roleCount = 0;     // Total number of distinct shift roles
+int medicationCatalogCount = 0;  // Total number of distinct medication names
+int dosageCount = 0;             // Total number of distinct dosages
+int prescriptionCount = 0;       // Number of records used in the prescription table
+int unlinkedPrescriptions = 0;   // Records of the prescription table left behind by removed patients
+
+// Structure to map stable patient IDs to slots in the patient table
+
+/*
+ * Structure to map stable patient IDs to slots in the patient table.
+ * Removing a patient only marks its slot free (a tombstone) and pushes the slot on the free list, so removal
+ * and lookup by ID both take O(1) time and every other patient keeps its slot. New patients reuse free
+ * slots first; compactPatients closes the remaining gaps when the program is idle.
+ * - slots: The slot of each ID, or -1 for IDs of removed patients.
+ * - nextID: The ID the next new patient receives. It is saved with the patients so IDs are never reused.
+ * - freeSlots: The free slots of the table.
+ * - stale: Set when the patients were loaded; the map is built on its first use.
+ */
+
+typedef struct {
+    int *slots;         // Slot of each patient ID
+    int capacity;       // Number of IDs the 'slots' array can hold
+    int nextID;         // ID of the next new patient
+    int *freeSlots;     // Stack of free slots in the patient table
+    int freeCount;      // Number of free slots on the stack
+    int freeCapacity;   // Number of slots the 'freeSlots' array can hold
+    int stale;          // 1 if the map must be rebuilt before its next use
+} PatientIDMap;
+
+PatientIDMap patientIDs = {NULL, 0, 0, NULL, 0, 0, 0};
+
+#define PATIENT_COMPACT_FRACTION 8  // Compact when at least 1/8 of the patient slots are free
+
+// Structure to hold the patient fields that queries filter on, one array per field
+
+/*
+ * Structure to hold the patient fields that queries filter on, one array per field (struct of arrays).
+ * Entry 'i' of each array mirrors slot 'i' of the patient table, so a query streams 16 bytes per patient
+ * instead of touching each whole Patient record. The arrays are updated by insertPatient, deletePatient
+ * and compactPatients through patientColumnsSet.
+ * - ids: The patient's ID, or -1 for a free slot.
+ * - stale: Set when the patients were loaded; the columns are built on their first use.
+ */
+
+typedef struct {
+    int *ages;          // Age of the patient in each slot
+    int *rooms;         // Room number of the patient in each slot
+    int *doctors;       // Doctor ID of the patient in each slot
+    int *ids;           // ID of the patient in each slot, or -1
+    int count;          // Number of slots mirrored
+    int capacity;       // Number of slots the arrays can hold
+    int stale;          // 1 if the columns must be rebuilt before their next use
+} PatientColumns;
+
+PatientColumns patientColumns = {NULL, NULL, NULL, NULL, 0, 0, 1};
+
+// Structure to hold the limits of a patient query; every limit is inclusive
+typedef struct {
+    int minAge, maxAge;    // Range of ages (INT_MIN and INT_MAX for any)
+    int minRoom, maxRoom;  // Range of room numbers
+    int doctorID;          // Doctor the patients are assigned to, or -1 for any
+} PatientQuery;
+
+// Structure to hold a growable array of counts indexed by a record ID
+typedef struct {
+    int *counts;        // Count for each ID
+    int capacity;       // Number of IDs the array can hold
+} CountArray;
+
+// Structure to hold the aggregates shown in the summary of generateReport
+
+/*
+ * Structure to hold the aggregates shown in the summary of generateReport.
+ * The aggregates are updated by insertStaff, insertShift, insertPatient and deletePatient as the data
+ * changes, so the summary never has to scan the staff, shifts or patients:
+ * - staffWithNoShifts / shiftsPerDay: Staff members without shifts and shifts on each day of the week.
+ * - shiftsPerRole / staffPerRole: Shifts and staff members per role, indexed by the role's index in the
+ *   role table (staff roles are added to the role table as they are counted).
+ * - patientsPerDoctor: Patients assigned to each doctor, indexed by doctor ID.
+ * The number of occupied rooms comes from the room inventory (see RoomInventory).
+ * - stale: Set until the aggregates are first built from the loaded data; updates are skipped while it is set.
+ */
+
+typedef struct {
+    int staffWithNoShifts;         // Number of staff members without shifts
+    int shiftsPerDay[7];           // Number of shifts on each day of the week
+    CountArray shiftsPerRole;      // Number of shifts per role
+    CountArray staffPerRole;       // Number of staff members per role
+    CountArray patientsPerDoctor;  // Number of patients per doctor
+    int stale;                     // 1 if the aggregates must be rebuilt before their next use
+} ReportAggregates;
+
+ReportAggregates reportAggregates = {0, {0}, {NULL, 0}, {NULL, 0}, {NULL, 0}, 1};
+
+// Settings for the billing engine
+#define RATES_FILE "rates.txt"          // Optional file holding the billing rates
+#define DEFAULT_ROOM_RATE 100           // Daily rate of rooms outside every room class
+#define BILLING_MAX_THREADS 16          // Largest number of threads computing invoices
+#define BILLING_BLOCK_SIZE 65536        // Number of patient slots billed before their invoices are written
+
+// Kinds of charges posted to a patient's account
+enum { CHARGE_DOCTOR, CHARGE_MEDICATION, CHARGE_APPOINTMENT, CHARGE_KIND_COUNT };
+
+// Structure to describe a class of rooms and its daily rate
+typedef struct {
+    int firstRoom;   // First room number of the class
+    int lastRoom;    // Last room number of the class
+    char name[20];   // Name of the class (e.g., Private)
+    int dailyRate;   // Charge for each day of stay
+    int beds;        // Number of beds in each room of the class
+} RoomClass;
+
+// Structure to hold the cost of one medication
+typedef struct {
+    char name[100];  // Name of the medication
+    int cost;        // Charge for assigning the medication
+} MedicationRate;
+
+// Structure to hold the billing rate tables
+
+/*
+ * Structure to hold the billing rate tables, read from RATES_FILE at startup (see loadBillingRates).
+ * Without the file a day of stay costs DEFAULT_ROOM_RATE and medications and appointments are free,
+ * so a patient admitted today is billed the room charge of 100 plus the doctor's fee as before.
+ * - roomClasses: Classes of rooms by range of room numbers, sorted by first room and not overlapping.
+ * - defaultRoomClass: The class of rooms outside every range.
+ * - medicationRates: Costs of medications by name, sorted by name.
+ */
+
+typedef struct {
+    RoomClass *roomClasses;            // Classes of rooms, sorted by first room
+    int roomClassCount;                // Number of room classes
+    RoomClass defaultRoomClass;        // Class of rooms outside every range
+    MedicationRate *medicationRates;   // Costs of medications, sorted by name
+    int medicationRateCount;           // Number of medication costs
+    int defaultMedicationCost;         // Cost of medications without a rate of their own
+    int appointmentFee;                // Charge for each appointment
+} BillingRates;
+
+// Global billing rates
+BillingRates billingRates = {NULL, 0, {0, INT_MAX, "General", DEFAULT_ROOM_RATE, 1}, NULL, 0, 0, 0};
+
+// Settings for the room inventory
+#define ROOM_NUMBER_LIMIT (1 << 24)  // Room numbers must be below this
+
+// Structure to hold the bed occupancy of every room
+
+/*
+ * Structure to hold the bed occupancy of every room, for rejecting double bookings and finding free beds.
+ * Each room has the number of beds of its class (see loadBillingRates). A room's bit in 'full' is set once
+ * all of its beds are taken, so checking a room is one bit test and finding a free room in a range scans
+ * 64 rooms per word. insertPatient and deletePatient update the inventory as patients are admitted and
+ * discharged.
+ * - occupied: Patients in each room number.
+ * - capacity: Room numbers covered (a multiple of 64); rooms past it are empty.
+ * - classOccupied: Occupied beds in each room class, with the rooms outside every class last.
+ * - occupiedRooms: Rooms with at least one patient, shown in the summary of generateReport.
+ * - stale: Set when the patients were loaded; the inventory is built on its first use.
+ */
+
+typedef struct {
+    unsigned long long *full;  // One bit per room number, set when every bed of the room is taken
+    int *occupied;             // Number of patients in each room
+    int capacity;              // Number of room numbers covered
+    int *classOccupied;        // Occupied beds per room class
+    int occupiedBeds;          // Occupied beds in all rooms
+    int occupiedRooms;         // Number of rooms with at least one patient
+    int stale;                 // 1 if the inventory must be rebuilt before its next use
+} RoomInventory;
+
+RoomInventory roomInventory = {NULL, NULL, 0, NULL, 0, 0, 1};
+
+// Structure to hold the charges posted to one patient's account
+typedef struct {
+    int charges[CHARGE_KIND_COUNT];  // Total charged for each kind of charge
+    int appointments;                // Number of appointments charged
+} BillingAccount;
+
+// Structure to hold the running totals of the patients' accounts
+
+/*
+ * Structure to hold the running totals of the patients' accounts, indexed by patient ID.
+ * Charges are posted as they happen: insertPatient posts the doctor's fee, insertMedication the cost of
+ * the medication and insertAppointment the appointment fee, so a bill is read off the account in O(1)
+ * time. The stay is not posted because it grows every day; it is charged when the bill is made.
+ * Like the name indexes, the ledger starts stale and is built from the loaded data on first use.
+ */
+
+typedef struct {
+    BillingAccount *accounts;  // Accounts indexed by patient ID
+    int capacity;              // Number of accounts allocated
+    int stale;                 // 1 if the ledger must be rebuilt before its next use
+} BillingLedger;
+
+// Global ledger of the patients' accounts
+BillingLedger billingLedger = {NULL, 0, 1};
+
+// Structure to hold one itemized bill
+typedef struct {
+    int patientID;                   // ID of the patient, or -1 for a free slot
+    const RoomClass *roomClass;      // Class of the patient's room
+    int days;                        // Days of stay charged, counting the day of admission
+    int roomCharge;                  // Charge for the stay
+    int charges[CHARGE_KIND_COUNT];  // Charges posted to the patient's account
+    int medications;                 // Number of medications assigned
+    int appointments;                // Number of appointments charged
+    int total;                       // Total of the bill
+} Invoice;
+
+// Structure to hold the range of patient slots billed by one thread
+typedef struct {
+    int first;          // First patient slot
+    int count;          // Number of slots
+    int today;          // Day number the stays are charged up to
+    Invoice *invoices;  // Invoice of each slot
+} BillingTask;
+
+// Structure to represent one slot of a name index
+
+/*
+ * Structure to represent one slot of a name index.
+ * - hash: The cached hash of the name stored in the slot, so most probes never call strcmp.
+ * - index: The index of the record in its table, or one of the NAME_SLOT_* markers below.
+ */
+
+#define NAME_SLOT_EMPTY -1    // The slot has never been used
+#define NAME_SLOT_DELETED -2  // The slot held a name that has since been removed
+
+typedef struct {
+    unsigned int hash;  // Cached hash of the record's name
+    int index;          // Index of the record in its table, or a NAME_SLOT_* marker
+} NameSlot;
+
+// Structure to represent a hash index over the 'name' field of a record table
+
+/*
+ * Structure to represent a hash index over the 'name' field of a record table.
+ * The index uses open addressing with linear probing. The names themselves are not copied;
+ * each lookup reads them straight out of the table, which is safe because table records never move.
+ * - table, count: The record table whose records are indexed and its record counter.
+ * - nameOffset: The offset of the name field inside a record.
+ * - slots: The array of hash slots (its capacity is always a power of two).
+ * - used: Number of slots holding a name or a deleted marker, used to decide when to grow.
+ * - stale: Set when the table was loaded or rearranged; the index is rebuilt on its next lookup,
+ *   so loading data never has to read every name up front.
+ */
+
+typedef struct {
+    RecordTable *table;  // Table holding the indexed records
+    size_t nameOffset;   // Offset of the name field inside a record
+    int *count;          // Counter holding the number of records in the table
+    const char *kind;    // Kind of record, used in messages (e.g., "doctor")
+    NameSlot *slots;     // Array of hash slots
+    int capacity;        // Number of slots (a power of two)
+    int used;            // Number of slots that are not empty
+    int stale;           // 1 if the index must be rebuilt before its next use
+} NameIndex;
+
+// Global name indexes used to look up doctors, patients, and staff by name
+NameIndex doctorNameIndex = {&doctorTable, offsetof(Doctor, name), &doctorCount, "doctor", NULL, 0, 0, 0};
+NameIndex patientNameIndex = {&patientTable, offsetof(Patient, name), &patientSlotCount, "patient", NULL, 0, 0, 0};
+NameIndex staffNameIndex = {&staffTable, offsetof(Staff, name), &staffCount, "staff", NULL, 0, 0, 0};
+NameIndex roleNameIndex = {&roleTable, offsetof(Role, name), &roleCount, "role", NULL, 0, 0, 0};
+NameIndex medicationNameIndex = {&medicationTable, offsetof(Medication, name), &medicationCatalogCount, "medication", NULL, 0, 0, 0};
+NameIndex dosageIndex = {&dosageTable, offsetof(Dosage, text), &dosageCount, "dosage", NULL, 0, 0, 0};
+
+// Structure to hold the IDs of the patients on one medication
+typedef struct {
+    int *patients;  // IDs of the patients, possibly with repeats and removed patients until the list is sorted
+    int count;      // Number of IDs in use
+    int capacity;   // Number of IDs allocated
+    int sorted;     // 1 while the IDs are in increasing order without repeats
+} PatientList;
+
+// Structure to represent the reverse index from medications to the patients on them
+
+/*
+ * Structure to represent the reverse index from medications to the patients on them.
+ * insertMedication adds the patient to the medication's list, and removed patients are dropped
+ * when a list is read, so finding the patients on a medication takes time proportional to their
+ * number rather than to the census. The index starts stale and is built on first use.
+ */
+
+typedef struct {
+    PatientList *lists;  // List of each medication, indexed by medication ID
+    int listCount;       // Number of lists allocated
+    int stale;           // 1 if the index must be rebuilt before its next use
+} MedicationIndex;
+
+// Global reverse index of the medication catalog
+MedicationIndex medicationIndex = {NULL, 0, 1};
+
+// Structure to hold the records whose text contains one trigram
+typedef struct {
+    int trigram;    // The three lowercase bytes packed into an int, or TRIGRAM_EMPTY
+    int *keys;      // Keys of the records, in increasing order
+    int count;      // Number of keys in use
+    int capacity;   // Number of keys allocated
+} TrigramList;
+
+#define TRIGRAM_EMPTY -1  // Marks an unused slot of a text index
+#define TEXT_START '\1'   // Padding put before a text so that its first characters form trigrams
+
+// Structure to represent a trigram index over a text field of a record table
+
+/*
+ * Structure to represent a trigram index over a text field of a record table, for prefix and substring search.
+ * Each text is lowercased and padded with two TEXT_START bytes, and the record's key is added to the list of
+ * every trigram (run of three bytes) in it. A search intersects the lists of the query's trigrams, then checks
+ * the few remaining records, so its cost depends on the number of matches rather than on the size of the table.
+ * - table, textOffset: The record table and the offset of the text field inside a record.
+ * - byPatientID: Set for patient fields, whose keys are patient IDs; otherwise keys are table indexes.
+ * - lists: Open-addressing hash table of trigram lists (its capacity is always a power of two).
+ * - added / removed: Keys added and keys of records removed since. Removed keys stay in the lists and are
+ *   skipped by the check; the index is rebuilt once they make up half of it.
+ * - stale: Set when the table was loaded; the index is built on its first search.
+ */
+
+typedef struct {
+    RecordTable *table;  // Table holding the indexed records
+    size_t textOffset;   // Offset of the text field inside a record
+    int byPatientID;     // 1 if the keys are patient IDs
+    TrigramList *lists;  // Hash table of trigram lists
+    int capacity;        // Number of slots in 'lists' (a power of two)
+    int used;            // Number of slots in use
+    int added;           // Number of records added
+    int removed;         // Number of records removed since they were added
+    int stale;           // 1 if the index must be rebuilt before its next use
+} TextIndex;
+
+// Fields that can be searched, and the text indexes over them
+enum { SEARCH_PATIENT_NAME, SEARCH_DIAGNOSIS, SEARCH_SPECIALTY, SEARCH_FIELD_COUNT };
+const char *const searchFieldNames[SEARCH_FIELD_COUNT] = {"name", "diagnosis", "specialty"};
+TextIndex textIndexes[SEARCH_FIELD_COUNT] = {
+    {&patientTable, offsetof(Patient, name), 1, NULL, 0, 0, 0, 0, 1},
+    {&patientTable, offsetof(Patient, diagnosis), 1, NULL, 0, 0, 0, 0, 1},
+    {&doctorTable, offsetof(Doctor, specialty), 0, NULL, 0, 0, 0, 0, 1}
+};
+
+// Kinds of match of a search; the 'I' kinds ignore case
+enum { SEARCH_PREFIX, SEARCH_CONTAINS, SEARCH_IPREFIX, SEARCH_ICONTAINS, SEARCH_MODE_COUNT };
+const char *const searchModeNames[SEARCH_MODE_COUNT] = {"prefix", "contains", "iprefix", "icontains"};
+
+// Results returned by the functions that change data
+typedef enum {
+    STATUS_OK,          // The change was made
+    STATUS_NOT_FOUND,   // A referenced doctor, patient or staff member does not exist
+    STATUS_DUPLICATE,   // The name is already used by another record
+    STATUS_INVALID,     // An argument is out of range or too long
+    STATUS_LIMIT,       // A per-record limit has been reached
+    STATUS_OCCUPIED,    // Every bed of the room is taken
+    STATUS_NO_MEMORY,   // Memory could not be allocated
+    STATUS_IO_ERROR,    // A file could not be written
+    STATUS_SYNTAX       // A batch command is unknown or its arguments cannot be parsed
+} Status;
+
+// Names of the statuses, as printed by the batch mode
+const char *const statusNames[] = {"OK", "NOT_FOUND", "DUPLICATE", "INVALID", "LIMIT", "OCCUPIED", "NO_MEMORY", "IO_ERROR", "SYNTAX"};
+
+// Settings for the output layer used by the listings
+#define OUTPUT_FLUSH_SIZE (64 * 1024)  // Buffered bytes that are written out at the end of a record
+#define OUTPUT_LINE_SIZE 512           // Longest piece of text written by one call
+#define OUTPUT_HEADER_SIZE 512         // Longest CSV header line
+
+// Formats of the listings
+typedef enum {
+    OUTPUT_TEXT,   // Labelled lines meant to be read on screen
+    OUTPUT_CSV,    // One comma-separated line per record, after a header line
+    OUTPUT_JSONL   // One JSON object per line
+} OutputFormat;
+
+// Structure to hold the state of the output layer
+
+/*
+ * Structure to hold the state of the output layer.
+ * The listings write their records through the output* functions, which collect them in 'buffer'
+ * and write the buffer to stdout in large blocks instead of making several stdio calls per record.
+ * Only the records numbered 'offset' to 'offset + limit - 1' of a listing are written (all records
+ * from 'offset' on when 'limit' is 0); the others are counted so the listing can show its size.
+ */
+
+typedef struct {
+    OutputFormat format;         // Format of the listings
+    int offset;                  // Number of records to skip at the start of a listing
+    int limit;                   // Largest number of records to write (0 for no limit)
+    char *buffer;                // Text waiting to be written
+    size_t used;                 // Number of bytes used in the buffer
+    size_t capacity;             // Number of bytes allocated for the buffer
+    int records;                 // Number of records started in the current listing
+    int inRecord;                // 1 between outputRecordBegin and outputRecordEnd
+    int visible;                 // 1 if the current record is written
+    int fieldCount;              // Number of fields written in the current record
+    int listItems;               // Number of items written in the current list field
+    size_t recordStart;          // Offset in the buffer where the current record starts
+    int headerWritten;           // 1 once the CSV header line has been written
+    char header[OUTPUT_HEADER_SIZE];  // CSV header line collected from the first record
+    size_t headerUsed;           // Number of bytes used in the header line
+    FILE *stream;                // File the listings are written to (stdout when NULL)
+} Output;
+
+// Names of the output formats, in the order of OutputFormat
+const char *const outputFormatNames[] = {"text", "csv", "jsonl"};
+
+// Mark a variable with one copy per thread (each client of the server mode has its own output settings)
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// Global output settings and buffer, shared by all listings of a thread
+THREAD_LOCAL Output output = {OUTPUT_TEXT, 0, 0, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0, "", 0, NULL};
+
+// Settings for the instrumentation
+#define STATS_BUCKETS 32                // Number of latency histogram buckets (powers of two of microseconds)
+#define STATS_MAX_OPERATIONS 64         // Largest number of instrumented operations
+#define MENU_CHOICE_COUNT 28            // Number of choices in the main menu
+
+// Slots of the instrumented operations: menu choice 'c' uses slot c - 1, then come these
+enum {
+    STATS_SAVE_DATA = MENU_CHOICE_COUNT,
+    STATS_SAVE_SNAPSHOT,
+    STATS_LOAD_DATA,
+    STATS_BATCH_FIRST                   // Batch command 'i' uses slot STATS_BATCH_FIRST + i
+};
+
+// I/O counters of the instrumentation
+enum { STATS_DATA_BYTES_READ, STATS_DATA_BYTES_WRITTEN, STATS_JOURNAL_BYTES_WRITTEN, STATS_COUNTER_COUNT };
+
+// Structure to hold the statistics of one instrumented operation
+typedef struct {
+    const char *kind;                 // Kind of operation ("menu", "io" or "batch")
+    const char *name;                 // Name of the operation
+    long long count;                  // Number of calls
+    long long totalNs;                // Total time of all calls in nanoseconds
+    long long maxNs;                  // Longest call in nanoseconds
+    int buckets[STATS_BUCKETS];       // Bucket b counts the calls that took less than 2^b microseconds
+} StatsOperation;
+
+// Structure to hold everything the instrumentation collects
+typedef struct {
+    int enabled;                                   // 1 while statistics are collected
+    const char *dumpPath;                          // File the statistics are appended to at exit, or NULL for stderr
+    StatsOperation operations[STATS_MAX_OPERATIONS];  // Statistics of each operation, by slot
+    long long counters[STATS_COUNTER_COUNT];       // I/O counters
+#ifndef _WIN32
+    pthread_mutex_t counterLock;                   // Lock on the counters, which several threads can add to at once
+#endif
+} Stats;
+
+// Global statistics (the lock is ready before collection is turned on, from the environment or the menu)
+#ifndef _WIN32
+Stats stats = {.counterLock = PTHREAD_MUTEX_INITIALIZER};
+#else
+Stats stats;
+#endif
+
+// Names of the main menu choices, in menu order
+const char *const menuNames[MENU_CHOICE_COUNT] = {
+    "Add Doctor", "Add Patient", "Assign Medication to Patient", "View Doctors", "View Patients",
+    "Schedule Appointment", "View Appointments", "Generate Report", "Save Data", "Add Staff",
+    "Assign Shift to Staff", "View Staff Schedules", "Remove Patient", "View Patient's Bill", "Exit",
+    "View Doctors Sorted", "View Patients Sorted", "Filter Appointments", "View Patient Appointment History",
+    "View Doctor Calendar", "Output Settings", "Import CSV File", "View Statistics", "Bill All Patients",
+    "Find Patients on a Medication", "Query Patients", "Search Records",
+    "Find Free Room"
+};
+
+// Settings for the bulk CSV import
+#define IMPORT_MAX_THREADS 16           // Largest number of threads parsing an import file
+#define IMPORT_MIN_CHUNK (1024 * 1024)  // Smallest number of bytes worth a thread of its own
+#define IMPORT_MAX_FIELDS 5             // Largest number of fields on a line
+#define IMPORT_REPORT_LIMIT 100         // Largest number of rejected lines reported one by one
+
+// Kinds of records that can be imported
+typedef enum { IMPORT_DOCTORS, IMPORT_PATIENTS, IMPORT_STAFF } ImportKind;
+
+// Names of the kinds of records that can be imported, in the order of ImportKind
+const char *const importKindNames[] = {"doctors", "patients", "staff"};
+
+// Structure to hold one parsed line of an import file
+typedef struct {
+    int line;                          // Line number, counted from the start of the chunk
+    const char *error;                 // Reason the row is rejected, or NULL if it is valid
+    char *fields[IMPORT_MAX_FIELDS];   // Fields of the line, pointing into the file's buffer
+    int numbers[2];                    // Age, and visiting fee or room number
+    int doctorID;                      // Doctor of a patient
+} ImportRow;
+
+// Structure to hold the part of an import file parsed by one thread
+typedef struct {
+    ImportKind kind;                   // Kind of records in the file
+    char *start;                       // First byte of the chunk
+    char *end;                         // Byte just past the chunk (the end of its last line)
+    int first;                         // 1 for the chunk at the start of the file
+    ImportRow *rows;                   // Parsed rows, in file order
+    int rowCount;                      // Number of rows parsed
+    int capacity;                      // Number of rows allocated
+    int lineCount;                     // Number of lines in the chunk, blank lines included
+    int failed;                        // 1 if memory ran out while parsing
+} ImportChunk;
+
+// Settings for the batch mode
+#define BATCH_BUFFER_SIZE (256 * 1024)  // Size of the read buffer, which also limits the length of a line
+#define BATCH_MAX_TOKENS 8              // Largest number of words on a command line
+#define BATCH_COMMIT_INTERVAL 4096      // Number of commands between journal commits
+
+// How a batch command uses the data, which decides the lock it takes in server mode
+enum {
+    BATCH_READ,                         // Only reads the data (runs alongside other reads)
+    BATCH_WRITE,                        // Changes the data (runs alone)
+    BATCH_SESSION                       // Only changes the settings of the client's session
+};
+
+// Settings for the server mode
+#define SERVER_MAX_THREADS 64           // Largest number of worker threads
+#define SERVER_QUEUE_SIZE 128           // Largest number of clients with commands waiting for a worker
+#define SERVER_MAX_CLIENTS 1024         // Largest number of connected clients
+#define SERVER_LINE_BUDGET 64           // Largest number of commands a worker runs for one client before serving others
+#define LOAD_TEST_FIRST_ROOM 8000000    // First room given to the patients added by the load test
+#define LOAD_TEST_ROOMS 8000000         // Number of rooms the load test uses
+
+// Settings for the benchmark mode
+#define BENCH_PER_DOCTOR 100            // Number of generated patients per doctor (and per staff member)
+#define BENCH_SHIFTS_PER_STAFF 3        // Number of generated shifts per staff member
+#define BENCH_REPEAT 5                  // Number of runs of the operations that work on all the data
+#define BENCH_SEARCHES 1000             // Number of searches timed
+#define BENCH_MAX_RESULTS 24            // Largest number of operations timed
+
+// Structure to hold the timings of one operation of the benchmark
+typedef struct {
+    const char *name;                 // Name of the operation
+    long long *samples;               // Latency of each call in nanoseconds, while the operation runs
+    int count;                        // Number of calls timed
+    long long total;                  // Total time of all calls in nanoseconds
+    long long p50;                    // Median latency in nanoseconds
+    long long p99;                    // 99th percentile latency in nanoseconds
+    long peakRss;                     // Peak resident set size in kilobytes
+} BenchResult;
+
+// Values used for the generated records, and the state of the benchmark's random numbers
+const char *const benchSpecialties[] = {"Cardiology", "Neurology", "Pediatrics", "Oncology"};
+const char *const benchDiagnoses[] = {"Flu", "Fracture", "Migraine", "Asthma"};
+const char *const benchRoles[] = {"Nurse", "Admin", "Porter"};
+unsigned int benchSeed = 1;
+
+// Structure to read a batch file line by line through a large buffer
+typedef struct {
+    FILE *file;                       // File the commands are read from (NULL to read from 'fd')
+    int fd;                           // Descriptor the commands are read from when there is no file
+    char buffer[BATCH_BUFFER_SIZE];   // Bytes read from the file
+    size_t start;                     // Offset of the first unread byte in the buffer
+    size_t end;                       // Offset just past the last byte read into the buffer
+    int lineNumber;                   // Number of the last line returned
+    int eof;                          // 1 once the end of the file has been reached
+    int skipping;                     // 1 while the rest of an overlong line is skipped
+    int nonblocking;                  // 1 to return -2 instead of waiting for the rest of a line (server clients)
+} BatchReader;
+
+// Structure to describe one batch command
+typedef struct {
+    const char *name;                 // Name of the command, the first word of its line
+    int argumentCount;                // Number of arguments the command takes
+    int access;                       // BATCH_READ, BATCH_WRITE or BATCH_SESSION
+    int (*run)(char **arguments, int *newID);  // Function that runs the command and returns a Status
+} BatchCommand;
+
+#ifndef _WIN32
+// Structure to hold the state of one client of the server
+typedef struct {
+    int fd;                           // Connection to the client
+    FILE *stream;                     // Stream the replies are written to
+    OutputFormat format;              // Output settings of the session, kept between commands
+    int offset;                       // ... the records to skip
+    int limit;                        // ... and the records to write
+    int ready;                        // 1 if whole lines may still wait in the reader (the budget ran out)
+    int closing;                      // 1 once the client has gone, so the main thread closes the session
+    BatchReader reader;               // Commands read from the client
+} ServerSession;
+
+// Structure to hold the state of the server mode
+
+/*
+ * Structure to hold the state of the server mode.
+ * Commands that only read take 'lock' shared and all others take it exclusively. The main thread
+ * polls the idle clients; a client with input waits in a ring buffer until a worker thread is free
+ * to run its commands, and the worker then hands it back through the 'wake' pipe.
+ */
+
+typedef struct {
+    int running;                      // 1 while the server runs (commands then take the lock)
+    volatile sig_atomic_t stopping;   // Set by SIGINT or SIGTERM
+    int readsExclusive;               // 1 if an index could not be built, so reads must run alone
+    pthread_rwlock_t lock;            // Lock on all the data
+    pthread_mutex_t statsLock;        // Lock on the statistics
+    pthread_mutex_t commitLock;       // Lock held while committing the journal
+    unsigned int committedSequence;   // Sequence number of the first journal record not yet committed
+    pthread_mutex_t queueLock;        // Lock on the queue of clients
+    pthread_cond_t queueReady;        // Signalled when a client is queued
+    pthread_cond_t queueFree;         // Signalled when a client leaves the queue
+    ServerSession *queue[SERVER_QUEUE_SIZE];  // Clients with commands waiting for a worker
+    int queueStart;                   // Position of the first waiting client
+    int queueCount;                   // Number of waiting clients
+    int wake[2];                      // Pipe through which workers hand clients back to the main thread
+    ServerSession *idle[SERVER_MAX_CLIENTS];  // Clients the main thread polls for input
+    int idleCount;                    // Number of idle clients
+    int clientCount;                  // Number of connected clients
+} Server;
+
+Server server;
+
+// Structure to hold the state of one client of the load test
+typedef struct {
+    int number;                       // Number of the client, used in the names of its patients
+    int requestCount;                 // Number of requests to send
+    int writePercent;                 // Percentage of the requests that change data
+    int lastPatient;                  // Request number in the name of the last patient added
+    int errors;                       // Number of requests that failed
+    int started;                      // 1 if the thread was started
+    pthread_t thread;                 // Thread running the client
+    FILE *sender;                     // Stream the commands are written to
+    FILE *receiver;                   // Stream the replies are read from
+    BenchResult reads;                // Latencies of the requests that only read
+    BenchResult writes;               // Latencies of the requests that change data
+} LoadTestClient;
+#endif
+
+// Settings for the journal that records every change between saves
+#define JOURNAL_FILE "hospital.wal"                  // Name of the journal file
+#define JOURNAL_HEADER_SIZE 13                       // Length, checksum and sequence (4 bytes each) plus the type
+#define JOURNAL_MAX_RECORD 1024                      // Largest possible journal record, header included
+#define JOURNAL_GROUP_BYTES (64 * 1024)              // Pending bytes that force a group commit
+#define JOURNAL_CHECKPOINT_BYTES (4 * 1024 * 1024)   // Journal size that triggers a checkpoint
+
+// Types of the changes recorded in the journal
+enum {
+    JOURNAL_ADD_DOCTOR = 1,
+    JOURNAL_ADD_PATIENT,
+    JOURNAL_ADD_STAFF,
+    JOURNAL_ADD_SHIFT,
+    JOURNAL_LEGACY_ADD_MEDICATION,  // Written by earlier versions, which referred to patients by position
+    JOURNAL_LEGACY_REMOVE_PATIENT,  // Written by earlier versions, which referred to patients by position
+    JOURNAL_ADD_MEDICATION,
+    JOURNAL_REMOVE_PATIENT
+};
+
+// Structure to hold a single journal record while it is built or read
+
+/*
+ * Structure to hold a single journal record while it is built or read.
+ * On disk a record is a JOURNAL_HEADER_SIZE byte header (payload length, checksum, sequence number, type)
+ * followed by the payload, which holds the arguments of the change.
+ */
+
+typedef struct {
+    unsigned char data[JOURNAL_MAX_RECORD];  // Header followed by the payload
+    size_t length;                           // Number of bytes in use
+} JournalRecord;
+
+// Structure to hold the state of the journal
+
+/*
+ * Structure to hold the state of the journal.
+ * Changes are appended to an in-memory buffer and written with one fsync per group commit.
+ * In server mode the buffer belongs to whoever holds the data lock, while the file, 'fileBytes' and the
+ * state of background saves belong to whoever holds 'fileLock', so commits write and fsync without
+ * the data lock. A thread that needs both takes the data lock first.
+ */
+
+typedef struct {
+    FILE *file;                                    // Journal file opened for appending
+    int enabled;                                   // 1 if changes are being journaled
+    int replaying;                                 // 1 while the journal is replayed, so changes are not logged twice
+    unsigned int nextSequence;                     // Sequence number of the next record
+    long fileBytes;                                // Bytes already committed to the journal file
+    size_t pendingBytes;                           // Bytes waiting for the next group commit
+    unsigned char pending[JOURNAL_GROUP_BYTES];    // Records waiting for the next group commit
+#ifndef _WIN32
+    pthread_mutex_t fileLock;                      // Lock on the journal file and background saves (recursive)
+    unsigned char committing[JOURNAL_GROUP_BYTES]; // Records the server is writing without the data lock
+#endif
+} Journal;
+
+Journal journal;  // The journal of changes made since the data files were last saved
+
+// Settings for saving in the background
+#define AUTOSAVE_DEFAULT_SECONDS 300    // Default time between automatic saves (HOSPITAL_AUTOSAVE overrides it)
+
+// Structure to hold the state of background saves
+
+/*
+ * Structure to hold the state of background saves.
+ * A background save forks a child process, which shares the program's memory copy-on-write and so
+ * sees the data exactly as it was at the fork. The child writes the data files and reports how long
+ * it took and how many bytes it wrote through a pipe, while the program carries on.
+ */
+
+typedef struct {
+    int child;                        // Process writing the snapshot (0 when no save is running)
+    int results;                      // Read end of the pipe the child reports on
+    long journalBytes;                // Size of the journal when the snapshot was taken
+    long long started;                // Time the last save started
+    long long pauseNs;                // Time the running save held up the program while taking its snapshot
+    int autosaveSeconds;              // Time between automatic saves (0 when they are off)
+    int saves;                        // Number of background saves completed
+    int failures;                     // Number of background saves that failed
+    long long lastDurationNs;         // Time the last completed background save took
+    long long lastPauseNs;            // Part of that time the program was held up
+    long long lastBytes;              // Size of the snapshot written by the last completed save
+} SaveState;
+
+SaveState saveState;  // The state of background saves
+
+// Settings for the versioned data files
+#define DATA_FILE_MAGIC "HMSDATA"     // First 8 bytes of every data file (including the null character)
+#define DATA_FILE_VERSION 3           // Version of the data file layout written by this program (3: packed sections)
+#define DATA_FILE_ALIGNMENT 64        // Sections start at a multiple of this many bytes
+#define DATA_FILE_MAX_SECTIONS 16     // Largest number of sections in one data file
+#define CHECKSUM_START 2166136261u    // Starting value of a checksum (see checksumUpdate)
+#define SECTION_PACKED 0x80000000u    // Set in the id of a section whose records are packed (see packRecord)
+#define PACK_BUFFER_SIZE (64 * 1024)  // Size of the buffer packed records are collected in before writing
+#define RECORD_MAX_FIELDS 16          // Largest number of fields in a packed record
+
+// Sections stored in the data files
+enum {
+    SECTION_DOCTORS = 1, SECTION_PATIENTS, SECTION_STAFF, SECTION_SHIFTS, SECTION_ROLES, SECTION_PATIENT_IDS,
+    SECTION_MEDICATIONS, SECTION_DOSAGES, SECTION_PRESCRIPTIONS
+};
+
+// Results of opening a data file
+enum { DATA_FILE_OK, DATA_FILE_MISSING, DATA_FILE_LEGACY, DATA_FILE_CORRUPT };
+
+// The data files (doctors.dat, patients.dat and staff.dat)
+enum { DATA_DOCTORS, DATA_PATIENTS, DATA_STAFF, DATA_FILE_COUNT };
+
+// Structure to describe a file that loadData loads on a thread of its own
+typedef struct {
+    const char *path;     // Name of the file
+    const char *content;  // What the file holds, for messages
+    int (*load)();        // Function that loads the file (loadDoctorsFile, ...)
+    int status;           // What 'load' returned
+} DataLoadTask;
+
+// Structure to represent the header at the start of a data file
+
+/*
+ * Structure to represent the header at the start of a data file.
+ * - magic: DATA_FILE_MAGIC, which tells a data file apart from the header-less files of earlier versions.
+ * - version: The layout version the file was written with.
+ * - sectionCount: The number of DataSection entries that follow the header.
+ * - journalSequence: The first journal record that is not already part of the file.
+ * - checksum: The checksum of the header (with this field set to 0) followed by the section table.
+ */
+
+typedef struct {
+    char magic[8];                 // DATA_FILE_MAGIC
+    unsigned int version;          // Layout version of the file
+    unsigned int sectionCount;     // Number of entries in the section table
+    unsigned int journalSequence;  // First journal record not included in the file
+    unsigned int checksum;         // Checksum of the header and the section table
+} DataFileHeader;
+
+// Structure to describe one section of a data file
+
+/*
+ * Structure to describe one section of a data file.
+ * A section is one contiguous array of 'count' records of 'recordSize' bytes starting 'offset' bytes into the file,
+ * or, when its id has SECTION_PACKED set, the 'count' records packed one after another into 'length' bytes.
+ */
+
+typedef struct {
+    unsigned int id;              // SECTION_* identifier
+    unsigned int recordSize;      // Size of each record in bytes
+    unsigned int count;           // Number of records
+    unsigned int checksum;        // Checksum of the section's bytes
+    unsigned long long offset;    // Offset of the first record from the start of the file
+    unsigned long long length;    // Length of the section in bytes
+} DataSection;
+
+// Structure to hold a data file that has been mapped into memory
+typedef struct {
+    char *base;               // Start of the mapped file
+    size_t size;              // Size of the file in bytes
+    DataFileHeader *header;   // Header at the start of the file
+    DataSection *sections;    // Section table following the header
+    int inPlace;              // Number of sections a table uses in place, which keeps the file mapped
+} DataFile;
+
+// Structure to describe a table to be written as a section of a data file
+typedef struct {
+    unsigned int id;      // SECTION_* identifier
+    RecordTable *table;   // Table holding the records
+    int count;            // Number of records to write
+} SectionSource;
+
+// Kinds of fields in a packed record
+enum {
+    FIELD_TEXT,   // Null-terminated text, packed as its length and its characters
+    FIELD_INT,    // Integer of 1, 2 or 4 bytes, packed as a varint of its difference from the previous record's
+    FIELD_BYTES   // Any other value, packed as it is
+};
+
+// Structure to describe one field of a record that is packed into a data file
+typedef struct {
+    unsigned char kind;     // FIELD_TEXT, FIELD_INT or FIELD_BYTES
+    unsigned short offset;  // Offset of the field inside the record
+    unsigned short size;    // Size of the field in bytes
+} RecordField;
+
+// Describe a member of a record type as a field of a packed record
+#define RECORD_FIELD(type, member, kind) {kind, offsetof(type, member), sizeof(((type *)0)->member)}
+
+// Structure to describe how the records of a section are packed
+typedef struct {
+    unsigned int id;             // SECTION_* identifier
+    const RecordField *fields;   // Fields of each record, in the order they are packed
+    int fieldCount;              // Number of fields
+} RecordLayout;
+
+// Journal sequence number each data file was saved at (records before it are already in the file)
+unsigned int dataFileSequence[DATA_FILE_COUNT];
+
+// 1 for each data file that is damaged and could not be moved aside, so saving must not replace it
+int dataFileDamaged[DATA_FILE_COUNT];
+const char *const dataFileNames[DATA_FILE_COUNT] = {"doctors.dat", "patients.dat", "staff.dat"};
+
+// Fields of the records packed into the data files (the padding between them is never written)
+const RecordField doctorFields[] = {
+    RECORD_FIELD(Doctor, name, FIELD_TEXT), RECORD_FIELD(Doctor, age, FIELD_INT),
+    RECORD_FIELD(Doctor, specialty, FIELD_TEXT), RECORD_FIELD(Doctor, visitingFees, FIELD_INT)
+};
+const RecordField patientFields[] = {
+    RECORD_FIELD(Patient, name, FIELD_TEXT), RECORD_FIELD(Patient, age, FIELD_INT),
+    RECORD_FIELD(Patient, diagnosis, FIELD_TEXT), RECORD_FIELD(Patient, roomNumber, FIELD_INT),
+    RECORD_FIELD(Patient, doctorID, FIELD_INT), RECORD_FIELD(Patient, firstMedication, FIELD_INT),
+    RECORD_FIELD(Patient, lastMedication, FIELD_INT), RECORD_FIELD(Patient, medicationCount, FIELD_INT),
+    RECORD_FIELD(Patient, id, FIELD_INT), RECORD_FIELD(Patient, admissionDate, FIELD_INT)
+};
+const RecordField staffFields[] = {
+    RECORD_FIELD(Staff, name, FIELD_TEXT), RECORD_FIELD(Staff, role, FIELD_TEXT),
+    RECORD_FIELD(Staff, contactInfo, FIELD_TEXT), RECORD_FIELD(Staff, firstShift, FIELD_INT),
+    RECORD_FIELD(Staff, lastShift, FIELD_INT), RECORD_FIELD(Staff, shiftCount, FIELD_INT)
+};
+const RecordField shiftFields[] = {
+    RECORD_FIELD(Shift, next, FIELD_INT), RECORD_FIELD(Shift, startTime, FIELD_INT),
+    RECORD_FIELD(Shift, endTime, FIELD_INT), RECORD_FIELD(Shift, roleID, FIELD_INT), RECORD_FIELD(Shift, day, FIELD_INT)
+};
+const RecordField roleFields[] = {RECORD_FIELD(Role, name, FIELD_TEXT)};
+const RecordField medicationFields[] = {RECORD_FIELD(Medication, name, FIELD_TEXT)};
+const RecordField dosageFields[] = {
+    RECORD_FIELD(Dosage, text, FIELD_TEXT), RECORD_FIELD(Dosage, amount, FIELD_BYTES), RECORD_FIELD(Dosage, unit, FIELD_TEXT)
+};
+const RecordField prescriptionFields[] = {
+    RECORD_FIELD(Prescription, next, FIELD_INT), RECORD_FIELD(Prescription, medicationID, FIELD_INT),
+    RECORD_FIELD(Prescription, dosageID, FIELD_INT)
+};
+
+// How the records of each section are packed (sections not listed are always written as they are in memory)
+#define RECORD_LAYOUT(id, fields) {id, fields, (int)(sizeof(fields) / sizeof(fields[0]))}
+const RecordLayout recordLayouts[] = {
+    RECORD_LAYOUT(SECTION_DOCTORS, doctorFields), RECORD_LAYOUT(SECTION_PATIENTS, patientFields),
+    RECORD_LAYOUT(SECTION_STAFF, staffFields), RECORD_LAYOUT(SECTION_SHIFTS, shiftFields),
+    RECORD_LAYOUT(SECTION_ROLES, roleFields), RECORD_LAYOUT(SECTION_MEDICATIONS, medicationFields),
+    RECORD_LAYOUT(SECTION_DOSAGES, dosageFields), RECORD_LAYOUT(SECTION_PRESCRIPTIONS, prescriptionFields)
+};
+
+// Keys that doctors and patients can be sorted by (the values index the key name lists below)
+#define MAX_SORT_KEYS 4  // Maximum number of keys in a single sort order
+
+enum { DOCTOR_KEY_NAME, DOCTOR_KEY_AGE, DOCTOR_KEY_SPECIALTY, DOCTOR_KEY_FEE, DOCTOR_KEY_COUNT };
+enum { PATIENT_KEY_NAME, PATIENT_KEY_AGE, PATIENT_KEY_DIAGNOSIS, PATIENT_KEY_ROOM, PATIENT_KEY_DOCTOR, PATIENT_KEY_COUNT };
+
+const char *const doctorKeyNames[] = {"Name", "Age", "Specialty", "Visiting fee"};
+const char *const patientKeyNames[] = {"Name", "Age", "Diagnosis", "Room number", "Doctor's name"};
+
+// Type of the functions that compare two records of a table using a list of sort keys
+typedef int (*RecordCompare)(int first, int second, const int *keys, int keyCount);
 
 // Function declarations
+void *tableAt(RecordTable *table, int index);    // Get a record that is already stored in a table
+void *tableSlot(RecordTable *table, int index);  // Get a record slot, growing the table if needed
+int tableWrite(RecordTable *table, int count, FILE *file);  // Write the first 'count' records to a file
+int tableRead(RecordTable *table, int count, FILE *file);   // Read 'count' records from a file into a table
+int tableRun(RecordTable *table, int index, int count);     // Count the records stored contiguously from an index
+Doctor *doctorAt(int index);                    // Get the doctor stored at an index
+Patient *patientAt(int index);                  // Get the patient stored at an index (a slot of the table)
+Staff *staffAt(int index);                      // Get the staff member stored at an index
+Appointment appointmentAt(int index);           // Get the appointment stored at an index
+Shift *shiftAt(int index);                      // Get the shift stored at an index
+Role *roleAt(int index);                        // Get the role stored at an index
+Medication *medicationAt(int index);            // Get the medication name stored at an index
+Dosage *dosageAt(int index);                    // Get the dosage stored at an index
+Prescription *prescriptionAt(int index);        // Get the prescription stored at an index
+unsigned int hashName(const char *name);        // Hash a name for the name indexes
+int nameIndexFind(NameIndex *index, const char *name);   // Find the record with a given name
+int nameIndexInsert(NameIndex *index, int recordIndex);  // Add a record's name to an index
+void nameIndexRemove(NameIndex *index, const char *name); // Remove a name from an index
+void nameIndexRebuild(NameIndex *index);        // Rebuild an index from its table
+int internRole(const char *name);               // Find or add a role name in the role table
+int parseWeekday(const char *text);             // Parse a day of the week
+int parseTime(const char *text);                // Parse a time of day into minutes since midnight
+void formatTime(int minutes, char *buffer);     // Format minutes since midnight as HH:MM
+int appendShift(int staffIndex, int day, int startTime, int endTime, int roleID); // Add a shift to a staff member
+void printShifts(Staff *member);                // Print the shifts of a staff member
+int internMedication(const char *name);         // Find or add a medication name in the catalog
+int parseDosage(const char *text, Dosage *dosage);  // Parse a dosage into an amount and a unit
+int internDosage(const char *text);             // Find or add a dosage in the catalog
+int appendPrescription(Patient *patient, int medicationID, int dosageID);  // Add a medication to a patient
+void compactPrescriptions();                    // Drop the prescriptions of removed patients
+void medicationIndexAdd(int medicationID, int patientID);  // Add a patient to a medication's list
+int medicationIndexReady();                     // Build the medication index if it is stale
+void medicationIndexSort(PatientList *list);    // Sort a medication's list and drop repeats and removed patients
+int listMedicationPatients(const char *name);   // List the patients on a medication
+void viewMedicationPatients();                  // Find the patients on a medication chosen by the user
+int outputReserve(size_t extra);                // Make room in the output buffer
+void outputAppend(const char *data, size_t length);  // Add bytes to the output buffer
+void outputFlush();                             // Write the output buffer to stdout
+void outputEscaped(const char *value);          // Add a value escaped for the output format
+void outputFieldName(const char *key);          // Start a field of a CSV or JSON record
+void outputBegin();                             // Start a listing
+int outputRecordBegin();                        // Start a record of a listing
+void outputRecordEnd();                         // End a record of a listing
+void outputEnd();                               // End a listing and write it out
+void outputText(const char *format, ...);       // Write text shown only in text mode
+void outputField(const char *key, const char *label, const char *value);  // Write a text field
+void outputInt(const char *key, const char *label, int value);            // Write a number field
+void outputListBegin(const char *key, const char *label);  // Start a list field
+void outputListItem(const char *format, ...);   // Write an item of a list field
+void outputListEnd();                           // End a list field
+void outputNumber(const char *key, const char *label, const char *number);  // Write a formatted number field
+long long statsNow();                           // Read the clock used by the instrumentation
+void statsInit();                               // Turn on the instrumentation if HOSPITAL_STATS is set
+long long statsStart();                         // Start timing an operation
+void statsRecord(int slot, const char *kind, const char *name, long long start);  // Record one call of an operation
+void statsAdd(int counter, long long amount);   // Add to an I/O counter
+long long statsPercentile(const StatsOperation *operation, int percent);  // Estimate a latency percentile
+void statsWriteRecord(const char *kind, const char *name, long long value, const StatsOperation *operation); // Write one statistics record
+void statsWrite();                              // Write all the statistics as a listing
+void statsDump();                               // Dump the statistics at exit
+int readLegacyStaff(FILE *file, int count);     // Read staff records in the old inline-schedule layout
+int copyText(char *destination, size_t size, const char *source); // Copy text into a fixed-size field
+unsigned int checksumBytes(const void *data, size_t length);     // Checksum a block of bytes
+unsigned int checksumUpdate(unsigned int checksum, const void *data, size_t length); // Continue a checksum
+void recordPutInt(JournalRecord *record, int value);             // Add an integer to a journal record
+void recordPutString(JournalRecord *record, const char *text);   // Add a string to a journal record
+int recordGetInt(const unsigned char **cursor, const unsigned char *end, int *value);  // Read an integer from a payload
+int recordGetString(const unsigned char **cursor, const unsigned char *end, char *text, size_t size); // Read a string from a payload
+void journalRecordBegin(JournalRecord *record, int type);  // Start a new journal record
+void journalLog(JournalRecord *record);         // Queue a record for the next group commit
+void journalCommit();                           // Write pending journal records to disk
+void journalWrite(const unsigned char *records, size_t length);  // Write journal records and fsync them
+void journalLock();                             // Take the lock on the journal file
+void journalUnlock();                           // Release the lock on the journal file
+void journalOpen();                             // Open the journal for appending
+void journalClose();                            // Commit and close the journal
+void journalReset();                            // Empty the journal after a checkpoint
+void journalTrim(long savedBytes);              // Drop the start of the journal after a background save
+void journalCopyTail(long savedBytes);          // Replace the journal with the records after its start
+void journalIdle();                             // Commit, and checkpoint when the journal is large
+int journalApply(int type, const unsigned char *payload, const unsigned char *end); // Apply one journal record
+char *mapFile(const char *path, size_t *size);  // Map a file into memory
+void unmapFile(char *data, size_t size);        // Release a mapped file
+void closeDataFile(DataFile *file, int loaded);  // Release a data file once its sections are loaded
+void tableDetach(RecordTable *table);           // Stop a table from using records in a mapped file
+long long writeDataFile(const char *path, const SectionSource *sources, int sectionCount, unsigned int journalSequence); // Write a data file
+int openDataFile(const char *path, DataFile *file);  // Map and validate a data file
+DataSection *findDataSection(DataFile *file, unsigned int id);  // Find a section of a data file
+int attachSection(DataFile *file, unsigned int id, RecordTable *table, int *count); // Load a section into a table
+const RecordLayout *findRecordLayout(unsigned int id);  // Find how the records of a section are packed
+size_t packVarint(unsigned char *out, unsigned int value);  // Pack a number into 1 to 5 bytes
+int unpackVarint(const unsigned char **cursor, const unsigned char *end, unsigned int *value);  // Read a packed number
+size_t packRecord(const RecordLayout *layout, const char *record, int *previous, unsigned char *out);  // Pack one record
+int unpackRecord(const RecordLayout *layout, const unsigned char **cursor, const unsigned char *end, int *previous, char *record);  // Unpack one record
+int writePackedSection(FILE *file, const SectionSource *source, const RecordLayout *layout, DataSection *section);  // Write a packed section
+int unpackSection(DataFile *file, DataSection *section, RecordTable *table, int *count);  // Load a packed section into a table
+int recordFieldInt(const char *field, int size);  // Read an integer field of any size
+void setRecordFieldInt(char *field, int size, int value);  // Store an integer field of any size
+int verifyDataFile(DataFile *file, const char *path);  // Check the section checksums of a data file
+int loadDoctorsFile();                          // Load doctors.dat
+int loadPatientsFile();                         // Load patients.dat
+int convertLegacyPatient(const LegacyPatient *legacy, Patient *patient);  // Convert a patient from an earlier layout
+int loadStaffFile();                            // Load staff.dat
+int loadAppointmentsFile();                     // Open appointments.dat as a load task
+int journalRecordFile(int type);                // Find the data file a journal record belongs to
+int daysFromCivil(int year, int month, int day);  // Convert a calendar date to a day number
+int parseDate(const char *text);                // Parse a YYYY-MM-DD date into a day number
+void formatDate(int dayNumber, char *buffer);   // Format a day number as YYYY-MM-DD
+int currentDate();                              // Get today's date as a day number
+int appointmentStoreOpen();                     // Open the appointment store
+int appointmentStoreRemap();                    // Map the appointment store's blocks
+const int *appointmentColumn(int block, int column);  // Get one column of one block of appointments
+int appointmentStoreCreate(const char *path);   // Create an empty appointment store
+int appointmentStoreAppend(int patientID, int doctorID, int date, int slot);  // Append an appointment to the store
+int appointmentStoreCancel(int appointment);    // Mark an appointment in the store as cancelled
+int appointmentStoreUpgrade(FILE *legacy, int rowCount);  // Convert a version 1 appointment store
+int appointmentStoreClose();                    // Sync and close the appointment store
+void appointmentStoreSync();                    // Flush appended appointments to disk
+int scanAppointments(int doctorID, int fromDate, int toDate, void (*visit)(int index, const Appointment *appointment)); // Scan appointments
+PostingList *appointmentIndexList(AppointmentIndex *index, int key);  // Make room in a posting list
+void appointmentIndexAdd(AppointmentIndex *index, int key, int date, int appointment); // Add an appointment to a date index
+int postingLowerBound(const PostingList *list, int date);  // Find the first entry on or after a date
+int comparePostings(const void *first, const void *second);  // Compare two posting list entries
+int appointmentIndexRebuild(AppointmentIndex *index);  // Rebuild a date index from the store
+int queryAppointments(AppointmentIndex *index, int key, int fromDate, int toDate, void (*visit)(int index, const Appointment *appointment)); // Query a date index
+CalendarDay *calendarFind(int doctorID, int date, int create);  // Find a day in the doctors' calendar
+void cancelPatientAppointments(int patientID);  // Cancel the appointments of a removed patient
+unsigned int calendarHash(int doctorID, int date);  // Hash a doctor and a date for the calendar
+void calendarClear();                           // Empty the doctors' calendar
+int calendarRebuild();                          // Rebuild the doctors' calendar from the store
+unsigned int calendarSlots(int doctorID, int date);  // Get the booked slots of a doctor on a day
+int nearestFreeSlot(unsigned int booked, int slot);  // Find the free slot nearest to a slot
+int slotFromTime(int minutes);                  // Convert a time of day to a calendar slot
+int slotTime(int slot);                         // Get the start time of a calendar slot
+int patientIDMapReady();                        // Build the patient ID map if it is stale
+int patientIDMapSet(int patientID, int slot);   // Record the slot of a patient ID
+int pushFreePatientSlot(int slot);              // Add a slot to the free list
+int patientSlot(int patientID);                 // Find the slot of a patient
+Patient *patientByID(int patientID);            // Get a patient by ID
+Doctor *patientDoctor(const Patient *patient);  // Get the doctor treating a patient
+int patientIDAtPosition(int position);          // Find a patient by position in ID order
+int compareSlots(const void *first, const void *second);  // Compare two slot numbers
+void compactPatients();                         // Close the gaps left by removed patients
+void compactPatientsIdle();                     // Compact the patient table when worthwhile
+int countAdd(CountArray *array, int id, int delta);  // Add to the count of an ID
+void aggregateStaff(Staff *member);             // Count a new staff member in the report aggregates
+void aggregateShift(Staff *member, Shift *shift);  // Count a new shift in the report aggregates
+void aggregatePatient(Patient *patient, int delta);  // Count a patient as added or removed
+int aggregatesReady();                          // Build the report aggregates if they are stale
+void patientColumnsSet(int slot, const Patient *patient);  // Update the query columns of a slot
+int patientColumnsReady();                      // Build the query columns if they are stale
+int patientQueryScan(const PatientQuery *query, int first, int last, int *slots);  // Find matching slots
+int countPatients(const PatientQuery *query);   // Count the patients that match a query
+int listQueryPatients(const PatientQuery *query);  // List the patients that match a query
+int parseQueryLimit(const char *text, int unlimited, int *value);  // Parse a limit of a patient query
+void queryPatients();                           // Query the patients by age, room and doctor
+const char *textIndexText(TextIndex *index, int key);  // Get the indexed text of a record
+TrigramList *textIndexList(TextIndex *index, int trigram, int create);  // Find the record list of a trigram
+int textTrigrams(const char *text, int padded, int *trigrams);  // Split a text into trigrams
+int textIndexAdd(TextIndex *index, int key);    // Add a record's text to a text index
+void textIndexRemove(TextIndex *index);         // Note that a record of a text index was removed
+int textIndexReady(TextIndex *index);           // Build a text index if it is stale
+int textMatches(const char *text, const char *query, int mode);  // Check a text against a search query
+int compareTrigramLists(const void *first, const void *second);  // Compare two trigram lists by length
+int searchRecords(int field, int mode, const char *query, int **keys);  // Find the records that match a search
+int listSearchResults(int field, int mode, const char *query);  // List the records that match a search
+int parseSearchName(const char *text, const char *const *names, int count);  // Parse a field or kind of match
+void searchRecordsMenu();                       // Search the records with a query chosen by the user
+int roomClassIndex(int roomNumber);             // Find the index of a room's class
+int roomInventoryAdd(int roomNumber, int delta);  // Count a patient admitted to or discharged from a room
+int roomInventoryReady();                       // Build the room inventory if it is stale
+int roomHasFreeBed(int roomNumber);             // Check whether a room has a free bed
+int lowestBit(unsigned long long word);         // Find the lowest set bit of a word
+int countBits(unsigned long long word);         // Count the set bits of a word
+int findFreeRoom(int firstRoom, int lastRoom);  // Find the first room with a free bed in a range
+int findFreeRoomOfClass(const char *className);  // Find the first room with a free bed in a class
+int listRoomOccupancy();                        // List the occupancy of the room classes
+void findFreeRoomMenu();                        // Find a free room of a class chosen by the user
+int insertAppointment(int patientID, int doctorID, int date, int slot);  // Schedule an appointment
+void journalReplay();                           // Re-apply the journal after loading the data files
+int insertDoctor(const char *name, int age, const char *specialty, int visitingFees);  // Add a doctor
+int insertPatient(const char *name, int age, const char *diagnosis, int roomNumber, int doctorID, int admissionDate); // Add a patient
+int insertStaff(const char *name, const char *role, const char *contactInfo);  // Add a staff member
+int insertShift(int staffIndex, int day, int startTime, int endTime, const char *role); // Add a shift
+int insertMedication(int patientID, const char *name, const char *dosage);  // Add a medication
+int deletePatient(int patientID);               // Remove a patient
 void showMenu();                      // Display the main menu
 void addDoctor();                     // Add a new doctor to the system
 void addPatient();                    // Add a new patient to the system
 void generateReport();                // Generate a summary report
-void saveData();                      // Save data to files
+int saveData();                       // Save data to files
+long long writeSnapshot(unsigned int sequence);  // Write every table to the data files
+int saveDataBackground();             // Start saving data to files in a background process
+void saveFinish(int status, int report);  // Collect the results of a finished background save
+void saveWait();                      // Wait for a background save to finish
+void saveIdle();                      // Collect a finished save and start an automatic one when due
+void saveCollect();                   // Collect a background save that has finished
+int saveDue();                        // Check whether a checkpoint or an automatic save should start
+void saveInit();                      // Read the autosave interval and start timing it
+int replaceFile(const char *source, const char *destination);  // Replace a file with a newly written one
+int moveDamagedFile(const char *path);  // Move a damaged file aside
+int dataFilesReplaceable();           // Check that saving may replace every data file
+void reportDamagedFiles();            // Tell why saving is refused
+void loadCheckReferences(int doctorsLoaded, int patientsLoaded);  // Check the references between the loaded files
 void loadData();                      // Load data from files
 int readInteger();                    // Read a positive integer input
 void sortDoctorsByName();             // Sort the list of doctors by their names
 void sortPatientsByAge();             // Sort the list of patients by their ages
+int *sortRecordOrder(int count, RecordCompare compare, const int *keys, int keyCount); // Sort record indexes
+int compareDoctors(int first, int second, const int *keys, int keyCount);   // Compare two doctors
+int comparePatients(int first, int second, const int *keys, int keyCount);  // Compare two patients
+int readSortKeys(const char *const *keyNames, int keyNameCount, int *keys); // Read sort keys from the user
+void viewDoctorsSorted(const int *keys, int keyCount);   // Display doctors in a sorted order
+void viewPatientsSorted(const int *keys, int keyCount);  // Display patients in a sorted order
+void outputDoctor(int number, int doctorID);    // Write a doctor as a record of a listing
+void outputPatient(int number, Patient *patient);  // Write a patient as a record of a listing
+int compareRoomClasses(const void *first, const void *second);  // Compare two room classes by first room
+int compareMedicationRates(const void *first, const void *second);  // Compare two medication rates by name
+void loadBillingRates();              // Read the billing rates
+const RoomClass *roomClassOf(int roomNumber);  // Find the class of a room
+int medicationCost(const char *name);  // Find the cost of a medication
+void billingPost(int patientID, int kind, int amount);  // Post a charge to a patient's account
+int billingLedgerReady();             // Build the billing ledger if it is stale
+void billPatient(Patient *patient, int today, Invoice *invoice);  // Itemize a patient's bill
 int calculateBill(Patient *patient);  // Calculate the bill for a patient
+void printInvoice(Patient *patient, const Invoice *invoice);  // Print a patient's itemized bill
+void outputInvoice(int number, Patient *patient, const Invoice *invoice);  // Write an invoice as a record of a listing
+void billPatients(BillingTask *task);  // Bill a range of patient slots
+int billAllPatients(const char *path, int *billed, long long *total);  // Write the invoices of all patients
+void billAllPatientsToFile();         // Bill all patients into a file chosen by the user
 void clearInputBuffer();              // Clear the input buffer to prevent invalid input
-void assignMedicationToPatient();     // Assign a medication to a patient
+void assignMedicationToPatient(int patientID);  // Assign a medication to a patient
 void viewDoctors();                   // Display the list of doctors
 void viewPatients();                  // Display the list of patients
 void scheduleAppointment();           // Schedule a new appointment
 void viewAppointments();              // View all scheduled appointments
+void printAppointment(int index, const Appointment *appointment);  // Print one appointment
+int readDateRange(int *fromDate, int *toDate);  // Read a range of dates from the user
+void filterAppointments();            // View appointments filtered by doctor and date
+void viewPatientAppointments();       // View the appointment history of a patient
+void suggestAppointmentSlot(int doctorID, int date, int slot);  // Suggest a free appointment time
+void viewDoctorCalendar();            // View a doctor's booked slots and utilisation
+void outputSettings();                // Choose the format and range of the listings
+void viewStatistics();                // View the collected statistics
 void addStaff();                      // Add a new staff member
 void assignShiftToStaff();            // Assign a shift to a staff member
 void viewStaffSchedules();            // View schedules of all staff members
+int parseOutputFormat(const char *text);  // Parse the name of an output format
+void listAppointments(int doctorID, int fromDate, int toDate);  // List appointments by doctor and date
+void listPatientAppointments(int patientID, int fromDate, int toDate);  // List a patient's appointments
+int batchReadLine(BatchReader *reader, char **line);  // Read the next line of a batch file
+int batchTokenize(char *line, char **tokens, int maxTokens);  // Split a batch line into arguments
+int batchNumber(const char *text, int *value);  // Parse a number argument
+int batchDoctor(const char *text);    // Find the doctor named by a batch argument
+int batchFileAllowed(const char *path, int writing);  // Check that a batch command may use a file
+int batchPatient(const char *text);   // Find the patient named by a batch argument
+int batchStaff(const char *text);     // Find the staff member named by a batch argument
+int batchDateLimit(const char *text, int unlimited, int *date);  // Parse a date limit of a list command
+int batchQuery(char **arguments, PatientQuery *query);  // Parse the arguments of a patient query command
+void batchReply(const char *format, ...);  // Write a line of a batch command's reply
+int runBatchLine(char *line, int lineNumber);  // Run one command of a batch file
+int runBatch(FILE *file);             // Run the commands of a batch file
+int importSplitLine(char *line, char **fields, int maxFields);  // Split a CSV line into fields
+const char *importCheckRow(ImportKind kind, ImportRow *row, int fieldCount);  // Check one row of an import
+void importParseChunk(ImportChunk *chunk);  // Parse one chunk of an import file
+int importCSV(ImportKind kind, const char *path, int *imported, int *rejected);  // Import records from a CSV file
+void importRecords();                 // Import records from a CSV file chosen by the user
+int parseImportKind(const char *text);  // Parse the kind of records of an import
+long long benchNow();                 // Get the current time in nanoseconds
+unsigned int benchRandom();           // Get the next pseudo-random number of the benchmark
+int compareSamples(const void *first, const void *second);  // Compare two latency samples
+int benchBegin(BenchResult *result, const char *name, int expected);  // Start timing an operation
+void benchSample(BenchResult *result, long long start);  // Record the latency of one call
+void benchEnd(BenchResult *result);   // Finish timing an operation
+void benchLoader(int requests, int results);  // Run the process that times loadData
+void benchReport(const BenchResult *results, int resultCount, const char *title);  // Write the benchmark results
+int runBenchmark(int patients, unsigned int seed);  // Run the benchmark
+#ifndef _WIN32
+void serverBegin(int access);         // Take the server's lock for a command
+void serverEnd(int access, int slot, const char *name, long long started);  // Finish a command in server mode
+void serverCommit(unsigned int sequence);  // Commit the journal for the writers waiting on it
+int serverPrepareReads();             // Build every index the commands that only read may use
+void serverStop(int signal);          // Stop the server from a signal handler
+ServerSession *serverSessionOpen(int client);  // Start the session of a new client
+void serverSessionClose(ServerSession *session);  // End the session of a client
+int serveClient(ServerSession *session);  // Run the commands a client has sent
+void serverQueue(ServerSession *session);  // Queue a client with commands for the workers
+void serverReturn(ServerSession *session);  // Take back a client from a worker
+void *serverWorker(void *argument);   // Serve the queued clients
+int runServer(const char *path, int threads);  // Run the server
+int loadTestConnect(const char *path);  // Connect to the server
+int loadTestRequest(FILE *sender, FILE *receiver, const char *command);  // Send a command and wait for its status
+int loadTestOpen(const char *path, FILE **sender, FILE **receiver);  // Open a connection to the server
+void *loadTestThread(void *argument);  // Run one client of the load test
+int runLoadTest(const char *path, int clients, int requests, int writePercent);  // Run the load test
+#endif
 void viewPatientBill();
 void removePatient();  
 
@@ -166,25 +1598,124 @@ void removePatient();
  * - Allowing the user to select various options (e.g., add doctors, patients, view reports, etc.).
  * - Each option corresponds to a specific function such as adding a doctor, assigning medication to patients, scheduling appointments, generating reports, etc.
  * - The user's choice is processed using a switch-case statement, which calls the appropriate function based on the user's input.
- * - If the user selects the option to exit (choice 13), the program will print an exit message and terminate.
+ * - If the user selects the option to exit (choice 15), the program will print an exit message and terminate.
  * - Invalid choices are handled by displaying an error message.
  * 
- * The function also saves data to files (via the saveData function) to persist the information for later use.
- * This ensures that changes made during the program's execution are retained.
+ * When started as 'hospital --batch FILE' (or '--batch -' for stdin), it runs the commands in the file
+ * through runBatch instead of showing the menu, and exits with status 1 if any command failed.
+ * When started as 'hospital --bench PATIENTS [SEED]', it runs the benchmark (runBenchmark) on generated data.
+ * When started as 'hospital --serve SOCKET [THREADS]', it serves batch commands from many clients at once
+ * over a Unix-domain socket (runServer) until SIGINT or SIGTERM; 'hospital --load-test SOCKET CLIENTS
+ * REQUESTS [WRITE_PERCENT]' measures such a server (runLoadTest).
+ *
+ * The function also saves data to files (via saveDataBackground, which writes a snapshot in a child process
+ * while the menu carries on) to persist the information for later use. Data is also saved automatically
+ * every HOSPITAL_AUTOSAVE seconds (AUTOSAVE_DEFAULT_SECONDS by default, 0 turns it off) when there are changes.
+ * Every change is also appended to a journal as it happens, so changes made since the last save are
+ * recovered the next time the program starts, even after a crash.
  */
 
-int main() {
-    // Load previously saved data into the system
+int main(int argc, char *argv[]) {
+    statsInit();  // Collect statistics if HOSPITAL_STATS is set
+
+    // Check for benchmark and batch mode before loading anything
+    FILE *batchFile = NULL;
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        int patients, seed = 1;
+        if (argc < 3 || argc > 4 || !batchNumber(argv[2], &patients) || patients == 0 ||
+            (argc == 4 && !batchNumber(argv[3], &seed))) {
+            fprintf(stderr, "Usage: %s --bench PATIENTS [SEED]\n", argv[0]);
+            return 2;
+        }
+        output.format = OUTPUT_JSONL;
+#ifdef _WIN32
+        fprintf(stderr, "The benchmark is not available on this system.\n");
+        return 2;
+#else
+        return runBenchmark(patients, (unsigned int)seed);
+#endif
+    }
+    if (argc > 1 && strcmp(argv[1], "--load-test") == 0) {
+        int clients, requests, writePercent = 10;
+        if (argc < 5 || argc > 6 || !batchNumber(argv[3], &clients) || clients == 0 || !batchNumber(argv[4], &requests) ||
+            (argc == 6 && (!batchNumber(argv[5], &writePercent) || writePercent > 100))) {
+            fprintf(stderr, "Usage: %s --load-test SOCKET CLIENTS REQUESTS [WRITE_PERCENT]\n", argv[0]);
+            return 2;
+        }
+#ifdef _WIN32
+        fprintf(stderr, "The load test is not available on this system.\n");
+        return 2;
+#else
+        return runLoadTest(argv[2], clients, requests, writePercent);
+#endif
+    }
+    int serverThreads = 0;
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+        if (argc < 3 || argc > 4 || (argc == 4 && (!batchNumber(argv[3], &serverThreads) || serverThreads == 0))) {
+            fprintf(stderr, "Usage: %s --serve SOCKET [THREADS]\n", argv[0]);
+            return 2;
+        }
+#ifdef _WIN32
+        fprintf(stderr, "The server mode is not available on this system.\n");
+        return 2;
+#else
+        if (serverThreads == 0) {
+            long cores = sysconf(_SC_NPROCESSORS_ONLN);
+            serverThreads = cores > 0 ? (int)cores : 1;  // One worker per core by default
+        }
+        if (serverThreads > SERVER_MAX_THREADS) {
+            serverThreads = SERVER_MAX_THREADS;
+        }
+#endif
+    } else if (argc > 1) {
+        if (argc != 3 || strcmp(argv[1], "--batch") != 0) {
+            fprintf(stderr, "Usage: %s [--batch FILE|-] [--bench PATIENTS [SEED]] [--serve SOCKET [THREADS]]\n"
+                            "       %s --load-test SOCKET CLIENTS REQUESTS [WRITE_PERCENT]\n", argv[0], argv[0]);
+            return 2;
+        }
+        batchFile = strcmp(argv[2], "-") == 0 ? stdin : fopen(argv[2], "r");
+        if (batchFile == NULL) {
+            fprintf(stderr, "Could not open %s.\n", argv[2]);
+            return 2;
+        }
+    }
+
+    // Load previously saved data into the system, then start journaling new changes
     loadData();
+    journalOpen();
+    atexit(journalClose);
+    atexit(appointmentStoreSync);
+    saveInit();  // Save automatically every HOSPITAL_AUTOSAVE seconds
+
+#ifndef _WIN32
+    // In server mode serve the clients instead of showing the menu
+    if (serverThreads > 0) {
+        return runServer(argv[2], serverThreads);
+    }
+#endif
+
+    // In batch mode run the commands of the file instead of showing the menu
+    if (batchFile != NULL) {
+        int failures = runBatch(batchFile);
+        if (batchFile != stdin) {
+            fclose(batchFile);
+        }
+        return failures > 0 ? 1 : 0;
+    }
 
     // Variable to store the user's menu choice
     int choice;
 
     // Main menu loop: continuously show the menu until the user exits
     while (1) {
+        journalIdle();  // Commit journaled changes while waiting for the user
+        saveIdle();  // Collect a finished background save, and start an automatic one when due
+        compactPatientsIdle();  // Reclaim the slots of removed patients
+        appointmentStoreSync();  // Flush newly scheduled appointments to disk
         showMenu();  // Display the menu options
         printf("Enter your choice: ");
         choice = readInteger();  // Read the user's choice
+        long long started = statsStart();
 
         // Execute the selected operation
         switch (choice) {
@@ -196,9 +1727,9 @@ int main() {
                 break;  // Add a new patient
             case 3:
                 printf("Enter patient ID to assign medication: ");
-                int patientIndex = readInteger();
-                if (patientIndex >= 0 && patientIndex < patientCount) {
-                    assignMedicationToPatient(patientIndex);  // Assign medication to the specified patient
+                int patientID = readInteger();
+                if (patientByID(patientID) != NULL) {
+                    assignMedicationToPatient(patientID);  // Assign medication to the specified patient
                 } else {
                     printf("Invalid patient ID.\n");
                 }
@@ -219,8 +1750,13 @@ int main() {
                 generateReport();  // Generate a report summary
                 break;
             case 9:
-                saveData();  // Save all data to files
-                printf("Data saved successfully!\n");
+                if (saveDataBackground()) {  // Save all data to files while the menu carries on
+                    printf("Saving data in the background.\n");
+                } else if (saveState.child != 0) {
+                    printf("A save is already running.\n");
+                } else if (!dataFilesReplaceable()) {
+                    reportDamagedFiles();  // Nothing was saved; the journal still holds every change
+                }
                 break;
             case 10:
                 addStaff();  // Add a new staff member
@@ -240,9 +1776,57 @@ int main() {
             case 15:
                 printf("Exiting program...\n");  // Exit the program
                 return 0;
+            case 16: {
+                int keys[MAX_SORT_KEYS];
+                int keyCount = readSortKeys(doctorKeyNames, DOCTOR_KEY_COUNT, keys);
+                viewDoctorsSorted(keys, keyCount);  // View doctors in the chosen order
+                break;
+            }
+            case 17: {
+                int keys[MAX_SORT_KEYS];
+                int keyCount = readSortKeys(patientKeyNames, PATIENT_KEY_COUNT, keys);
+                viewPatientsSorted(keys, keyCount);  // View patients in the chosen order
+                break;
+            }
+            case 18:
+                filterAppointments();  // View appointments of a doctor or a range of dates
+                break;
+            case 19:
+                viewPatientAppointments();  // View a patient's appointments in date order
+                break;
+            case 20:
+                viewDoctorCalendar();  // View a doctor's booked slots and utilisation
+                break;
+            case 21:
+                outputSettings();  // Choose the format, offset and limit of the listings
+                break;
+            case 22:
+                importRecords();  // Import doctors, patients or staff from a CSV file
+                break;
+            case 23:
+                viewStatistics();  // View call counts, latencies, I/O and table sizes
+                break;
+            case 24:
+                billAllPatientsToFile();  // Write the invoices of all patients to a file
+                break;
+            case 25:
+                viewMedicationPatients();  // List the patients on a medication
+                break;
+            case 26:
+                queryPatients();  // List the patients by age, room and doctor
+                break;
+            case 27:
+                searchRecordsMenu();  // Search names, diagnoses or specialties
+                break;
+            case 28:
+                findFreeRoomMenu();  // Find a free bed and list the occupancy of the rooms
+                break;
             default:
                 printf("Invalid choice! Please try again.\n");  // Handle invalid input
         }
+        if (choice >= 1 && choice <= MENU_CHOICE_COUNT) {
+            statsRecord(choice - 1, "menu", menuNames[choice - 1], started);
+        }
     }
 
     return 0;
@@ -260,21 +1844,9 @@ int main() {
 
 void showMenu() {
     printf("\n----- Main Menu -----\n");
-    printf("1. Add Doctor\n");
-    printf("2. Add Patient\n");
-    printf("3. Assign Medication to Patient\n");
-    printf("4. View Doctors\n");
-    printf("5. View Patients\n");
-    printf("6. Schedule Appointment\n");
-    printf("7. View Appointments\n");
-    printf("8. Generate Report\n");
-    printf("9. Save Data\n");
-    printf("10. Add Staff\n");
-    printf("11. Assign Shift to Staff\n");
-    printf("12. View Staff Schedules\n");
-    printf("13. Remove Patient\n");
-    printf("14. View Patient's Bill\n");
-    printf("15. Exit\n");
+    for (int i = 0; i < MENU_CHOICE_COUNT; i++) {
+        printf("%d. %s\n", i + 1, menuNames[i]);
+    }
 }
 
 // Function to read an integer input
@@ -292,6 +1864,10 @@ void showMenu() {
 int readInteger() {
     int input;
     while (scanf("%d", &input) != 1 || input < 0) {
+        if (feof(stdin)) {
+            printf("\nEnd of input, exiting program...\n");
+            exit(0);  // The journal is committed by journalClose at exit
+        }
         clearInputBuffer(); 
         printf("Invalid input. Please enter a valid positive integer: ");
     }
@@ -309,671 +1885,9143 @@ int readInteger() {
  */
 
 void clearInputBuffer() {
-    while (getchar() != '\n');  // Clear the buffer
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF);  // Clear the buffer
 }
 
-// Function to add a new doctor
+// Function to get a record that is already stored in a table
 
 /**
- * @brief Adds a new doctor to the system.
+ * @brief Returns a pointer to the record at 'index' in a record table.
  * 
- * Prompts the user to enter details for a new doctor, including their name, age, 
- * specialty, and visiting fee. Ensures that the maximum doctor limit is not exceeded. 
- * Each doctor is stored in the `doctors` array.
+ * The record must already be inside an allocated chunk (for example an index 
+ * below the matching counter). The returned pointer stays valid while the table grows.
  * 
- * - Name acts as a unique identifier.
- * - Validates that the maximum number of doctors has not been reached.
+ * @return Pointer to the record at the given index.
  */
 
-void addDoctor() {
-    if (doctorCount < MAX_DOCTORS) {
-        printf("Enter doctor's name (this will be used as the ID): ");
-        scanf("%s", doctors[doctorCount].name);  // Doctor's name is used as ID
-        printf("Enter doctor's age: ");
-        doctors[doctorCount].age = readInteger();
-        printf("Enter doctor's specialty: ");
-        scanf("%s", doctors[doctorCount].specialty);
-        printf("Enter doctor's visiting fee: ");
-        doctors[doctorCount].visitingFees = readInteger();
-
-        doctorCount++;
-        printf("Doctor added successfully!\n");
-    } else {
-        printf("Maximum doctor limit reached.\n");
+void *tableAt(RecordTable *table, int index) {
+    if (index < table->mappedCount) {
+        return table->mapped + (size_t)index * table->recordSize;
     }
+    index -= table->mappedCount;
+    return table->chunks[index >> TABLE_CHUNK_SHIFT] + (size_t)(index & (TABLE_CHUNK_SIZE - 1)) * table->recordSize;
 }
 
-// Function to add a new patient
+// Function to get a record slot, growing the table when needed
 
 /**
- * @brief Adds a new patient to the system.
+ * @brief Returns a pointer to the record slot at 'index', allocating chunks as needed.
  * 
- * This function collects details about the patient, such as name, age, 
- * diagnosis, and room number. It also links the patient to a specific doctor 
- * by matching the doctor’s name. Validates input and ensures that the maximum 
- * patient limit is not exceeded.
+ * Chunks are allocated zero-filled, so a slot that has never been used reads as 
+ * an empty record. Only the array of chunk pointers is ever reallocated; the 
+ * chunks themselves never move.
  * 
- * - Links the patient to a doctor using the doctor's name as an identifier.
- * - Checks if the entered doctor exists in the system.
+ * @return Pointer to the record slot, or NULL if memory could not be allocated.
  */
 
-void addPatient() {
-    if (patientCount < MAX_PATIENTS) {
-        printf("Enter patient's name: ");
-        scanf("%s", patients[patientCount].name);
-        printf("Enter patient's age: ");
-        patients[patientCount].age = readInteger();
-        printf("Enter patient's diagnosis: ");
-        scanf("%s", patients[patientCount].diagnosis);
-        printf("Enter patient's room number: ");
-        patients[patientCount].roomNumber = readInteger();
-
-        // Ask for the doctor's name and assign the doctor ID based on the name
-        printf("Enter the doctor's name (used as doctor ID): ");
-        char doctorName[100];
-        scanf("%s", doctorName);
+void *tableSlot(RecordTable *table, int index) {
+    if (index < table->mappedCount) {
+        return tableAt(table, index);
+    }
+    int chunkIndex = (index - table->mappedCount) >> TABLE_CHUNK_SHIFT;
 
-        // Find the doctor with the matching name and assign to the patient
-        int doctorFound = 0;
-        for (int i = 0; i < doctorCount; i++) {
-            if (strcmp(doctors[i].name, doctorName) == 0) {
-                patients[patientCount].doctorID = i;  // Assign the doctor by index
-                doctorFound = 1;
-                break;
-            }
+    // Grow the array of chunk pointers by doubling its capacity
+    if (chunkIndex >= table->chunkCapacity) {
+        int newCapacity = table->chunkCapacity > 0 ? table->chunkCapacity : 16;
+        while (chunkIndex >= newCapacity) {
+            newCapacity *= 2;
         }
-
-        if (!doctorFound) {
-            printf("Doctor not found.\n");
-            return;
+        char **newChunks = realloc(table->chunks, newCapacity * sizeof(char *));
+        if (newChunks == NULL) {
+            return NULL;
         }
+        table->chunks = newChunks;
+        table->chunkCapacity = newCapacity;
+    }
 
-        patientCount++;
-        printf("Patient added successfully!\n");
-    } else {
-        printf("Maximum patient limit reached.\n");
+    // Allocate every chunk up to and including the one holding the slot
+    while (table->chunkCount <= chunkIndex) {
+        char *chunk = calloc(TABLE_CHUNK_SIZE, table->recordSize);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        table->chunks[table->chunkCount++] = chunk;
     }
+
+    return tableAt(table, index);
 }
 
-// Function to sort doctors by name
+// Function to count the records stored next to each other in a table
 
 /**
- * @brief Sorts the list of doctors alphabetically by their names.
+ * @brief Returns how many records starting at 'index' are stored contiguously, at most 'count'.
  * 
- * Uses a simple bubble sort algorithm to sort the `doctors` array based 
- * on the `name` field. Sorting helps in organizing the data for better 
- * readability or searching.
+ * A run ends at the end of the mapped region or of a chunk. Used to read and 
+ * write records in as few calls as possible.
  */
 
-void sortDoctorsByName() {
-    Doctor temp;
-    for (int i = 0; i < doctorCount - 1; i++) {
-        for (int j = i + 1; j < doctorCount; j++) {
-            if (strcmp(doctors[i].name, doctors[j].name) > 0) {
-                temp = doctors[i];
-                doctors[i] = doctors[j];
-                doctors[j] = temp;
-            }
-        }
+int tableRun(RecordTable *table, int index, int count) {
+    int run;
+    if (index < table->mappedCount) {
+        run = table->mappedCount - index;
+    } else {
+        run = TABLE_CHUNK_SIZE - ((index - table->mappedCount) & (TABLE_CHUNK_SIZE - 1));
     }
-    printf("Doctors sorted by name.\n");
+    return run < count ? run : count;
 }
 
-// Function to sort patients by age
+// Function to write the records of a table to a file
 
 /**
- * @brief Sorts the list of patients in ascending order of their ages.
+ * @brief Writes the first 'count' records of a table to a file.
+ * 
+ * Records are written one contiguous run (mapped region or chunk) at a time, so 
+ * the output is the same as writing a single contiguous array of records.
  * 
- * Uses a bubble sort algorithm to sort the `patients` array based 
- * on the `age` field. This is useful for generating reports or 
- * prioritizing patients by age.
+ * @return 1 if every record was written, 0 otherwise.
  */
 
-void sortPatientsByAge() {
-    Patient temp;
-    for (int i = 0; i < patientCount - 1; i++) {
-        for (int j = i + 1; j < patientCount; j++) {
-            if (patients[i].age > patients[j].age) {
-                temp = patients[i];
-                patients[i] = patients[j];
-                patients[j] = temp;
-            }
+int tableWrite(RecordTable *table, int count, FILE *file) {
+    for (int start = 0; start < count; ) {
+        int records = tableRun(table, start, count - start);
+        if (fwrite(tableAt(table, start), table->recordSize, records, file) != (size_t)records) {
+            return 0;
         }
+        start += records;
     }
-    printf("Patients sorted by age.\n");
+    return 1;
 }
 
-// Function to save the current data of doctors, patients, and staff into respective files.
+// Function to read records from a file into a table
 
-/*
- * Function to save the current data of doctors, patients, and staff into respective files.
- * This function writes the data of all doctors, patients, and staff to their corresponding files in binary mode.
- * It first writes the count of each category (doctors, patients, and staff) and then their respective data.
- * If the files are successfully opened, the data is saved; otherwise, an error message is displayed.
- */
-
-void saveData() {
-    // Open the files for writing in binary mode
-    FILE *doctorFile = fopen("doctors.dat", "wb");
-    FILE *patientFile = fopen("patients.dat", "wb");
-    FILE *staffFile = fopen("staff.dat", "wb");  // New staff data file
-
-    // Check if all files are opened successfully
-    if (doctorFile && patientFile && staffFile) {
-        // Save the number of doctors followed by the data of each doctor
-        fwrite(&doctorCount, sizeof(int), 1, doctorFile);
-        fwrite(doctors, sizeof(Doctor), doctorCount, doctorFile);
-
-        // Save the number of patients followed by the data of each patient
-        fwrite(&patientCount, sizeof(int), 1, patientFile);
-        fwrite(patients, sizeof(Patient), patientCount, patientFile);
-
-        // Save the number of staff followed by the data of each staff member
-        fwrite(&staffCount, sizeof(int), 1, staffFile);
-        fwrite(staff, sizeof(Staff), staffCount, staffFile);
-
-        // Close the files after writing the data
-        fclose(doctorFile);
-        fclose(patientFile);
-        fclose(staffFile);
-    } else {
-        // Error handling if files can't be opened
-        printf("Error saving data.\n");
+/**
+ * @brief Reads 'count' records from a file into the start of a table.
+ * 
+ * Chunks are allocated as they are needed and each chunk is filled with a single read.
+ * 
+ * @return 1 if every record was read, 0 otherwise.
+ */
+
+int tableRead(RecordTable *table, int count, FILE *file) {
+    for (int start = 0; start < count; ) {
+        void *slot = tableSlot(table, start);
+        int records = tableRun(table, start, count - start);
+        if (slot == NULL || fread(slot, table->recordSize, records, file) != (size_t)records) {
+            return 0;
+        }
+        start += records;
     }
+    return 1;
 }
 
-// Function to load previously saved data for doctors, patients, and staff from files.
+// Functions to access the records stored in each table
 
-/*
- * Function to load previously saved data for doctors, patients, and staff from files.
- * This function opens the corresponding files in binary mode and reads the data into the memory.
- * It reads the count of doctors, patients, and staff, followed by the actual data of each.
- * If the files don't exist or can't be opened, a message is displayed indicating no saved data.
+/**
+ * @brief Return a pointer to the doctor, patient, staff member, shift, role or medication catalog record stored at an index.
+ * 
+ * These are thin typed wrappers around tableAt for the global tables.
  */
 
-void loadData() {
-    // Open the files for reading in binary mode
-    FILE *doctorFile = fopen("doctors.dat", "rb");
-    FILE *patientFile = fopen("patients.dat", "rb");
-    FILE *staffFile = fopen("staff.dat", "rb");  // New staff data file
+Doctor *doctorAt(int index) {
+    return (Doctor *)tableAt(&doctorTable, index);
+}
 
-    // Check if all files exist and can be read
-    if (doctorFile && patientFile && staffFile) {
-        // Read the number of doctors and their data from the file
-        fread(&doctorCount, sizeof(int), 1, doctorFile);
-        fread(doctors, sizeof(Doctor), doctorCount, doctorFile);
+Patient *patientAt(int index) {
+    return (Patient *)tableAt(&patientTable, index);
+}
 
-        // Read the number of patients and their data from the file
-        fread(&patientCount, sizeof(int), 1, patientFile);
-        fread(patients, sizeof(Patient), patientCount, patientFile);
+Staff *staffAt(int index) {
+    return (Staff *)tableAt(&staffTable, index);
+}
 
-        // Read the number of staff and their data from the file
-        fread(&staffCount, sizeof(int), 1, staffFile);
-        fread(staff, sizeof(Staff), staffCount, staffFile);
+Shift *shiftAt(int index) {
+    return (Shift *)tableAt(&shiftTable, index);
+}
 
-        // Close the files after reading
-        fclose(doctorFile);
-        fclose(patientFile);
-        fclose(staffFile);
-    } else {
-        // If files don't exist, print a message and start fresh
-        printf("No saved data found, starting fresh.\n");
-    }
+Role *roleAt(int index) {
+    return (Role *)tableAt(&roleTable, index);
 }
 
-// Function to generate a detailed report of staff members and their schedules.
+Medication *medicationAt(int index) {
+    return (Medication *)tableAt(&medicationTable, index);
+}
 
-/*
- * Function to generate a detailed report of staff members and their schedules.
- * This function iterates over all staff members and generates a report that includes:
- * - Staff member's name, role, and contact information
- * - The shifts assigned to each staff member
- * - A summary of the total shifts assigned across all staff
- * - A breakdown of shifts per day of the week
- * It also includes details of staff members who have no shifts assigned.
+Dosage *dosageAt(int index) {
+    return (Dosage *)tableAt(&dosageTable, index);
+}
+
+Prescription *prescriptionAt(int index) {
+    return (Prescription *)tableAt(&prescriptionTable, index);
+}
+
+// Function to hash a name for the name indexes
+
+/**
+ * @brief Computes the 32-bit FNV-1a hash of a name.
+ * 
+ * Any hash value is valid, because empty and deleted slots are marked by their 
+ * index rather than by their hash.
+ * 
+ * @return The hash of the name.
  */
 
-void generateReport() {
-    // If no staff members are available, print a message and return
-    if (staffCount == 0) {
-        printf("No staff members available to generate a report.\n");
-        return;
+unsigned int hashName(const char *name) {
+    unsigned int hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
     }
+    return hash;
+}
 
-    // Print header for the staff report
-    printf("\n--- Staff Schedule Report ---\n");
-    printf("Total number of staff: %d\n", staffCount);
-    
-    int totalShifts = 0;
-    int staffWithNoShifts = 0;
+// Function to find a record by name
 
-    // Loop through all staff members to display their details
-    for (int i = 0; i < staffCount; i++) {
-        printf("\nStaff Member: %s\n", staff[i].name);
-        printf("Role: %s\n", staff[i].role);
-        printf("Contact Info: %s\n", staff[i].contactInfo);
+/**
+ * @brief Looks up the record with the given name in a name index.
+ * 
+ * Probes the slots starting at the name's hash until the name or an empty slot 
+ * is found. Takes O(1) time on average.
+ * 
+ * @return The index of the record in its table, or -1 if no record has that name.
+ */
 
-        // Count total shifts assigned across all staff members
-        totalShifts += staff[i].shiftCount;
+int nameIndexFind(NameIndex *index, const char *name) {
+    if (index->stale) {
+        nameIndexRebuild(index);
+    }
+    if (index->capacity == 0) {
+        return -1;
+    }
 
-        // If the staff member has no shifts, note it and print a message
-        if (staff[i].shiftCount == 0) {
-            staffWithNoShifts++;
-            printf("No shifts assigned.\n");
-        } else {
-            // Print each shift assigned to the staff member
-            printf("Assigned Shifts:\n");
-            for (int j = 0; j < staff[i].shiftCount; j++) {
-                printf("  Day: %s, Shift: %s to %s, Role: %s\n", 
-                    staff[i].schedule[j].day, 
-                    staff[i].schedule[j].startTime, 
-                    staff[i].schedule[j].endTime, 
-                    staff[i].schedule[j].role);
-            }
+    unsigned int hash = hashName(name);
+    int mask = index->capacity - 1;
+    for (int i = hash & mask; index->slots[i].index != NAME_SLOT_EMPTY; i = (i + 1) & mask) {
+        NameSlot *slot = &index->slots[i];
+        if (slot->index >= 0 && slot->hash == hash &&
+            strcmp((char *)tableAt(index->table, slot->index) + index->nameOffset, name) == 0) {
+            return slot->index;
         }
     }
+    return -1;
+}
 
-    // Print summary of shifts and staff members with no shifts
-    printf("\n--- Report Summary ---\n");
-    printf("Total number of shifts assigned across all staff: %d\n", totalShifts);
-    printf("Staff members with no shifts: %d\n", staffWithNoShifts);
+// Function to add a record's name to a name index
 
-    // Count shifts for each day of the week (Sunday-Saturday)
-    printf("\n--- Shifts Summary by Day ---\n");
-    int shiftsPerDay[7] = {0};  // Array for counting shifts per day (7 days a week)
+/**
+ * @brief Adds the name of the record at 'recordIndex' to a name index.
+ * 
+ * The slot array is doubled (dropping deleted markers) whenever it becomes 
+ * more than half full. A name that is already in the index is not added again.
+ * 
+ * @return 1 if the name was added, 0 if the name is already in the index, -1 if memory ran out.
+ */
 
-    // Loop through all staff and their shifts to count shifts for each day
-    for (int i = 0; i < staffCount; i++) {
-        for (int j = 0; j < staff[i].shiftCount; j++) {
-            if (strcmp(staff[i].schedule[j].day, "Sunday") == 0) {
-                shiftsPerDay[0]++;
-            } else if (strcmp(staff[i].schedule[j].day, "Monday") == 0) {
-                shiftsPerDay[1]++;
-            } else if (strcmp(staff[i].schedule[j].day, "Tuesday") == 0) {
-                shiftsPerDay[2]++;
-            } else if (strcmp(staff[i].schedule[j].day, "Wednesday") == 0) {
-                shiftsPerDay[3]++;
-            } else if (strcmp(staff[i].schedule[j].day, "Thursday") == 0) {
-                shiftsPerDay[4]++;
-            } else if (strcmp(staff[i].schedule[j].day, "Friday") == 0) {
-                shiftsPerDay[5]++;
-            } else if (strcmp(staff[i].schedule[j].day, "Saturday") == 0) {
-                shiftsPerDay[6]++;
-            }
-        }
-    }
-
-    // Print the number of shifts assigned per day
-    const char *daysOfWeek[] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
-    for (int i = 0; i < 7; i++) {
-        printf("%s: %d shifts\n", daysOfWeek[i], shiftsPerDay[i]);
+int nameIndexInsert(NameIndex *index, int recordIndex) {
+    const char *name = (char *)tableAt(index->table, recordIndex) + index->nameOffset;
+    if (nameIndexFind(index, name) != -1) {
+        return 0;
     }
 
-    // End of report
-    printf("\n--- End of Report ---\n");
-}
-
-// Function to calculate patient's bill based on room and doctor's fees.
+    // Grow and rehash the slots so that at most half of them are in use
+    if ((index->used + 1) * 2 > index->capacity) {
+        int newCapacity = index->capacity > 0 ? index->capacity : 64;
+        while ((index->used + 1) * 2 > newCapacity) {
+            newCapacity *= 2;
+        }
+        NameSlot *newSlots = malloc(newCapacity * sizeof(NameSlot));
+        if (newSlots == NULL) {
+            return -1;
+        }
+        for (int i = 0; i < newCapacity; i++) {
+            newSlots[i].index = NAME_SLOT_EMPTY;
+        }
 
-/*
- * Function to calculate the total bill for a patient based on room charge and doctor's fee.
- * This function calculates the total bill by adding the fixed room charge to the doctor's fee for the patient.
- * The room charge is predefined (in this case, $100), and the doctor's fee is fetched from the doctor's data.
- * The function returns the sum as the patient's total bill.
- */
+        int used = 0;
+        for (int i = 0; i < index->capacity; i++) {
+            if (index->slots[i].index >= 0) {
+                int j = index->slots[i].hash & (newCapacity - 1);
+                while (newSlots[j].index != NAME_SLOT_EMPTY) {
+                    j = (j + 1) & (newCapacity - 1);
+                }
+                newSlots[j] = index->slots[i];
+                used++;
+            }
+        }
 
-int calculateBill(Patient *patient) {
-    int roomCharge = 100;  // Example room charge
-    int doctorFee = doctors[patient->doctorID].visitingFees;
+        free(index->slots);
+        index->slots = newSlots;
+        index->capacity = newCapacity;
+        index->used = used;
+    }
 
-    return roomCharge + doctorFee;
+    // Store the name in the first empty slot of its probe sequence
+    unsigned int hash = hashName(name);
+    int mask = index->capacity - 1;
+    int i = hash & mask;
+    while (index->slots[i].index >= 0) {
+        i = (i + 1) & mask;
+    }
+    if (index->slots[i].index == NAME_SLOT_EMPTY) {
+        index->used++;
+    }
+    index->slots[i].hash = hash;
+    index->slots[i].index = recordIndex;
+    return 1;
 }
 
-// Function to assign medications to a patient
+// Function to remove a name from a name index
 
-/*
- * Function to assign medication to a patient by updating their medication list.
- * This function allows the assignment of a medication to a patient if they haven't reached the maximum medication limit.
- * The user is prompted to enter the medication name and dosage, which is then added to the patient's medication list.
- * If the patient has already reached the maximum allowed medications, an error message is displayed.
+/**
+ * @brief Removes a name from a name index.
+ * 
+ * The slot is replaced by a deleted marker so that probe sequences passing 
+ * through it keep working. Does nothing if the name is not in the index.
  */
 
-void assignMedicationToPatient(int patientIndex) {
-    if (patients[patientIndex].medicationCount < MAX_MEDICATIONS) {
-        printf("Enter medication name: ");
-        scanf("%s", patients[patientIndex].medications[patients[patientIndex].medicationCount].name);
-        printf("Enter medication dosage: ");
-        scanf("%s", patients[patientIndex].medications[patients[patientIndex].medicationCount].dosage);
+void nameIndexRemove(NameIndex *index, const char *name) {
+    if (index->stale) {
+        nameIndexRebuild(index);
+    }
+    if (index->capacity == 0) {
+        return;
+    }
 
-        patients[patientIndex].medicationCount++;
-        printf("Medication assigned successfully!\n");
-    } else {
-        printf("This patient has reached the maximum number of medications.\n");
+    unsigned int hash = hashName(name);
+    int mask = index->capacity - 1;
+    for (int i = hash & mask; index->slots[i].index != NAME_SLOT_EMPTY; i = (i + 1) & mask) {
+        NameSlot *slot = &index->slots[i];
+        if (slot->index >= 0 && slot->hash == hash &&
+            strcmp((char *)tableAt(index->table, slot->index) + index->nameOffset, name) == 0) {
+            slot->index = NAME_SLOT_DELETED;
+            return;
+        }
     }
 }
 
-// Function to view all doctors
+// Function to rebuild a name index from its table
 
-/*
- * Function to display a list of all patients, their details, and assigned medications.
- * This function iterates over all patients, printing their personal details like name, age, and doctor assigned to them.
- * It also lists medications that are assigned to each patient, if any.
- * If no patients are available, a message is displayed indicating no data is available.
+/**
+ * @brief Clears a name index and adds every record of its table.
+ * 
+ * Called on the first lookup after the index was marked stale (for example after 
+ * loading data from files). Duplicate names are reported; lookups for a duplicated 
+ * name resolve to the first record with that name.
  */
 
-void viewDoctors() {
-    if (doctorCount == 0) {
-        printf("No doctors available.\n");
-        return;
+void nameIndexRebuild(NameIndex *index) {
+    for (int i = 0; i < index->capacity; i++) {
+        index->slots[i].index = NAME_SLOT_EMPTY;
     }
+    index->used = 0;
+    index->stale = 0;
 
-    printf("\n----- Doctors List -----\n");
-    for (int i = 0; i < doctorCount; i++) {
-        printf("Doctor #%d\n", i + 1);
-        printf("Name: %s\n", doctors[i].name);
-        printf("Age: %d\n", doctors[i].age);
-        printf("Specialty: %s\n", doctors[i].specialty);
-        printf("Visiting Fee: %d\n\n", doctors[i].visitingFees);
+    for (int i = 0; i < *index->count; i++) {
+        if (((char *)tableAt(index->table, i) + index->nameOffset)[0] == '\0') {
+            continue;  // A free slot (see PatientIDMap)
+        }
+        int result = nameIndexInsert(index, i);
+        if (result == 0) {
+            printf("Warning: duplicate %s name '%s' in saved data.\n", index->kind,
+                (char *)tableAt(index->table, i) + index->nameOffset);
+        } else if (result < 0) {
+            printf("Not enough memory to index %s names.\n", index->kind);
+            index->stale = 1;
+            return;
+        }
     }
 }
 
-// Function to view all patients
+// Function to find or add a role name
 
-/*
- * Function to view a list of all patients along with their personal and medical details.
- * This function iterates through the list of patients and displays:
- * - Patient's name, age, diagnosis, and room number
- * - Assigned doctor's name
- * - List of medications assigned to the patient, if any
- * If no patients are available, a message is displayed indicating the absence of patients.
+/**
+ * @brief Returns the index of a role name in the role table, adding it if it is new.
+ * 
+ * Each distinct role is stored once, so shifts only need to keep a small role index.
+ * 
+ * @return The index of the role, or -1 if memory ran out.
  */
 
-void viewPatients() {
-    if (patientCount == 0) {
-        printf("No patients available.\n");
-        return;
+int internRole(const char *name) {
+    int roleID = nameIndexFind(&roleNameIndex, name);
+    if (roleID != -1) {
+        return roleID;
     }
 
-    printf("\n----- Patients List -----\n");
-    for (int i = 0; i < patientCount; i++) {
-        printf("Patient #%d\n", i + 1);
-        printf("Name: %s\n", patients[i].name);
-        printf("Age: %d\n", patients[i].age);
-        printf("Diagnosis: %s\n", patients[i].diagnosis);
-        printf("Room Number: %d\n", patients[i].roomNumber);
-        printf("Assigned Doctor: %s\n", doctors[patients[i].doctorID].name);  // Show doctor's name
-
-        // Display medications
-        if (patients[i].medicationCount > 0) {
-            printf("Medications:\n");
-            for (int j = 0; j < patients[i].medicationCount; j++) {
-                printf("  %s, Dosage: %s\n", patients[i].medications[j].name, patients[i].medications[j].dosage);
-            }
-        } else {
-            printf("No medications assigned.\n");
-        }
+    Role *role = tableSlot(&roleTable, roleCount);
+    if (role == NULL) {
+        return -1;
     }
+    strncpy(role->name, name, sizeof(role->name) - 1);
+    role->name[sizeof(role->name) - 1] = '\0';
+    if (nameIndexInsert(&roleNameIndex, roleCount) < 0) {
+        return -1;
+    }
+    return roleCount++;
 }
 
-// Function to schedule an appointment
+// Function to parse a day of the week
 
-/*
- * Function to schedule a new appointment between a patient and a doctor.
- * This function performs the following steps:
- * - Requests a valid patient ID and checks if the patient exists
- * - Requests a valid doctor ID and checks if the doctor exists
- * - Takes the appointment date as input from the user
- * - Stores the appointment information in the appointments list
- * - If the maximum appointment limit is reached, an error message is displayed
+/**
+ * @brief Parses the name of a day of the week, ignoring case.
+ * 
+ * Accepts full names (e.g., Monday) and three-letter abbreviations (e.g., mon).
+ * 
+ * @return The Weekday value for the day, or -1 if the text is not a day of the week.
  */
 
-void scheduleAppointment() {
-    if (appointmentCount < MAX_APPOINTMENTS) {
-        int patientID, doctorID;
-        char appointmentDate[20];
-
-        // Get the patient ID and validate it
-        printf("Enter patient ID (0-%d): ", patientCount - 1);
-        patientID = readInteger();
-        if (patientID < 0 || patientID >= patientCount) {
-            printf("Invalid patient ID.\n");
-            return;
-        }
+int parseWeekday(const char *text) {
+    size_t length = strlen(text);
+    if (length < 3) {
+        return -1;
+    }
 
-        // Get the doctor ID and validate it
-        printf("Enter doctor ID (0-%d): ", doctorCount - 1);
-        doctorID = readInteger();
-        if (doctorID < 0 || doctorID >= doctorCount) {
-            printf("Invalid doctor ID.\n");
-            return;
+    for (int day = SUNDAY; day <= SATURDAY; day++) {
+        const char *name = weekdayNames[day];
+        if (length != 3 && length != strlen(name)) {
+            continue;
         }
 
-        // Get the appointment date
-        printf("Enter appointment date (YYYY-MM-DD): ");
-        scanf("%s", appointmentDate);
-
-        // Store the appointment
-        appointments[appointmentCount].patientID = patientID;
-        appointments[appointmentCount].doctorID = doctorID;
-        strcpy(appointments[appointmentCount].appointmentDate, appointmentDate);
-
-        // Increment the appointment count
-        appointmentCount++;
-        printf("Appointment scheduled successfully!\n");
-    } else {
-        printf("Maximum appointment limit reached.\n");
+        size_t i = 0;
+        while (i < length && tolower((unsigned char)text[i]) == tolower((unsigned char)name[i])) {
+            i++;
+        }
+        if (i == length) {
+            return day;
+        }
     }
+    return -1;
 }
 
-// Function to view all appointments
+// Function to parse a time of day
 
-/*
- * Function to view a list of all scheduled appointments.
- * This function iterates through all scheduled appointments and displays:
- * - Patient's name
- * - Doctor's name
- * - Appointment date
- * If no appointments are scheduled, it will print a message indicating so.
- * It also validates the patient and doctor data before displaying the appointment information.
+/**
+ * @brief Parses a time of day into minutes since midnight.
+ * 
+ * Accepts 24-hour times such as 09:00, 17:30 or 9, optionally followed by 
+ * AM or PM (e.g., 9AM, 5:30pm).
+ * 
+ * @return The number of minutes since midnight (0-1439), or -1 if the time is invalid.
  */
 
-void viewAppointments() {
-    if (appointmentCount == 0) {
-        printf("No appointments scheduled.\n");
-        return;
+int parseTime(const char *text) {
+    int hours = 0, minutes = 0, digits = 0;
+
+    while (isdigit((unsigned char)*text)) {
+        hours = hours * 10 + (*text++ - '0');
+        if (++digits > 2) {
+            return -1;
+        }
+    }
+    if (digits == 0) {
+        return -1;
     }
 
-    printf("\n----- Appointments List -----\n");
-    for (int i = 0; i < appointmentCount; i++) {
-        int patientID = appointments[i].patientID;
-        int doctorID = appointments[i].doctorID;
+    if (*text == ':') {
+        text++;
+        if (!isdigit((unsigned char)text[0]) || !isdigit((unsigned char)text[1])) {
+            return -1;
+        }
+        minutes = (text[0] - '0') * 10 + (text[1] - '0');
+        text += 2;
+    }
 
-        // Validate the patient and doctor ID before displaying
-        if (patientID >= 0 && patientID < patientCount && doctorID >= 0 && doctorID < doctorCount) {
-            printf("Appointment #%d\n", i + 1);
-            printf("Patient: %s\n", patients[patientID].name);
-            printf("Doctor: %s\n", doctors[doctorID].name);
-            printf("Date: %s\n\n", appointments[i].appointmentDate);
-        } else {
-            printf("Error: Invalid patient or doctor data for appointment #%d\n", i + 1);
+    if (tolower((unsigned char)text[0]) == 'a' || tolower((unsigned char)text[0]) == 'p') {
+        if (tolower((unsigned char)text[1]) != 'm' || hours < 1 || hours > 12) {
+            return -1;
         }
+        hours = hours % 12 + (tolower((unsigned char)text[0]) == 'p' ? 12 : 0);
+        text += 2;
+    }
+
+    if (*text != '\0' || hours > 23 || minutes > 59) {
+        return -1;
     }
+    return hours * 60 + minutes;
 }
 
-// Function to view the current bill of a patient
+// Function to format a time of day
 
-/*
- * Function to view and calculate the total bill of a specific patient.
- * This function performs the following steps:
- * - Requests the patient ID and validates it
- * - Calculates the patient's total bill by adding the room charge and doctor's fee
- * - Displays the patient's name, room charge, doctor's fee, and the total bill amount
- * If an invalid patient ID is entered, an error message is displayed.
+/**
+ * @brief Formats minutes since midnight as a 24-hour HH:MM time.
+ * 
+ * @param buffer A buffer of at least 6 characters receiving the text.
  */
 
-void viewPatientBill() {
-    printf("Enter patient ID to view the bill: ");
-    int patientIndex = readInteger();
+void formatTime(int minutes, char *buffer) {
+    sprintf(buffer, "%02d:%02d", (minutes / 60) % 100, minutes % 60);
+}
+
+// Function to add a shift to a staff member
 
-    if (patientIndex >= 0 && patientIndex < patientCount) {
-        // Calculate the bill for the patient
-        int bill = calculateBill(&patients[patientIndex]);
+/**
+ * @brief Appends a shift to the end of a staff member's shift list.
+ * 
+ * The shift is stored in the shared shift table and linked after the staff 
+ * member's current last shift, so adding a shift takes O(1) time.
+ * 
+ * @return The index of the new shift, or -1 if memory ran out.
+ */
 
-        // Display the calculated bill
-        printf("Patient: %s\n", patients[patientIndex].name);
-        printf("Room Charge: 100\n");  // Example room charge
-        printf("Doctor's Fee: %d\n", doctors[patients[patientIndex].doctorID].visitingFees);
-        printf("Total Bill: %d\n", bill);
+int appendShift(int staffIndex, int day, int startTime, int endTime, int roleID) {
+    Shift *shift = tableSlot(&shiftTable, shiftCount);
+    if (shift == NULL) {
+        return -1;
+    }
+    shift->next = -1;
+    shift->day = (unsigned char)day;
+    shift->startTime = (short)startTime;
+    shift->endTime = (short)endTime;
+    shift->roleID = (short)roleID;
+
+    Staff *member = staffAt(staffIndex);
+    if (member->lastShift == -1) {
+        member->firstShift = shiftCount;
     } else {
-        printf("Invalid patient ID.\n");
+        shiftAt(member->lastShift)->next = shiftCount;
     }
+    member->lastShift = shiftCount;
+    member->shiftCount++;
+    return shiftCount++;
 }
 
-// Function to add a new staff member
+// Function to print the shifts of a staff member
 
-/*
- * Function to add a new staff member to the system.
- * This function prompts the user for the staff member's:
- * - Name
- * - Role (e.g., Nurse, Admin, etc.)
- * - Contact information
- * It then initializes the shift count to 0 and adds the staff member to the staff list.
- * If the maximum staff limit has been reached, an error message is displayed.
+/**
+ * @brief Prints every shift of a staff member, one per line.
+ * 
+ * Follows the staff member's linked list of shifts through the shift table.
  */
 
-void addStaff() {
-    if (staffCount < MAX_STAFF) {
-        printf("Enter staff member's name: ");
-        scanf("%s", staff[staffCount].name);
-        printf("Enter staff member's role (e.g., Nurse, Admin): ");
-        scanf("%s", staff[staffCount].role);
-        printf("Enter staff member's contact info: ");
-        scanf("%s", staff[staffCount].contactInfo);
-        
-        staff[staffCount].shiftCount = 0;  // Initialize shift count
-        staffCount++;
-        printf("Staff member added successfully!\n");
-    } else {
-        printf("Maximum staff limit reached.\n");
+void printShifts(Staff *member) {
+    char start[8], end[8];
+    for (int i = member->firstShift; i != -1; i = shiftAt(i)->next) {
+        Shift *shift = shiftAt(i);
+        formatTime(shift->startTime, start);
+        formatTime(shift->endTime, end);
+        printf("  Day: %s, Shift: %s to %s, Role: %s\n", 
+            weekdayNames[shift->day], start, end, roleAt(shift->roleID)->name);
     }
 }
 
-
-// Function to assign shift to a staff member
+// Functions of the medication catalog
 
 /*
- * Function to assign a shift to a specific staff member.
- * This function performs the following steps:
- * - Requests the name of the staff member and searches for it in the staff list
- * - If found, it prompts for the details of the shift: day, start time, end time, and role
- * - It then assigns the shift to the staff member and increments their shift count
- * If the staff member is not found, an error message is displayed.
+ * Functions of the medication catalog.
+ * - internMedication / internDosage: Return the index of a medication name or dosage, adding it if it
+ *   is new, or -1 if memory ran out (or, for a dosage, if the text does not fit).
+ * - parseDosage: Split a dosage into its amount and unit and normalize its text.
+ * - appendPrescription: Add a medication to the end of a patient's list in O(1) time.
+ * - compactPrescriptions: Drop the prescriptions of removed patients from the prescription table.
+ * - medicationIndexAdd / medicationIndexReady: Maintain the reverse index from medications to patients.
+ * - medicationIndexSort: Put a medication's list in ID order without repeats or removed patients. A list
+ *   that is already sorted is only read when it is listed, so the server sorts every list before reads.
  */
 
-void assignShiftToStaff() {
-    char name[100];
-    printf("Enter the staff member's name to assign shift: ");
-    scanf("%s", name);
+int internMedication(const char *name) {
+    int medicationID = nameIndexFind(&medicationNameIndex, name);
+    if (medicationID != -1) {
+        return medicationID;
+    }
 
-    int staffIndex = -1;
-    for (int i = 0; i < staffCount; i++) {
-        if (strcmp(staff[i].name, name) == 0) {
-            staffIndex = i;
-            break;
-        }
+    Medication *medication = tableSlot(&medicationTable, medicationCatalogCount);
+    if (medication == NULL || !copyText(medication->name, sizeof(medication->name), name) ||
+        nameIndexInsert(&medicationNameIndex, medicationCatalogCount) < 0) {
+        return -1;
     }
+    return medicationCatalogCount++;
+}
 
-    if (staffIndex == -1) {
-        printf("Staff member not found.\n");
-        return;
+int parseDosage(const char *text, Dosage *dosage) {
+    memset(dosage, 0, sizeof(Dosage));
+    if (isdigit((unsigned char)text[0]) || (text[0] == '.' && isdigit((unsigned char)text[1]))) {
+        char *end;
+        double amount = strtod(text, &end);
+        const char *unit = end;
+        while (isspace((unsigned char)*unit)) {
+            unit++;
+        }
+        int length = snprintf(dosage->text, sizeof(dosage->text), "%.*s%s%s", (int)(end - text), text,
+                              *unit != '\0' ? " " : "", unit);
+        if (length < (int)sizeof(dosage->text) && copyText(dosage->unit, sizeof(dosage->unit), unit)) {
+            dosage->amount = amount;
+            return 1;
+        }
+        memset(dosage, 0, sizeof(Dosage));
     }
 
-    Shift shift;
-    printf("Enter day for the shift: ");
-    scanf("%s", shift.day);
-    printf("Enter start time for the shift: ");
-    scanf("%s", shift.startTime);
-    printf("Enter end time for the shift: ");
-    scanf("%s", shift.endTime);
-    printf("Enter role for the shift: ");
-    scanf("%s", shift.role);
+    // Keep a dosage without an amount (e.g., "as needed") as it was written
+    dosage->amount = -1;
+    return copyText(dosage->text, sizeof(dosage->text), text);
+}
+
+int internDosage(const char *text) {
+    Dosage parsed;
+    if (!parseDosage(text, &parsed)) {
+        return -1;
+    }
+    int dosageID = nameIndexFind(&dosageIndex, parsed.text);
+    if (dosageID != -1) {
+        return dosageID;
+    }
 
-    staff[staffIndex].schedule[staff[staffIndex].shiftCount] = shift;
-    staff[staffIndex].shiftCount++;
-    printf("Shift assigned successfully to %s!\n", staff[staffIndex].name);
+    Dosage *dosage = tableSlot(&dosageTable, dosageCount);
+    if (dosage == NULL) {
+        return -1;
+    }
+    *dosage = parsed;
+    if (nameIndexInsert(&dosageIndex, dosageCount) < 0) {
+        return -1;
+    }
+    return dosageCount++;
 }
 
+int appendPrescription(Patient *patient, int medicationID, int dosageID) {
+    Prescription *prescription = tableSlot(&prescriptionTable, prescriptionCount);
+    if (prescription == NULL) {
+        return -1;
+    }
+    prescription->next = -1;
+    prescription->medicationID = medicationID;
+    prescription->dosageID = dosageID;
 
-// Function to view all staff schedules
+    if (patient->lastMedication == -1) {
+        patient->firstMedication = prescriptionCount;
+    } else {
+        prescriptionAt(patient->lastMedication)->next = prescriptionCount;
+    }
+    patient->lastMedication = prescriptionCount;
+    patient->medicationCount++;
+    return prescriptionCount++;
+}
+
+// Function to compact the prescription table
+
+/**
+ * @brief Moves the prescriptions of the remaining patients down over those of removed patients.
+ *
+ * Each live prescription moves to its rank among the live prescriptions, which never
+ * overwrites a prescription that has not moved yet, and the patients' lists are relinked
+ * through a table of new indexes. Takes O(n) time in the size of the table, so it only
+ * runs before saving, and only when patients with medications were removed.
+ */
+
+void compactPrescriptions() {
+    if (unlinkedPrescriptions == 0 || prescriptionCount == 0) {
+        return;
+    }
+    int *newIndex = malloc(prescriptionCount * sizeof(int));
+    if (newIndex == NULL) {
+        return;  // The file is larger than it needs to be, but still correct
+    }
+
+    // Mark the prescriptions still on some patient's list, then number them in table order
+    for (int i = 0; i < prescriptionCount; i++) {
+        newIndex[i] = -1;
+    }
+    for (int i = 0; i < patientSlotCount; i++) {
+        Patient *patient = patientAt(i);
+        for (int p = patient->id >= 0 ? patient->firstMedication : -1; p != -1; p = prescriptionAt(p)->next) {
+            newIndex[p] = 0;
+        }
+    }
+    int kept = 0;
+    for (int i = 0; i < prescriptionCount; i++) {
+        if (newIndex[i] == 0) {
+            newIndex[i] = kept++;
+        }
+    }
+
+    // Move the prescriptions down and relink the lists
+    for (int i = 0; i < prescriptionCount; i++) {
+        if (newIndex[i] != -1) {
+            Prescription *prescription = prescriptionAt(newIndex[i]);
+            *prescription = *prescriptionAt(i);
+            if (prescription->next != -1) {
+                prescription->next = newIndex[prescription->next];
+            }
+        }
+    }
+    for (int i = 0; i < patientSlotCount; i++) {
+        Patient *patient = patientAt(i);
+        if (patient->id >= 0 && patient->firstMedication != -1) {
+            patient->firstMedication = newIndex[patient->firstMedication];
+            patient->lastMedication = newIndex[patient->lastMedication];
+        }
+    }
+    prescriptionCount = kept;
+    unlinkedPrescriptions = 0;
+    free(newIndex);
+}
+
+void medicationIndexAdd(int medicationID, int patientID) {
+    MedicationIndex *index = &medicationIndex;
+    if (index->stale) {
+        return;
+    }
+    if (medicationID >= index->listCount) {
+        int listCount = index->listCount > 0 ? index->listCount : 64;
+        while (listCount <= medicationID) {
+            listCount *= 2;
+        }
+        PatientList *lists = realloc(index->lists, listCount * sizeof(PatientList));
+        if (lists == NULL) {
+            index->stale = 1;
+            return;
+        }
+        memset(lists + index->listCount, 0, (listCount - index->listCount) * sizeof(PatientList));
+        index->lists = lists;
+        index->listCount = listCount;
+    }
+
+    PatientList *list = &index->lists[medicationID];
+    if (list->count > 0 && list->patients[list->count - 1] == patientID) {
+        return;  // The patient's last medication was the same one
+    }
+    if (list->count == list->capacity) {
+        int capacity = list->capacity > 0 ? list->capacity * 2 : 8;
+        int *patients = realloc(list->patients, capacity * sizeof(int));
+        if (patients == NULL) {
+            index->stale = 1;
+            return;
+        }
+        list->patients = patients;
+        list->capacity = capacity;
+    }
+    list->sorted = list->count == 0 || (list->sorted && patientID > list->patients[list->count - 1]);
+    list->patients[list->count++] = patientID;
+}
+
+int medicationIndexReady() {
+    MedicationIndex *index = &medicationIndex;
+    if (!index->stale) {
+        return 1;
+    }
+    for (int i = 0; i < index->listCount; i++) {
+        index->lists[i].count = 0;
+    }
+    index->stale = 0;
+
+    for (int i = 0; i < patientSlotCount && !index->stale; i++) {
+        Patient *patient = patientAt(i);
+        for (int p = patient->id >= 0 ? patient->firstMedication : -1; p != -1; p = prescriptionAt(p)->next) {
+            medicationIndexAdd(prescriptionAt(p)->medicationID, patient->id);
+        }
+    }
+    if (index->stale) {
+        printf("Not enough memory to index the medications.\n");
+        return 0;
+    }
+    return 1;
+}
+
+void medicationIndexSort(PatientList *list) {
+    if (list->count > 1) {
+        qsort(list->patients, list->count, sizeof(int), compareSlots);  // IDs sort like slot numbers
+    }
+    int kept = 0;
+    for (int i = 0; i < list->count; i++) {
+        int patientID = list->patients[i];
+        if ((kept == 0 || list->patients[kept - 1] != patientID) && patientSlot(patientID) >= 0) {
+            list->patients[kept++] = patientID;
+        }
+    }
+    list->count = kept;
+    list->sorted = 1;
+}
+
+// Function to list the patients on a medication
+
+/**
+ * @brief Lists every patient on a medication, in ID order, through the output layer.
+ *
+ * Reads the medication's list in the reverse index, sorting it first if patients were added
+ * out of order (see medicationIndexSort), so the work is proportional to the patients listed.
+ *
+ * @return STATUS_OK, STATUS_NOT_FOUND if no patient was ever given the medication, or STATUS_NO_MEMORY.
+ */
+
+int listMedicationPatients(const char *name) {
+    int medicationID = nameIndexFind(&medicationNameIndex, name);
+    if (medicationID == -1) {
+        return STATUS_NOT_FOUND;
+    }
+    if (!medicationIndexReady()) {
+        return STATUS_NO_MEMORY;
+    }
+
+    outputBegin();
+    outputText("\n--- Patients on %s ---\n", medicationAt(medicationID)->name);
+    int listed = 0;
+    if (medicationID < medicationIndex.listCount) {
+        PatientList *list = &medicationIndex.lists[medicationID];
+        if (!list->sorted) {
+            medicationIndexSort(list);
+        }
+        for (int i = 0; i < list->count; i++) {
+            if (patientSlot(list->patients[i]) >= 0) {  // Patients removed since the list was sorted are skipped
+                outputPatient(++listed, patientByID(list->patients[i]));
+            }
+        }
+    }
+    if (listed == 0) {
+        outputText("No current patients are on %s.\n", medicationAt(medicationID)->name);
+    }
+    outputEnd();
+    return STATUS_OK;
+}
+
+// Function to find the patients on a medication chosen by the user
+
+/*
+ * Function to find the patients on a medication.
+ * This function prompts for the name of the medication and lists the patients on it
+ * through listMedicationPatients.
+ */
+
+void viewMedicationPatients() {
+    char name[100];
+    printf("Enter medication name: ");
+    scanf("%99s", name);
+    if (listMedicationPatients(name) == STATUS_NOT_FOUND) {
+        printf("No patient has been given %s.\n", name);
+    }
+}
+
+// Functions of the text search
+
+/*
+ * Functions of the text search over patient names, diagnoses and doctor specialties.
+ * - textIndexText: Return the text of a key, or NULL if the record was removed.
+ * - textIndexList: Find (or add) the list of a trigram.
+ * - textIndexAdd / textIndexRemove: Add a record's text, or note that it was removed. insertPatient,
+ *   deletePatient and insertDoctor call them, so the indexes stay current as the data changes.
+ * - textIndexReady: Build an index if it is stale.
+ * - textMatches: Check a text against a query.
+ * - searchRecords: Find the keys of the records that match a query.
+ */
+
+const char *textIndexText(TextIndex *index, int key) {
+    if (index->byPatientID) {
+        int slot = patientSlot(key);
+        return slot < 0 ? NULL : (char *)patientAt(slot) + index->textOffset;
+    }
+    return (char *)tableAt(index->table, key) + index->textOffset;
+}
+
+TrigramList *textIndexList(TextIndex *index, int trigram, int create) {
+    // Grow and rehash the lists so that at most half of the slots are in use
+    if (create && (index->used + 1) * 2 > index->capacity) {
+        int capacity = index->capacity > 0 ? index->capacity * 2 : 1024;
+        TrigramList *lists = calloc(capacity, sizeof(TrigramList));
+        if (lists == NULL) {
+            return NULL;
+        }
+        for (int i = 0; i < capacity; i++) {
+            lists[i].trigram = TRIGRAM_EMPTY;
+        }
+        for (int i = 0; i < index->capacity; i++) {
+            if (index->lists[i].trigram != TRIGRAM_EMPTY) {
+                unsigned int j = ((unsigned int)index->lists[i].trigram * 2654435761u) & (capacity - 1);
+                while (lists[j].trigram != TRIGRAM_EMPTY) {
+                    j = (j + 1) & (capacity - 1);
+                }
+                lists[j] = index->lists[i];
+            }
+        }
+        free(index->lists);
+        index->lists = lists;
+        index->capacity = capacity;
+    }
+    if (index->capacity == 0) {
+        return NULL;
+    }
+
+    unsigned int mask = index->capacity - 1;
+    unsigned int i = ((unsigned int)trigram * 2654435761u) & mask;
+    for (; index->lists[i].trigram != TRIGRAM_EMPTY; i = (i + 1) & mask) {
+        if (index->lists[i].trigram == trigram) {
+            return &index->lists[i];
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    index->lists[i].trigram = trigram;
+    index->used++;
+    return &index->lists[i];
+}
+
+// Function to pad and lowercase a text and split it into trigrams
+
+/**
+ * @brief Writes the trigrams of a text to 'trigrams', in order.
+ * 
+ * With 'padded' set the text is preceded by two TEXT_START bytes, which is how 
+ * texts are indexed and how prefix queries are looked up.
+ * 
+ * @return The number of trigrams (at most the text's length plus 2, and 0 for a text shorter than 3 bytes unpadded).
+ */
+
+int textTrigrams(const char *text, int padded, int *trigrams) {
+    int count = 0;
+    unsigned int window = padded ? (TEXT_START << 8) | TEXT_START : 0;
+    int length = padded ? 2 : 0;
+    for (; *text; text++) {
+        window = ((window << 8) | (unsigned char)tolower((unsigned char)*text)) & 0xFFFFFF;
+        if (++length >= 3) {
+            trigrams[count++] = (int)window;
+        }
+    }
+    return count;
+}
+
+int textIndexAdd(TextIndex *index, int key) {
+    if (index->stale) {
+        return 1;  // Added when the index is built
+    }
+    int trigrams[128];
+    const char *text = textIndexText(index, key);
+    int count = text != NULL ? textTrigrams(text, 1, trigrams) : 0;
+    for (int i = 0; i < count; i++) {
+        TrigramList *list = textIndexList(index, trigrams[i], 1);
+        if (list == NULL) {
+            index->stale = 1;
+            return 0;
+        }
+        if (list->count > 0 && list->keys[list->count - 1] == key) {
+            continue;  // The trigram occurs twice in the text
+        }
+        if (list->count == list->capacity) {
+            int capacity = list->capacity > 0 ? list->capacity * 2 : 4;
+            int *keys = realloc(list->keys, capacity * sizeof(int));
+            if (keys == NULL) {
+                index->stale = 1;
+                return 0;
+            }
+            list->keys = keys;
+            list->capacity = capacity;
+        }
+        list->keys[list->count++] = key;
+    }
+    index->added++;
+    return 1;
+}
+
+void textIndexRemove(TextIndex *index) {
+    if (!index->stale && ++index->removed * 2 > index->added) {
+        index->stale = 1;  // Mostly removed records; rebuild without them
+    }
+}
+
+int textIndexReady(TextIndex *index) {
+    if (!index->stale) {
+        return 1;
+    }
+    for (int i = 0; i < index->capacity; i++) {
+        index->lists[i].count = 0;  // Keep the allocated lists
+    }
+    index->added = index->removed = 0;
+    index->stale = 0;
+
+    // Add the records in key order, so every list comes out sorted
+    if (index->byPatientID) {
+        for (int id = 0; id < patientIDs.nextID && !index->stale; id++) {
+            if (patientSlot(id) >= 0) {
+                textIndexAdd(index, id);
+            }
+        }
+    } else {
+        for (int i = 0; i < doctorCount && !index->stale; i++) {
+            textIndexAdd(index, i);
+        }
+    }
+    if (index->stale) {
+        printf("Not enough memory to index the text for searching.\n");
+        return 0;
+    }
+    return 1;
+}
+
+int textMatches(const char *text, const char *query, int mode) {
+    int ignoreCase = mode == SEARCH_IPREFIX || mode == SEARCH_ICONTAINS;
+    int contains = mode == SEARCH_CONTAINS || mode == SEARCH_ICONTAINS;
+    size_t length = strlen(query);
+    for (; *text; text++) {
+        size_t i = 0;
+        while (i < length && text[i] != '\0' &&
+               (ignoreCase ? tolower((unsigned char)text[i]) == tolower((unsigned char)query[i]) : text[i] == query[i])) {
+            i++;
+        }
+        if (i == length) {
+            return 1;
+        }
+        if (!contains) {
+            return 0;
+        }
+    }
+    return length == 0;
+}
+
+// Function to compare two trigram lists by length
+int compareTrigramLists(const void *first, const void *second) {
+    const TrigramList *a = *(const TrigramList *const *)first, *b = *(const TrigramList *const *)second;
+    return (a->count > b->count) - (a->count < b->count);
+}
+
+// Function to search a text field
+
+/**
+ * @brief Finds the records whose text in a field matches a query, in key order.
+ * 
+ * The query's trigrams (padded for a prefix search) are looked up, and the keys of 
+ * the shortest list are kept if every other list holds them too, which a forward 
+ * binary search finds since all lists are sorted. The survivors are checked with 
+ * textMatches, which drops removed records, trigrams that are not adjacent and 
+ * case mismatches. A substring query shorter than three characters has no 
+ * trigram, so it checks every record instead.
+ * 
+ * @return The number of keys written to a newly allocated '*keys' (to be freed by 
+ * the caller), or -1 if memory ran out.
+ */
+
+int searchRecords(int field, int mode, const char *query, int **keys) {
+    TextIndex *index = &textIndexes[field];
+    int prefix = mode == SEARCH_PREFIX || mode == SEARCH_IPREFIX;
+    int trigrams[128];
+    int trigramCount = strlen(query) < 100 ? textTrigrams(query, prefix, trigrams) : 0;
+    *keys = NULL;
+
+    if (trigramCount == 0) {
+        // Too short to use the index: check every record
+        int keyCount = index->byPatientID ? patientIDs.nextID : doctorCount;
+        int found = 0;
+        if (keyCount > 0 && (*keys = malloc(keyCount * sizeof(int))) == NULL) {
+            return -1;
+        }
+        for (int key = 0; key < keyCount; key++) {
+            const char *text = textIndexText(index, key);
+            if (text != NULL && textMatches(text, query, mode)) {
+                (*keys)[found++] = key;
+            }
+        }
+        return found;
+    }
+
+    if (!textIndexReady(index)) {
+        return -1;
+    }
+    TrigramList *lists[128];
+    for (int i = 0; i < trigramCount; i++) {
+        if ((lists[i] = textIndexList(index, trigrams[i], 0)) == NULL || lists[i]->count == 0) {
+            return 0;  // No text holds this trigram
+        }
+    }
+    qsort(lists, trigramCount, sizeof(lists[0]), compareTrigramLists);
+    if ((*keys = malloc(lists[0]->count * sizeof(int))) == NULL) {
+        return -1;
+    }
+
+    int found = 0, positions[128] = {0};
+    for (int c = 0; c < lists[0]->count; c++) {
+        int key = lists[0]->keys[c], inAll = 1;
+        for (int i = 1; i < trigramCount && inAll; i++) {
+            // Gallop forward from where the previous key was found, then binary search
+            const int *listKeys = lists[i]->keys;
+            int low = positions[i], step = 1, high = low;
+            while (high < lists[i]->count && listKeys[high] < key) {
+                low = high + 1;
+                high += step;
+                step *= 2;
+            }
+            if (high > lists[i]->count) {
+                high = lists[i]->count;
+            }
+            while (low < high) {
+                int middle = low + (high - low) / 2;
+                if (listKeys[middle] < key) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            positions[i] = low;
+            inAll = low < lists[i]->count && listKeys[low] == key;
+        }
+        const char *text = inAll ? textIndexText(index, key) : NULL;
+        if (text != NULL && textMatches(text, query, mode)) {
+            (*keys)[found++] = key;
+        }
+    }
+    return found;
+}
+
+// Function to list the records that match a search
+
+/**
+ * @brief Lists the patients (for the name and diagnosis fields) or doctors (for the specialty 
+ * field) that match a search, through the output layer.
+ * 
+ * @return STATUS_OK or STATUS_NO_MEMORY.
+ */
+
+int listSearchResults(int field, int mode, const char *query) {
+    int *keys;
+    int found = searchRecords(field, mode, query, &keys);
+    if (found < 0) {
+        return STATUS_NO_MEMORY;
+    }
+
+    outputBegin();
+    outputText("\n----- Search Results -----\n");
+    for (int i = 0; i < found; i++) {
+        if (textIndexes[field].byPatientID) {
+            outputPatient(i + 1, patientByID(keys[i]));
+        } else {
+            outputDoctor(i + 1, keys[i]);
+        }
+    }
+    outputText("%d record(s) found.\n", found);
+    outputEnd();
+    free(keys);
+    return STATUS_OK;
+}
+
+// Function to parse a name from a list of names
+int parseSearchName(const char *text, const char *const *names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(text, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Function to search the records with a query chosen by the user
+
+/*
+ * Function to search patient names, diagnoses or doctor specialties.
+ * This function prompts for the field, the kind of match and the text to find, then lists the
+ * matching records through listSearchResults.
+ */
+
+void searchRecordsMenu() {
+    char fieldText[20], modeText[20], query[100];
+    printf("Enter the field to search (name, diagnosis or specialty): ");
+    scanf("%19s", fieldText);
+    printf("Enter the kind of match (prefix, contains, iprefix or icontains): ");
+    scanf("%19s", modeText);
+    printf("Enter the text to find: ");
+    scanf("%99s", query);
+
+    int field = parseSearchName(fieldText, searchFieldNames, SEARCH_FIELD_COUNT);
+    int mode = parseSearchName(modeText, searchModeNames, SEARCH_MODE_COUNT);
+    if (field == -1 || mode == -1) {
+        printf("Invalid field or kind of match.\n");
+        return;
+    }
+    if (listSearchResults(field, mode, query) != STATUS_OK) {
+        printf("Not enough memory to search the records.\n");
+    }
+}
+
+// Functions of the room inventory
+
+/*
+ * Functions of the room inventory.
+ * - roomClassIndex: Return the index of a room's class in the rate table, or roomClassCount for the default class.
+ * - roomInventoryAdd: Count a patient admitted to (delta 1) or discharged from (delta -1) a room.
+ * - roomInventoryReady: Build the inventory from the patients if it is stale.
+ * - roomHasFreeBed: Check whether a room has a free bed.
+ * - lowestBit / countBits: Find the lowest set bit of a word and count its set bits (countBits also
+ *   counts the booked slots of the doctor calendar).
+ * - findFreeRoom: Find the first room with a free bed in a range of room numbers.
+ */
+
+int roomClassIndex(int roomNumber) {
+    const RoomClass *roomClass = roomClassOf(roomNumber);
+    return roomClass == &billingRates.defaultRoomClass ? billingRates.roomClassCount
+                                                       : (int)(roomClass - billingRates.roomClasses);
+}
+
+int roomInventoryAdd(int roomNumber, int delta) {
+    RoomInventory *inventory = &roomInventory;
+    if (inventory->stale || roomNumber < 0 || roomNumber >= ROOM_NUMBER_LIMIT) {
+        return 1;
+    }
+    if (roomNumber >= inventory->capacity) {
+        int capacity = inventory->capacity > 0 ? inventory->capacity : 1024;
+        while (capacity <= roomNumber) {
+            capacity *= 2;
+        }
+        unsigned long long *full = realloc(inventory->full, capacity / 64 * sizeof(unsigned long long));
+        if (full != NULL) {
+            inventory->full = full;
+        }
+        int *occupied = full == NULL ? NULL : realloc(inventory->occupied, capacity * sizeof(int));
+        if (occupied == NULL) {
+            inventory->stale = 1;
+            return 0;
+        }
+        memset(full + inventory->capacity / 64, 0, (capacity - inventory->capacity) / 64 * sizeof(unsigned long long));
+        memset(occupied + inventory->capacity, 0, (capacity - inventory->capacity) * sizeof(int));
+        inventory->occupied = occupied;
+        inventory->capacity = capacity;
+    }
+
+    int wasOccupied = inventory->occupied[roomNumber] > 0;
+    inventory->occupied[roomNumber] += delta;
+    inventory->occupiedRooms += (inventory->occupied[roomNumber] > 0) - wasOccupied;
+    inventory->classOccupied[roomClassIndex(roomNumber)] += delta;
+    inventory->occupiedBeds += delta;
+    unsigned long long bit = 1ULL << (roomNumber & 63);
+    if (inventory->occupied[roomNumber] >= roomClassOf(roomNumber)->beds) {
+        inventory->full[roomNumber >> 6] |= bit;
+    } else {
+        inventory->full[roomNumber >> 6] &= ~bit;
+    }
+    return 1;
+}
+
+int roomInventoryReady() {
+    RoomInventory *inventory = &roomInventory;
+    if (!inventory->stale) {
+        return 1;
+    }
+    int *classOccupied = realloc(inventory->classOccupied, (billingRates.roomClassCount + 1) * sizeof(int));
+    if (classOccupied == NULL) {
+        printf("Not enough memory to count the occupied beds.\n");
+        return 0;
+    }
+    inventory->classOccupied = classOccupied;
+    memset(classOccupied, 0, (billingRates.roomClassCount + 1) * sizeof(int));
+    if (inventory->capacity > 0) {
+        memset(inventory->full, 0, inventory->capacity / 64 * sizeof(unsigned long long));
+        memset(inventory->occupied, 0, inventory->capacity * sizeof(int));
+    }
+    inventory->occupiedBeds = inventory->occupiedRooms = 0;
+    inventory->stale = 0;
+
+    for (int i = 0; i < patientSlotCount && !inventory->stale; i++) {
+        Patient *patient = patientAt(i);
+        if (patient->id >= 0) {
+            roomInventoryAdd(patient->roomNumber, 1);
+        }
+    }
+    if (inventory->stale) {
+        printf("Not enough memory to count the occupied beds.\n");
+        return 0;
+    }
+    return 1;
+}
+
+int roomHasFreeBed(int roomNumber) {
+    const RoomInventory *inventory = &roomInventory;
+    return roomNumber >= inventory->capacity || !(inventory->full[roomNumber >> 6] >> (roomNumber & 63) & 1);
+}
+
+int lowestBit(unsigned long long word) {
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+int countBits(unsigned long long word) {
+#ifdef __GNUC__
+    return __builtin_popcountll(word);
+#else
+    int count = 0;
+    for (; word != 0; word &= word - 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+// Function to find a free room in a range
+
+/**
+ * @brief Finds the lowest room number in [firstRoom, lastRoom] that has a free bed.
+ * 
+ * Scans the inverted 'full' bitmap a word at a time, masking the range's ends, 
+ * so at most (lastRoom - firstRoom) / 64 + 2 words are read. Rooms past the end 
+ * of the bitmap have never held a patient and are free. The inventory must be ready.
+ * 
+ * @return The room number, or -1 if every room in the range is full.
+ */
+
+int findFreeRoom(int firstRoom, int lastRoom) {
+    const RoomInventory *inventory = &roomInventory;
+    if (firstRoom < 0) {
+        firstRoom = 0;
+    }
+    if (lastRoom >= ROOM_NUMBER_LIMIT) {
+        lastRoom = ROOM_NUMBER_LIMIT - 1;
+    }
+    int last = lastRoom < inventory->capacity ? lastRoom : inventory->capacity - 1;
+    for (int word = firstRoom >> 6; firstRoom <= last && word <= last >> 6; word++) {
+        unsigned long long free = ~inventory->full[word];
+        if (word == firstRoom >> 6) {
+            free &= ~0ULL << (firstRoom & 63);
+        }
+        if (word == last >> 6 && (last & 63) != 63) {
+            free &= (1ULL << ((last & 63) + 1)) - 1;
+        }
+        if (free != 0) {
+            return word * 64 + lowestBit(free);
+        }
+    }
+    int beyond = firstRoom > inventory->capacity ? firstRoom : inventory->capacity;
+    return beyond <= lastRoom ? beyond : -1;
+}
+
+// Function to find a free room of a class
+
+/**
+ * @brief Finds the lowest room of a room class that has a free bed.
+ * 
+ * A class may cover several ranges of rooms; '*' searches every range in room 
+ * order. The default class (rooms outside every range) is searched in the gaps 
+ * between the ranges, from room 1.
+ * 
+ * @return The room number, -1 if every room of the class is full, -2 if there is no such class, 
+ *         or -3 if the room inventory could not be built for lack of memory.
+ */
+
+int findFreeRoomOfClass(const char *className) {
+    if (!roomInventoryReady()) {
+        return -3;
+    }
+    int any = strcmp(className, "*") == 0, known = any;
+    for (int i = 0; i < billingRates.roomClassCount; i++) {
+        const RoomClass *roomClass = &billingRates.roomClasses[i];
+        if (any || strcmp(roomClass->name, className) == 0) {
+            known = 1;
+            int room = findFreeRoom(roomClass->firstRoom, roomClass->lastRoom);
+            if (room != -1) {
+                return room;
+            }
+        }
+    }
+    if (any || strcmp(billingRates.defaultRoomClass.name, className) == 0) {
+        int first = 1;
+        for (int i = 0; i <= billingRates.roomClassCount; i++) {
+            int last = i < billingRates.roomClassCount ? billingRates.roomClasses[i].firstRoom - 1 : INT_MAX;
+            int room = first <= last ? findFreeRoom(first, last) : -1;
+            if (room != -1) {
+                return room;
+            }
+            if (i < billingRates.roomClassCount) {
+                first = billingRates.roomClasses[i].lastRoom + 1;
+            }
+        }
+        return -1;
+    }
+    return known ? -1 : -2;
+}
+
+// Function to list the occupancy of the room classes
+
+/**
+ * @brief Lists the beds, occupied beds and free rooms of every range of rooms in the 
+ * rate table, then of the rooms outside them, through the output layer.
+ * 
+ * @return STATUS_OK or STATUS_NO_MEMORY.
+ */
+
+int listRoomOccupancy() {
+    if (!roomInventoryReady()) {
+        return STATUS_NO_MEMORY;
+    }
+    const RoomInventory *inventory = &roomInventory;
+
+    outputBegin();
+    outputText("\n----- Room Occupancy -----\n");
+    for (int i = 0; i < billingRates.roomClassCount; i++) {
+        const RoomClass *roomClass = &billingRates.roomClasses[i];
+        int rooms = roomClass->lastRoom - roomClass->firstRoom + 1, fullRooms = 0;
+        int last = roomClass->lastRoom < inventory->capacity ? roomClass->lastRoom : inventory->capacity - 1;
+        for (int room = roomClass->firstRoom; room <= last; room++) {
+            if ((room & 63) == 0 && room + 63 <= last) {
+                fullRooms += countBits(inventory->full[room >> 6]);  // A whole word at once
+                room += 63;
+            } else {
+                fullRooms += inventory->full[room >> 6] >> (room & 63) & 1;
+            }
+        }
+        if (!outputRecordBegin()) {
+            outputRecordEnd();
+            continue;  // Outside the selected records
+        }
+        outputText("Rooms %d-%d\n", roomClass->firstRoom, roomClass->lastRoom);
+        outputField("class", "Class", roomClass->name);
+        outputInt("firstRoom", NULL, roomClass->firstRoom);
+        outputInt("lastRoom", NULL, roomClass->lastRoom);
+        outputInt("beds", "Beds", rooms * roomClass->beds);
+        outputInt("occupiedBeds", "Occupied Beds", inventory->classOccupied[i]);
+        outputInt("freeRooms", "Rooms with a Free Bed", rooms - fullRooms);
+        outputRecordEnd();
+    }
+    outputText("Occupied beds in %s rooms (outside every range): %d\n", billingRates.defaultRoomClass.name,
+               inventory->classOccupied[billingRates.roomClassCount]);
+    outputText("Occupied beds in all rooms: %d\n", inventory->occupiedBeds);
+    outputEnd();
+    return STATUS_OK;
+}
+
+// Function to find a free room of a class chosen by the user
+
+/*
+ * Function to find a free room.
+ * This function prompts for a room class ('*' for any), prints the first room of that class with
+ * a free bed, then lists the occupancy of every class through listRoomOccupancy.
+ */
+
+void findFreeRoomMenu() {
+    char className[20];
+    printf("Enter the room class (* for any): ");
+    scanf("%19s", className);
+
+    int room = findFreeRoomOfClass(className);
+    if (room == -3) {
+        printf("Not enough memory to look for a free room.\n");
+    } else if (room == -2) {
+        printf("There is no room class named %s.\n", className);
+    } else if (room == -1) {
+        printf("Every room of that class is full.\n");
+    } else {
+        printf("Room %d has a free bed.\n", room);
+    }
+    listRoomOccupancy();
+}
+
+// Function to make room in the output buffer
+
+/**
+ * @brief Grows the output buffer so that 'extra' more bytes fit.
+ * 
+ * @return 1 on success, 0 if the memory could not be allocated.
+ */
+
+int outputReserve(size_t extra) {
+    if (output.used + extra <= output.capacity) {
+        return 1;
+    }
+    size_t capacity = output.capacity > 0 ? output.capacity : OUTPUT_FLUSH_SIZE * 2;
+    while (capacity < output.used + extra) {
+        capacity *= 2;
+    }
+    char *buffer = realloc(output.buffer, capacity);
+    if (buffer == NULL) {
+        return 0;
+    }
+    output.buffer = buffer;
+    output.capacity = capacity;
+    return 1;
+}
+
+// Function to add bytes to the output buffer
+
+/**
+ * @brief Appends 'length' bytes to the output buffer.
+ * 
+ * If the buffer cannot grow, what it holds is written out first and the bytes 
+ * go straight to stdout, so nothing is lost when memory runs short.
+ */
+
+void outputAppend(const char *data, size_t length) {
+    if (!outputReserve(length)) {
+        outputFlush();
+        fwrite(data, 1, length, output.stream != NULL ? output.stream : stdout);
+        return;
+    }
+    memcpy(output.buffer + output.used, data, length);
+    output.used += length;
+}
+
+// Function to write the output buffer
+
+/**
+ * @brief Writes everything in the output buffer to the output stream with a single call and empties it.
+ */
+
+void outputFlush() {
+    FILE *stream = output.stream != NULL ? output.stream : stdout;
+    if (output.used > 0) {
+        fwrite(output.buffer, 1, output.used, stream);
+        output.used = 0;
+    }
+    fflush(stream);
+}
+
+// Function to add a value to the output buffer with escaping
+
+/**
+ * @brief Appends a text value, escaped for the current format.
+ * 
+ * CSV values double their quotes; JSON values escape quotes, backslashes and control 
+ * characters. The caller writes the surrounding quotes. Text mode writes the value as is.
+ */
+
+void outputEscaped(const char *value) {
+    const char *run = value;
+    for (const char *p = value; *p != '\0'; p++) {
+        char escape[8];
+        unsigned char c = (unsigned char)*p;
+        if (output.format == OUTPUT_CSV && c == '"') {
+            strcpy(escape, "\"\"");
+        } else if (output.format == OUTPUT_JSONL && (c == '"' || c == '\\')) {
+            sprintf(escape, "\\%c", c);
+        } else if (output.format == OUTPUT_JSONL && c < 0x20) {
+            sprintf(escape, "\\u%04x", c);
+        } else {
+            continue;
+        }
+        outputAppend(run, p - run);
+        outputAppend(escape, strlen(escape));
+        run = p + 1;
+    }
+    outputAppend(run, strlen(run));
+}
+
+// Function to start a field of a CSV or JSON record
+
+/**
+ * @brief Writes the separator and, for JSON, the key that come before a field's value.
+ * 
+ * While the first CSV record of a listing is written, the key is also added to the header line.
+ */
+
+void outputFieldName(const char *key) {
+    if (output.format == OUTPUT_JSONL) {
+        outputAppend(output.fieldCount > 0 ? ",\"" : "\"", output.fieldCount > 0 ? 2 : 1);
+        outputEscaped(key);
+        outputAppend("\":", 2);
+    } else {
+        if (output.fieldCount > 0) {
+            outputAppend(",", 1);
+        }
+        if (!output.headerWritten) {
+            int length = snprintf(output.header + output.headerUsed, sizeof(output.header) - output.headerUsed,
+                "%s%s", output.fieldCount > 0 ? "," : "", key);
+            if (length > 0 && output.headerUsed + length < sizeof(output.header)) {
+                output.headerUsed += length;
+            }
+        }
+    }
+    output.fieldCount++;
+}
+
+// Function to start a listing
+
+/**
+ * @brief Starts a new listing. Headings written before the first record are always shown in text mode.
+ */
+
+void outputBegin() {
+    output.records = 0;
+    output.inRecord = 0;
+    output.visible = 0;
+    output.headerWritten = 0;
+    output.headerUsed = 0;
+}
+
+// Function to start a record of a listing
+
+/**
+ * @brief Starts the next record of the current listing.
+ * 
+ * @return 1 if the record falls inside the selected offset and limit and will be written, 
+ *         0 if it is only counted; the caller may then skip building it.
+ */
+
+int outputRecordBegin() {
+    int record = output.records++;
+    output.inRecord = 1;
+    output.visible = record >= output.offset && (output.limit == 0 || record < output.offset + output.limit);
+    if (output.visible) {
+        output.recordStart = output.used;
+        output.fieldCount = 0;
+        if (output.format == OUTPUT_JSONL) {
+            outputAppend("{", 1);
+        }
+    }
+    return output.visible;
+}
+
+// Function to end a record of a listing
+
+/**
+ * @brief Ends the current record and writes the buffer out once it holds OUTPUT_FLUSH_SIZE bytes.
+ * 
+ * Text records end with a blank line and CSV and JSON records with a newline. The first CSV record 
+ * is preceded by the header line collected while it was written.
+ */
+
+void outputRecordEnd() {
+    output.inRecord = 0;
+    if (!output.visible) {
+        return;
+    }
+    output.visible = 0;
+
+    if (output.format == OUTPUT_JSONL) {
+        outputAppend("}\n", 2);
+    } else {
+        outputAppend("\n", 1);
+    }
+    if (output.format == OUTPUT_CSV && !output.headerWritten) {
+        // Put the column names collected from the first record in front of it
+        size_t rowLength = output.recordStart <= output.used ? output.used - output.recordStart : 0;
+        if (output.recordStart <= output.used && outputReserve(output.headerUsed + 1)) {
+            char *row = output.buffer + output.recordStart;
+            memmove(row + output.headerUsed + 1, row, rowLength);
+            memcpy(row, output.header, output.headerUsed);
+            row[output.headerUsed] = '\n';
+            output.used += output.headerUsed + 1;
+        }
+        output.headerWritten = 1;
+    }
+    if (output.used >= OUTPUT_FLUSH_SIZE) {
+        outputFlush();
+    }
+}
+
+// Function to end a listing
+
+/**
+ * @brief Ends the current listing and writes out the buffer.
+ * 
+ * In text mode a listing limited by an offset or a limit ends with a line showing which 
+ * records were written out of how many.
+ */
+
+void outputEnd() {
+    if (output.format == OUTPUT_TEXT && (output.offset > 0 || output.limit > 0)) {
+        int last = output.limit > 0 && output.offset + output.limit < output.records ? output.offset + output.limit
+                                                                                     : output.records;
+        if (output.offset < last) {
+            outputText("Showing records %d to %d of %d.\n", output.offset + 1, last, output.records);
+        } else {
+            outputText("No records to show from record %d (%d in total).\n", output.offset + 1, output.records);
+        }
+    }
+    outputFlush();
+}
+
+// Function to write free text
+
+/**
+ * @brief Writes formatted text, such as a heading or a message, in text mode only.
+ * 
+ * Text inside a record that is not written is dropped along with the record.
+ */
+
+void outputText(const char *format, ...) {
+    char text[OUTPUT_LINE_SIZE];
+    va_list arguments;
+    if (output.format != OUTPUT_TEXT || (output.inRecord && !output.visible)) {
+        return;
+    }
+    va_start(arguments, format);
+    int length = vsnprintf(text, sizeof(text), format, arguments);
+    va_end(arguments);
+    if (length > 0) {
+        outputAppend(text, length < (int)sizeof(text) ? (size_t)length : sizeof(text) - 1);
+    }
+}
+
+// Function to write a text field
+
+/**
+ * @brief Writes a text field of the current record.
+ * 
+ * In text mode the field is shown as "label: value", or left out when 'label' is NULL; 
+ * CSV and JSON records name the field by 'key'.
+ */
+
+void outputField(const char *key, const char *label, const char *value) {
+    if (!output.visible) {
+        return;
+    }
+    if (output.format == OUTPUT_TEXT) {
+        if (label != NULL) {
+            outputText("%s: %s\n", label, value);
+        }
+        return;
+    }
+    outputFieldName(key);
+    outputAppend("\"", 1);
+    outputEscaped(value);
+    outputAppend("\"", 1);
+}
+
+// Function to write a number field
+
+/**
+ * @brief Writes a number field of the current record, like outputField.
+ */
+
+void outputInt(const char *key, const char *label, int value) {
+    char text[16];
+    sprintf(text, "%d", value);
+    outputNumber(key, label, text);
+}
+
+// Function to write a formatted number field
+
+/**
+ * @brief Writes a field holding a number already formatted as text (e.g. with decimals), like outputInt.
+ */
+
+void outputNumber(const char *key, const char *label, const char *number) {
+    if (!output.visible) {
+        return;
+    }
+    if (output.format == OUTPUT_TEXT) {
+        if (label != NULL) {
+            outputText("%s: %s\n", label, number);
+        }
+        return;
+    }
+    outputFieldName(key);
+    outputAppend(number, strlen(number));
+}
+
+// Function to start a list field
+
+/**
+ * @brief Starts a field holding a list of items, such as a patient's medications.
+ * 
+ * Text mode shows "label:" followed by one indented line per item; CSV joins the items 
+ * with "; " in one cell and JSON writes an array of strings.
+ */
+
+void outputListBegin(const char *key, const char *label) {
+    if (!output.visible) {
+        return;
+    }
+    output.listItems = 0;
+    if (output.format == OUTPUT_TEXT) {
+        if (label != NULL) {
+            outputText("%s:\n", label);
+        }
+        return;
+    }
+    outputFieldName(key);
+    outputAppend(output.format == OUTPUT_JSONL ? "[" : "\"", 1);
+}
+
+// Function to write an item of a list field
+
+/**
+ * @brief Writes one formatted item of the current list field.
+ */
+
+void outputListItem(const char *format, ...) {
+    char text[OUTPUT_LINE_SIZE];
+    va_list arguments;
+    if (!output.visible) {
+        return;
+    }
+    va_start(arguments, format);
+    vsnprintf(text, sizeof(text), format, arguments);
+    va_end(arguments);
+
+    if (output.format == OUTPUT_TEXT) {
+        outputText("  %s\n", text);
+    } else if (output.format == OUTPUT_JSONL) {
+        outputAppend(output.listItems > 0 ? ",\"" : "\"", output.listItems > 0 ? 2 : 1);
+        outputEscaped(text);
+        outputAppend("\"", 1);
+    } else {
+        if (output.listItems > 0) {
+            outputAppend("; ", 2);
+        }
+        outputEscaped(text);
+    }
+    output.listItems++;
+}
+
+// Function to end a list field
+
+/**
+ * @brief Ends the current list field.
+ */
+
+void outputListEnd() {
+    if (output.visible && output.format != OUTPUT_TEXT) {
+        outputAppend(output.format == OUTPUT_JSONL ? "]" : "\"", 1);
+    }
+}
+
+// Functions of the instrumentation
+
+/*
+ * Functions of the instrumentation, which collects per-operation latencies and I/O counters.
+ * Collection is off unless the HOSPITAL_STATS environment variable is set (or it is turned on
+ * from the menu); while it is off, statsStart returns 0 and statsRecord and statsAdd return at
+ * once, so an instrumented operation only pays for one test of 'stats.enabled'.
+ * - statsStart / statsRecord: Time one call of an operation and add it to the operation's count,
+ *   total, maximum and latency histogram.
+ * - statsAdd: Add to one of the I/O counters.
+ * - viewStatistics / statsDump: Write the statistics, with the current table sizes, as a listing.
+ */
+
+// Function to read the clock used by the instrumentation
+long long statsNow() {
+#ifdef _WIN32
+    return (long long)clock() * (1000000000LL / CLOCKS_PER_SEC);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+// Function to turn on the instrumentation if HOSPITAL_STATS is set
+
+/**
+ * @brief Turns on collection when HOSPITAL_STATS is set, and arranges for the statistics to be 
+ *        dumped at exit: as text to stderr when it is "1", otherwise as JSON lines appended to 
+ *        the file it names.
+ */
+
+void statsInit() {
+    const char *setting = getenv("HOSPITAL_STATS");
+    if (setting == NULL || setting[0] == '\0') {
+        return;
+    }
+    stats.enabled = 1;
+    stats.dumpPath = strcmp(setting, "1") == 0 ? NULL : setting;
+    atexit(statsDump);
+}
+
+// Function to start timing an operation
+long long statsStart() {
+    return stats.enabled ? statsNow() : 0;
+}
+
+// Function to record one call of an operation
+
+/**
+ * @brief Adds one call, started at 'start' (from statsStart), to the operation in 'slot'.
+ * 
+ * The latency goes into histogram bucket b, which holds calls that took less than 2^b microseconds.
+ */
+
+void statsRecord(int slot, const char *kind, const char *name, long long start) {
+    if (!stats.enabled || start == 0 || slot < 0 || slot >= STATS_MAX_OPERATIONS) {
+        return;
+    }
+    long long elapsed = statsNow() - start;
+    StatsOperation *operation = &stats.operations[slot];
+    operation->kind = kind;
+    operation->name = name;
+    operation->count++;
+    operation->totalNs += elapsed;
+    if (elapsed > operation->maxNs) {
+        operation->maxNs = elapsed;
+    }
+
+    int bucket = 0;
+    for (long long micros = elapsed / 1000; micros > 0 && bucket < STATS_BUCKETS - 1; micros >>= 1) {
+        bucket++;
+    }
+    operation->buckets[bucket]++;
+}
+
+// Function to add to an I/O counter
+void statsAdd(int counter, long long amount) {
+    if (stats.enabled) {
+#ifndef _WIN32
+        pthread_mutex_lock(&stats.counterLock);
+        stats.counters[counter] += amount;
+        pthread_mutex_unlock(&stats.counterLock);
+#else
+        stats.counters[counter] += amount;
+#endif
+    }
+}
+
+// Function to estimate a latency percentile from a histogram
+
+/**
+ * @brief Returns the upper bound, in microseconds, of the histogram bucket holding the given percentile.
+ */
+
+long long statsPercentile(const StatsOperation *operation, int percent) {
+    long long target = (operation->count * percent + 99) / 100, seen = 0;
+    for (int bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+        seen += operation->buckets[bucket];
+        if (seen >= target) {
+            return 1LL << bucket;
+        }
+    }
+    return 1LL << (STATS_BUCKETS - 1);
+}
+
+// Function to write one record of the statistics
+
+/**
+ * @brief Writes one statistics record: an operation when 'operation' is given, otherwise a 
+ *        counter or table size with 'value' as its count. Every record has the same fields, 
+ *        so the statistics also form a valid CSV table.
+ */
+
+void statsWriteRecord(const char *kind, const char *name, long long value, const StatsOperation *operation) {
+    char number[32];
+    if (!outputRecordBegin()) {
+        outputRecordEnd();
+        return;
+    }
+    outputField("kind", NULL, kind);
+    outputText("%s (%s)\n", name, kind);
+    outputField("name", NULL, name);
+    sprintf(number, "%lld", value);
+    outputNumber("count", operation != NULL ? "Calls" : "Value", number);
+
+    const char *label[] = {"Total (us)", "Median (us, at most)", "99th Percentile (us, at most)", "Maximum (us)"};
+    long long values[] = {0, 0, 0, 0};
+    if (operation != NULL) {
+        values[0] = operation->totalNs / 1000;
+        values[1] = statsPercentile(operation, 50);
+        values[2] = statsPercentile(operation, 99);
+        values[3] = operation->maxNs / 1000;
+    }
+    const char *keys[] = {"totalMicros", "p50Micros", "p99Micros", "maxMicros"};
+    for (int i = 0; i < 4; i++) {
+        sprintf(number, "%lld", values[i]);
+        outputNumber(keys[i], operation != NULL ? label[i] : NULL, number);
+    }
+
+    outputListBegin("histogram", operation != NULL ? "Latency Histogram" : NULL);
+    for (int bucket = 0; operation != NULL && bucket < STATS_BUCKETS; bucket++) {
+        if (operation->buckets[bucket] > 0) {
+            outputListItem("<%lldus: %d", 1LL << bucket, operation->buckets[bucket]);
+        }
+    }
+    outputListEnd();
+    outputRecordEnd();
+}
+
+// Function to write all the statistics
+
+/**
+ * @brief Writes every operation called so far, the I/O counters and the current table sizes as one listing.
+ */
+
+void statsWrite() {
+    static const char *const counterNames[] = {"dataBytesRead", "dataBytesWritten", "journalBytesWritten"};
+    const char *tableNames[] = {"doctors", "patients", "patientSlots", "staff", "shifts", "roles", "appointments",
+                                "medications", "dosages", "prescriptions"};
+    int tableSizes[] = {doctorCount, patientCount, patientSlotCount, staffCount, shiftCount, roleCount, appointmentCount,
+                        medicationCatalogCount, dosageCount, prescriptionCount};
+
+    outputBegin();
+    outputText("\n----- Statistics -----\n");
+    for (int i = 0; i < STATS_MAX_OPERATIONS; i++) {
+        if (stats.operations[i].count > 0) {
+            statsWriteRecord(stats.operations[i].kind, stats.operations[i].name, stats.operations[i].count, &stats.operations[i]);
+        }
+    }
+    for (int i = 0; i < STATS_COUNTER_COUNT; i++) {
+        statsWriteRecord("io", counterNames[i], stats.counters[i], NULL);
+    }
+    for (int i = 0; i < (int)(sizeof(tableSizes) / sizeof(tableSizes[0])); i++) {
+        statsWriteRecord("table", tableNames[i], tableSizes[i], NULL);
+    }
+    statsWriteRecord("save", "backgroundSaves", saveState.saves, NULL);
+    statsWriteRecord("save", "failedBackgroundSaves", saveState.failures, NULL);
+    statsWriteRecord("save", "lastSaveMicros", saveState.lastDurationNs / 1000, NULL);
+    statsWriteRecord("save", "lastSavePauseMicros", saveState.lastPauseNs / 1000, NULL);
+    statsWriteRecord("save", "lastSnapshotBytes", saveState.lastBytes, NULL);
+    outputEnd();
+}
+
+// Function to dump the statistics at exit
+
+/**
+ * @brief Writes the statistics where HOSPITAL_STATS asked for them, ignoring the output settings.
+ */
+
+void statsDump() {
+    FILE *file = stats.dumpPath != NULL ? fopen(stats.dumpPath, "a") : stderr;
+    if (file == NULL) {
+        fprintf(stderr, "Could not write the statistics to %s.\n", stats.dumpPath);
+        return;
+    }
+    outputFlush();
+    Output saved = output;
+    output.format = stats.dumpPath != NULL ? OUTPUT_JSONL : OUTPUT_TEXT;
+    output.offset = output.limit = 0;
+    output.stream = file;
+    statsWrite();
+    saved.buffer = output.buffer;  // The buffer may have been moved while growing
+    saved.capacity = output.capacity;
+    output = saved;
+    if (file != stderr) {
+        fclose(file);
+    }
+}
+
+// Function to read staff records written in the old layout
+
+/**
+ * @brief Reads 'count' staff records in the old layout with a fixed inline schedule.
+ * 
+ * Each old record is converted into a Staff record and its text shifts are 
+ * parsed into the shift table. Shifts whose day or times cannot be parsed are 
+ * skipped with a warning.
+ * 
+ * @return 1 if every record was read, 0 otherwise.
+ */
+
+int readLegacyStaff(FILE *file, int count) {
+    LegacyStaff *legacy = malloc(sizeof(LegacyStaff));
+    if (legacy == NULL) {
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        Staff *member = tableSlot(&staffTable, i);
+        if (member == NULL || fread(legacy, sizeof(LegacyStaff), 1, file) != 1) {
+            free(legacy);
+            return 0;
+        }
+
+        strcpy(member->name, legacy->name);
+        strcpy(member->role, legacy->role);
+        strcpy(member->contactInfo, legacy->contactInfo);
+        member->firstShift = member->lastShift = -1;
+        member->shiftCount = 0;
+
+        int oldShifts = legacy->shiftCount < 100 ? legacy->shiftCount : 100;
+        for (int j = 0; j < oldShifts; j++) {
+            LegacyShift *old = &legacy->schedule[j];
+            int day = parseWeekday(old->day);
+            int start = parseTime(old->startTime);
+            int end = parseTime(old->endTime);
+            if (day == -1 || start == -1 || end == -1) {
+                printf("Warning: skipping unreadable shift '%s %s-%s' of %s.\n", 
+                    old->day, old->startTime, old->endTime, member->name);
+                continue;
+            }
+            appendShift(i, day, start, end, internRole(old->role));
+        }
+    }
+
+    free(legacy);
+    return 1;
+}
+
+// Function to copy text into a fixed-size field
+
+/**
+ * @brief Copies a string into a fixed-size character field.
+ * 
+ * @param size The size of the destination field, including the terminating null character.
+ * @return 1 if the whole string fit, 0 if it was too long (the field is left unchanged).
+ */
+
+int copyText(char *destination, size_t size, const char *source) {
+    size_t length = strlen(source);
+    if (length >= size) {
+        return 0;
+    }
+    memcpy(destination, source, length + 1);
+    return 1;
+}
+
+// Function to compute a checksum over a block of bytes
+
+/**
+ * @brief Computes the 32-bit FNV-1a checksum of a block of bytes.
+ * 
+ * Used to detect torn or corrupted records in the data and journal files. 
+ * checksumUpdate continues a checksum over more bytes, so data written in 
+ * pieces can be checksummed as it is written (start from CHECKSUM_START).
+ * 
+ * @return The checksum of the bytes.
+ */
+
+unsigned int checksumBytes(const void *data, size_t length) {
+    return checksumUpdate(CHECKSUM_START, data, length);
+}
+
+unsigned int checksumUpdate(unsigned int checksum, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        checksum ^= bytes[i];
+        checksum *= 16777619u;
+    }
+    return checksum;
+}
+
+// Functions to build and decode the payload of a journal record
+
+/**
+ * @brief Append an integer or a string to a journal record, or read one back from a payload.
+ * 
+ * Integers are stored as 4 bytes in the machine's byte order (like the data files) and 
+ * strings as a one-byte length followed by the characters. The get functions advance 
+ * '*cursor' and return 0 if the payload ends early or a string does not fit in 'size'.
+ */
+
+void recordPutInt(JournalRecord *record, int value) {
+    memcpy(record->data + record->length, &value, sizeof(int));
+    record->length += sizeof(int);
+}
+
+void recordPutString(JournalRecord *record, const char *text) {
+    size_t length = strlen(text);
+    record->data[record->length++] = (unsigned char)length;
+    memcpy(record->data + record->length, text, length);
+    record->length += length;
+}
+
+int recordGetInt(const unsigned char **cursor, const unsigned char *end, int *value) {
+    if (end - *cursor < (long)sizeof(int)) {
+        return 0;
+    }
+    memcpy(value, *cursor, sizeof(int));
+    *cursor += sizeof(int);
+    return 1;
+}
+
+int recordGetString(const unsigned char **cursor, const unsigned char *end, char *text, size_t size) {
+    if (*cursor >= end) {
+        return 0;
+    }
+    size_t length = *(*cursor)++;
+    if (length >= size || end - *cursor < (long)length) {
+        return 0;
+    }
+    memcpy(text, *cursor, length);
+    text[length] = '\0';
+    *cursor += length;
+    return 1;
+}
+
+// Function to start a new journal record
+
+/**
+ * @brief Resets a journal record and sets its type, leaving room for the record header.
+ */
+
+void journalRecordBegin(JournalRecord *record, int type) {
+    record->length = JOURNAL_HEADER_SIZE;
+    record->data[JOURNAL_HEADER_SIZE - 1] = (unsigned char)type;
+}
+
+// Function to add a record to the journal
+
+/**
+ * @brief Fills in a record's header and queues it for the next group commit.
+ * 
+ * The header holds the payload length, a checksum over the rest of the record 
+ * and a sequence number. Records are buffered in memory and written together 
+ * by journalCommit, so a burst of changes costs a single write and fsync. 
+ * Nothing is logged while the journal is disabled or being replayed.
+ */
+
+void journalLog(JournalRecord *record) {
+    if (!journal.enabled || journal.replaying) {
+        return;
+    }
+
+    unsigned int payloadLength = (unsigned int)(record->length - JOURNAL_HEADER_SIZE);
+    unsigned int sequence = journal.nextSequence++;
+    memcpy(record->data, &payloadLength, 4);
+    memcpy(record->data + 8, &sequence, 4);
+    unsigned int checksum = checksumBytes(record->data + 8, record->length - 8);
+    memcpy(record->data + 4, &checksum, 4);
+
+    if (journal.pendingBytes + record->length > JOURNAL_GROUP_BYTES) {
+        journalCommit();
+    }
+    memcpy(journal.pending + journal.pendingBytes, record->data, record->length);
+    journal.pendingBytes += record->length;
+}
+
+// Function to write the pending journal records to disk
+
+/**
+ * @brief Writes every queued journal record and forces it to disk with a single fsync.
+ * 
+ * Called whenever the program becomes idle (before showing the menu), when the 
+ * pending buffer is full, before a checkpoint and at exit. Once this returns, 
+ * the changes survive a crash even if the data is never saved. The server commits 
+ * through journalWrite instead, so that it can release the data lock first.
+ */
+
+void journalCommit() {
+    journalLock();
+    journalWrite(journal.pending, journal.pendingBytes);
+    journal.pendingBytes = 0;
+    journalUnlock();
+}
+
+// Function to append journal records to the file
+
+/**
+ * @brief Appends 'length' bytes of records to the journal file and fsyncs it. 
+ * The caller holds the journal's lock.
+ * 
+ * If the records cannot be made durable, whatever part of them reached the file is 
+ * cut off again and journaling stops: replay ends at the first torn record, so 
+ * anything appended after it would be lost anyway, and replaying later changes 
+ * without the failed ones could apply them to the wrong records. Only bytes that 
+ * are on disk count towards 'fileBytes'.
+ */
+
+void journalWrite(const unsigned char *records, size_t length) {
+    if (journal.file == NULL || length == 0) {
+        return;
+    }
+    if (fwrite(records, 1, length, journal.file) == length &&
+        fflush(journal.file) == 0 && fsync(fileno(journal.file)) == 0) {
+        journal.fileBytes += (long)length;
+        statsAdd(STATS_JOURNAL_BYTES_WRITTEN, (long long)length);
+        return;
+    }
+
+    // Close first, so nothing left in the stream's buffer lands after the cut
+    fclose(journal.file);
+    journal.file = NULL;
+    journal.enabled = 0;
+    FILE *file = fopen(JOURNAL_FILE, "r+b");
+    int cut = file != NULL && ftruncate(fileno(file), journal.fileBytes) == 0 && fsync(fileno(file)) == 0;
+    if (file != NULL) {
+        fclose(file);
+    }
+    printf("Error writing the journal; changes will only be kept when data is saved.\n");
+    if (!cut) {
+        printf("The journal may end with a damaged record; the changes before it are still recovered.\n");
+    }
+}
+
+// Functions to take and release the lock on the journal file
+
+/*
+ * Functions to take and release the lock on the journal file (see Journal).
+ * The lock is recursive, since saving and trimming the journal call each other, and is
+ * created on first use. Without threads they do nothing.
+ */
+
+#ifndef _WIN32
+pthread_once_t journalLockOnce = PTHREAD_ONCE_INIT;
+
+void journalLockInit() {
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&journal.fileLock, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+#endif
+
+void journalLock() {
+#ifndef _WIN32
+    pthread_once(&journalLockOnce, journalLockInit);
+    pthread_mutex_lock(&journal.fileLock);
+#endif
+}
+
+void journalUnlock() {
+#ifndef _WIN32
+    pthread_mutex_unlock(&journal.fileLock);
+#endif
+}
+
+// Function to open the journal
+
+/**
+ * @brief Opens the journal file for appending new records.
+ * 
+ * Journaling can be turned off by setting the environment variable 
+ * HOSPITAL_JOURNAL=off, in which case changes are only kept by saveData.
+ */
+
+void journalOpen() {
+    const char *setting = getenv("HOSPITAL_JOURNAL");
+    if (setting != NULL && strcmp(setting, "off") == 0) {
+        return;
+    }
+
+    journal.file = fopen(JOURNAL_FILE, "ab");
+    if (journal.file == NULL) {
+        printf("Could not open the journal; changes will only be kept when data is saved.\n");
+        return;
+    }
+    fseek(journal.file, 0, SEEK_END);
+    journal.fileBytes = ftell(journal.file);
+    journal.enabled = 1;
+}
+
+// Function to close the journal
+
+/**
+ * @brief Commits any pending records and closes the journal file. Registered with atexit.
+ */
+
+void journalClose() {
+    journalCommit();
+    if (journal.file != NULL) {
+        fclose(journal.file);
+        journal.file = NULL;
+    }
+}
+
+// Function to empty the journal after a checkpoint
+
+/**
+ * @brief Truncates the journal once every record in it is part of the saved data files.
+ */
+
+void journalReset() {
+    journalLock();
+    if (journal.file != NULL) {
+        fclose(journal.file);
+        journal.file = fopen(JOURNAL_FILE, "wb");
+        journal.fileBytes = 0;
+        if (journal.file == NULL) {
+            printf("Could not reopen the journal; changes will only be kept when data is saved.\n");
+            journal.enabled = 0;
+        }
+    }
+    journalUnlock();
+}
+
+// Function to drop the start of the journal after a background save
+
+/**
+ * @brief Removes the first 'savedBytes' bytes of the journal, which a background save has 
+ * folded into the data files, keeping the records made since its snapshot.
+ * 
+ * The kept records are copied to a new file that replaces the journal (see journalCopyTail). 
+ * If that fails the journal is left whole, which is still correct: replay skips records 
+ * older than the data files. Records still in the pending buffer are not needed for the 
+ * copy; they are appended to the new file by the next commit.
+ */
+
+void journalTrim(long savedBytes) {
+    journalLock();
+    journalCopyTail(savedBytes);
+    journalUnlock();
+}
+
+// Function to replace the journal with its records after the first 'savedBytes' bytes
+void journalCopyTail(long savedBytes) {
+    if (journal.file == NULL || savedBytes <= 0) {
+        return;
+    }
+    if (savedBytes >= journal.fileBytes) {
+        journalReset();
+        return;
+    }
+
+    FILE *source = fopen(JOURNAL_FILE, "rb");
+    FILE *target = fopen(JOURNAL_FILE ".tmp", "wb");
+    int copied = source != NULL && target != NULL && fseek(source, savedBytes, SEEK_SET) == 0;
+    char buffer[8192];
+    size_t bytes;
+    while (copied && (bytes = fread(buffer, 1, sizeof(buffer), source)) > 0) {
+        copied = fwrite(buffer, 1, bytes, target) == bytes;
+    }
+    copied = copied && !ferror(source) && fflush(target) == 0 && fsync(fileno(target)) == 0;
+    if (source != NULL) {
+        fclose(source);
+    }
+    if (target != NULL) {
+        fclose(target);
+    }
+    if (!copied || !replaceFile(JOURNAL_FILE ".tmp", JOURNAL_FILE)) {
+        remove(JOURNAL_FILE ".tmp");
+        return;
+    }
+
+    fclose(journal.file);
+    journal.file = fopen(JOURNAL_FILE, "ab");
+    journal.fileBytes -= savedBytes;
+    if (journal.file == NULL) {
+        printf("Could not reopen the journal; changes will only be kept when data is saved.\n");
+        journal.enabled = 0;
+    }
+}
+
+// Function to do journal housekeeping while the program is idle
+
+/**
+ * @brief Commits pending journal records and checkpoints the journal when it gets large.
+ * 
+ * A checkpoint saves the data files in the background (folding every journal 
+ * record into them) and then drops those records from the journal, which keeps 
+ * replay at startup short.
+ */
+
+void journalIdle() {
+    journalCommit();
+    if (journal.enabled && journal.fileBytes > JOURNAL_CHECKPOINT_BYTES && saveState.child == 0) {
+        saveDataBackground();
+    }
+}
+
+// Function to apply one journal record
+
+/**
+ * @brief Decodes the payload of a journal record and applies the change it describes.
+ * 
+ * @return The status of the change, or STATUS_INVALID if the payload cannot be decoded.
+ */
+
+int journalApply(int type, const unsigned char *payload, const unsigned char *end) {
+    char text1[100], text2[100], text3[100];
+    int number1, number2, number3, number4;
+
+    switch (type) {
+        case JOURNAL_ADD_DOCTOR:
+            if (recordGetString(&payload, end, text1, sizeof(text1)) && recordGetInt(&payload, end, &number1) &&
+                recordGetString(&payload, end, text2, sizeof(text2)) && recordGetInt(&payload, end, &number2)) {
+                return insertDoctor(text1, number1, text2, number2);
+            }
+            break;
+        case JOURNAL_ADD_PATIENT:
+            if (recordGetString(&payload, end, text1, sizeof(text1)) && recordGetInt(&payload, end, &number1) &&
+                recordGetString(&payload, end, text2, sizeof(text2)) && recordGetInt(&payload, end, &number2) &&
+                recordGetInt(&payload, end, &number3)) {
+                if (!recordGetInt(&payload, end, &number4)) {
+                    number4 = 0;  // Written by earlier versions, which did not record admission dates
+                }
+                return insertPatient(text1, number1, text2, number2, number3, number4);
+            }
+            break;
+        case JOURNAL_ADD_STAFF:
+            if (recordGetString(&payload, end, text1, sizeof(text1)) && recordGetString(&payload, end, text2, sizeof(text2)) &&
+                recordGetString(&payload, end, text3, sizeof(text3))) {
+                return insertStaff(text1, text2, text3);
+            }
+            break;
+        case JOURNAL_ADD_SHIFT:
+            if (recordGetInt(&payload, end, &number1) && recordGetInt(&payload, end, &number2) &&
+                recordGetInt(&payload, end, &number3) && recordGetInt(&payload, end, &number4) &&
+                recordGetString(&payload, end, text1, sizeof(text1))) {
+                return insertShift(number1, number2, number3, number4, text1);
+            }
+            break;
+        case JOURNAL_ADD_MEDICATION:
+        case JOURNAL_LEGACY_ADD_MEDICATION:
+            if (recordGetInt(&payload, end, &number1) && recordGetString(&payload, end, text1, sizeof(text1)) &&
+                recordGetString(&payload, end, text2, sizeof(text2))) {
+                if (type == JOURNAL_LEGACY_ADD_MEDICATION) {
+                    number1 = patientIDAtPosition(number1);
+                }
+                return insertMedication(number1, text1, text2);
+            }
+            break;
+        case JOURNAL_REMOVE_PATIENT:
+        case JOURNAL_LEGACY_REMOVE_PATIENT:
+            if (recordGetInt(&payload, end, &number1)) {
+                if (type == JOURNAL_LEGACY_REMOVE_PATIENT) {
+                    number1 = patientIDAtPosition(number1);
+                }
+                return deletePatient(number1);
+            }
+            break;
+    }
+    return STATUS_INVALID;
+}
+
+// Function to replay the journal
+
+/**
+ * @brief Re-applies every complete journal record on top of the loaded data files.
+ * 
+ * Records are read in order until the end of the file or the first record whose 
+ * length or checksum is wrong (a write torn by a crash). Records older than the 
+ * journal sequence their data file was saved at are skipped, so a crash between 
+ * saving the data files and emptying the journal never applies a change twice. A damaged tail is cut 
+ * off so that new records are appended after the last good one.
+ */
+
+void journalReplay() {
+    FILE *file = fopen(JOURNAL_FILE, "r+b");
+    if (file == NULL) {
+        return;
+    }
+
+    JournalRecord record;
+    long goodBytes = 0;
+    int applied = 0;
+    journal.replaying = 1;
+    while (fread(record.data, 1, JOURNAL_HEADER_SIZE, file) == JOURNAL_HEADER_SIZE) {
+        unsigned int payloadLength, checksum, sequence;
+        memcpy(&payloadLength, record.data, 4);
+        memcpy(&checksum, record.data + 4, 4);
+        memcpy(&sequence, record.data + 8, 4);
+        if (payloadLength > JOURNAL_MAX_RECORD - JOURNAL_HEADER_SIZE ||
+            fread(record.data + JOURNAL_HEADER_SIZE, 1, payloadLength, file) != payloadLength ||
+            checksumBytes(record.data + 8, payloadLength + JOURNAL_HEADER_SIZE - 8) != checksum) {
+            break;
+        }
+
+        // Skip records that were already saved into their data file by a checkpoint
+        int type = record.data[JOURNAL_HEADER_SIZE - 1];
+        const unsigned char *payload = record.data + JOURNAL_HEADER_SIZE;
+        if (sequence >= dataFileSequence[journalRecordFile(type)]) {
+            if (journalApply(type, payload, payload + payloadLength) != STATUS_OK) {
+                printf("Warning: journal record %u could not be applied.\n", sequence);
+            }
+            applied++;
+        }
+        if (sequence >= journal.nextSequence) {
+            journal.nextSequence = sequence + 1;
+        }
+        goodBytes += JOURNAL_HEADER_SIZE + payloadLength;
+    }
+    journal.replaying = 0;
+
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) > goodBytes) {
+        printf("Warning: discarding a damaged record at the end of the journal.\n");
+        fflush(file);
+        ftruncate(fileno(file), goodBytes);
+    }
+    fclose(file);
+
+    if (applied > 0) {
+        printf("Recovered %d unsaved change(s) from the journal.\n", applied);
+    }
+}
+
+// Function to map a file into memory
+
+/**
+ * @brief Maps a whole file into memory for reading.
+ * 
+ * The mapping is private and writable: pages are read from disk only when first 
+ * touched, and changes made through the mapping are never written back to the file. 
+ * On systems without mmap the file is read into an allocated buffer instead.
+ * 
+ * @return The start of the mapped file, or NULL if the file is missing, empty or cannot be mapped.
+ */
+
+char *mapFile(const char *path, size_t *size) {
+#ifdef _WIN32
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = length > 0 ? malloc(length) : NULL;
+    if (data != NULL && fread(data, 1, length, file) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *size = (size_t)length;
+    if (data != NULL) {
+        statsAdd(STATS_DATA_BYTES_READ, length);
+    }
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat info;
+    char *data = NULL;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+        }
+        *size = (size_t)info.st_size;
+    }
+    close(fd);
+    if (data != NULL) {
+        statsAdd(STATS_DATA_BYTES_READ, (long long)*size);  // Counted when mapped, though pages are read as touched
+    }
+    return data;
+#endif
+}
+
+// Function to release a file mapped by mapFile
+
+/**
+ * @brief Releases a mapping returned by mapFile.
+ */
+
+void unmapFile(char *data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    free(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+// Function to release a data file once its sections are loaded
+
+/**
+ * @brief Releases the mapping of a data file opened by openDataFile. Packed and 
+ * copied sections no longer need it once they are loaded, so it is kept only while 
+ * a table uses records in place. If the file did not load ('loaded' is 0), the 
+ * caller has detached its tables first (tableDetach) and the mapping always goes.
+ */
+
+void closeDataFile(DataFile *file, int loaded) {
+    if (!loaded || file->inPlace == 0) {
+        unmapFile(file->base, file->size);
+        file->base = NULL;
+    }
+}
+
+// Function to stop a table from using records in a mapped file
+void tableDetach(RecordTable *table) {
+    table->mapped = NULL;
+    table->mappedCount = 0;
+}
+
+// Function to write a versioned data file
+
+/**
+ * @brief Writes a data file holding one section per record table.
+ * 
+ * The file starts with a DataFileHeader and a table of DataSection entries, followed 
+ * by each section starting at a multiple of DATA_FILE_ALIGNMENT bytes. Tables with a 
+ * RecordLayout are packed (see packRecord), which leaves out the unused space of their 
+ * text fields; setting HOSPITAL_DATA_FORMAT=mapped writes every section as one contiguous 
+ * array of records instead, which is larger but can be used in place once the file is mapped. 
+ * Every section and the header (together with the section table) carry a checksum. 
+ * The file is flushed to disk before this function returns.
+ * 
+ * @param journalSequence Sequence number of the first journal record not included in the file.
+ * @return The size of the file in bytes if it was written, 0 otherwise.
+ */
+
+long long writeDataFile(const char *path, const SectionSource *sources, int sectionCount, unsigned int journalSequence) {
+    DataFileHeader header;
+    DataSection sections[DATA_FILE_MAX_SECTIONS];
+    static const char padding[DATA_FILE_ALIGNMENT];
+    const char *format = getenv("HOSPITAL_DATA_FORMAT");
+    int pack = format == NULL || strcmp(format, "mapped") != 0;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    // Write the sections one after another behind the header and the section table, computing each checksum as it is written
+    unsigned long long offset = sizeof(DataFileHeader) + sectionCount * sizeof(DataSection);
+    int written = fseek(file, (long)offset, SEEK_SET) == 0;
+    for (int i = 0; i < sectionCount && written; i++) {
+        RecordTable *table = sources[i].table;
+        const RecordLayout *layout = pack ? findRecordLayout(sources[i].id) : NULL;
+        unsigned long long start = (offset + DATA_FILE_ALIGNMENT - 1) / DATA_FILE_ALIGNMENT * DATA_FILE_ALIGNMENT;
+        written = fwrite(padding, 1, (size_t)(start - offset), file) == start - offset;
+        sections[i].id = sources[i].id | (layout != NULL ? SECTION_PACKED : 0);
+        sections[i].recordSize = (unsigned int)table->recordSize;
+        sections[i].count = (unsigned int)sources[i].count;
+        sections[i].offset = start;
+
+        if (layout != NULL) {
+            written = written && writePackedSection(file, &sources[i], layout, &sections[i]);
+        } else {
+            unsigned int checksum = CHECKSUM_START;
+            for (int first = 0; first < sources[i].count && written; ) {
+                int records = tableRun(table, first, sources[i].count - first);
+                checksum = checksumUpdate(checksum, tableAt(table, first), records * table->recordSize);
+                written = fwrite(tableAt(table, first), table->recordSize, records, file) == (size_t)records;
+                first += records;
+            }
+            sections[i].checksum = checksum;
+            sections[i].length = (unsigned long long)sources[i].count * table->recordSize;
+        }
+        offset = start + sections[i].length;
+    }
+
+    // Go back and fill in the header and section table now that the checksums are known
+    memcpy(header.magic, DATA_FILE_MAGIC, sizeof(header.magic));
+    header.version = DATA_FILE_VERSION;
+    header.sectionCount = (unsigned int)sectionCount;
+    header.journalSequence = journalSequence;
+    header.checksum = 0;
+    header.checksum = checksumUpdate(checksumBytes(&header, sizeof(header)), sections, sectionCount * sizeof(DataSection));
+
+    written = written && fseek(file, 0, SEEK_SET) == 0 &&
+              fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(sections, sizeof(DataSection), sectionCount, file) == (size_t)sectionCount &&
+              fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+    if (!written) {
+        return 0;
+    }
+    statsAdd(STATS_DATA_BYTES_WRITTEN, (long long)offset);
+    return (long long)offset;
+}
+
+// Function to open and validate a data file
+
+/**
+ * @brief Maps a data file and validates its header and section table.
+ * 
+ * Only the header and the section table are checked, so opening a file takes 
+ * the same time however many records it holds; the records themselves are 
+ * paged in when they are first used. Section checksums are checked by 
+ * verifyDataFile.
+ * 
+ * @return DATA_FILE_OK, DATA_FILE_MISSING, DATA_FILE_LEGACY (a file without a header, 
+ * written by an earlier version) or DATA_FILE_CORRUPT.
+ */
+
+int openDataFile(const char *path, DataFile *file) {
+    file->inPlace = 0;
+    file->base = mapFile(path, &file->size);
+    if (file->base == NULL) {
+        FILE *exists = fopen(path, "rb");
+        if (exists == NULL) {
+            return DATA_FILE_MISSING;
+        }
+        fclose(exists);
+        return DATA_FILE_LEGACY;  // Empty or unmappable; let the old reader report it
+    }
+
+    file->header = (DataFileHeader *)file->base;
+    file->sections = (DataSection *)(file->base + sizeof(DataFileHeader));
+    if (file->size < sizeof(DataFileHeader) || memcmp(file->header->magic, DATA_FILE_MAGIC, sizeof(file->header->magic)) != 0) {
+        unmapFile(file->base, file->size);
+        return DATA_FILE_LEGACY;
+    }
+
+    // Check the header, the section table and that every section lies inside the file
+    DataFileHeader header = *file->header;
+    int valid = header.version >= 1 && header.version <= DATA_FILE_VERSION &&
+                header.sectionCount <= DATA_FILE_MAX_SECTIONS &&
+                file->size >= sizeof(DataFileHeader) + header.sectionCount * sizeof(DataSection);
+    if (valid) {
+        header.checksum = 0;
+        valid = checksumUpdate(checksumBytes(&header, sizeof(header)), file->sections,
+                               header.sectionCount * sizeof(DataSection)) == file->header->checksum;
+    }
+    for (unsigned int i = 0; valid && i < header.sectionCount; i++) {
+        DataSection *section = &file->sections[i];
+        valid = section->offset % DATA_FILE_ALIGNMENT == 0 && section->offset <= file->size &&
+                section->length <= file->size - section->offset &&
+                ((section->id & SECTION_PACKED) || section->length == (unsigned long long)section->count * section->recordSize);
+    }
+
+    if (!valid) {
+        if (header.version > DATA_FILE_VERSION) {
+            printf("%s was written by a newer version of this program.\n", path);
+        }
+        unmapFile(file->base, file->size);
+        return DATA_FILE_CORRUPT;
+    }
+
+    if (getenv("HOSPITAL_VERIFY_DATA") != NULL && !verifyDataFile(file, path)) {
+        unmapFile(file->base, file->size);
+        return DATA_FILE_CORRUPT;
+    }
+    return DATA_FILE_OK;
+}
+
+// Function to find a section of a data file
+
+/**
+ * @brief Returns the section with the given id, packed or not, or NULL if the file has no such section.
+ */
+
+DataSection *findDataSection(DataFile *file, unsigned int id) {
+    for (unsigned int i = 0; i < file->header->sectionCount; i++) {
+        if ((file->sections[i].id & ~SECTION_PACKED) == id) {
+            return &file->sections[i];
+        }
+    }
+    return NULL;
+}
+
+// Function to load a section of a data file into a table
+
+/**
+ * @brief Makes the records of a data file section the contents of an empty table.
+ * 
+ * When the section's record size matches the table, the table uses the records 
+ * in place inside the mapped file, which costs no reading or copying. Otherwise 
+ * (a section written with a different record layout) the records are copied 
+ * into the table, cut or zero-filled to the current record size. A packed section 
+ * is unpacked into the table (see unpackSection). A missing section loads as an empty table.
+ * 
+ * @return 1 if the section was loaded, 0 if memory ran out or a packed section is damaged.
+ */
+
+int attachSection(DataFile *file, unsigned int id, RecordTable *table, int *count) {
+    DataSection *section = findDataSection(file, id);
+    *count = 0;
+    if (section == NULL) {
+        return 1;
+    }
+    if (section->id & SECTION_PACKED) {
+        return unpackSection(file, section, table, count);
+    }
+
+    char *records = file->base + section->offset;
+    if (section->recordSize == table->recordSize) {
+        table->mapped = records;
+        table->mappedCount = (int)section->count;
+        file->inPlace++;
+    } else {
+        size_t copySize = section->recordSize < table->recordSize ? section->recordSize : table->recordSize;
+        for (unsigned int i = 0; i < section->count; i++) {
+            char *slot = tableSlot(table, (int)i);
+            if (slot == NULL) {
+                return 0;
+            }
+            memset(slot, 0, table->recordSize);
+            memcpy(slot, records + (size_t)i * section->recordSize, copySize);
+        }
+    }
+    *count = (int)section->count;
+    return 1;
+}
+
+// Functions to pack records into the data files
+
+/*
+ * Functions to pack records into the data files.
+ * A packed record holds its fields in the order of its RecordLayout, with nothing between them:
+ * - Text is its length as a varint followed by its characters, so an empty 100-byte name takes one byte.
+ * - An integer is the difference from the same field of the previous record in the section, zigzag-encoded
+ *   (so small negative differences stay small) and written as a varint: 7 bits per byte, low bits first,
+ *   with the top bit set on every byte but the last. IDs, indexes and room numbers that count up
+ *   from record to record take one byte each.
+ * - Any other field is written as it is in memory.
+ * - findRecordLayout: Return the layout a section's records are packed with, or NULL for unpacked sections.
+ */
+
+const RecordLayout *findRecordLayout(unsigned int id) {
+    for (int i = 0; i < (int)(sizeof(recordLayouts) / sizeof(recordLayouts[0])); i++) {
+        if (recordLayouts[i].id == id) {
+            return &recordLayouts[i];
+        }
+    }
+    return NULL;
+}
+
+size_t packVarint(unsigned char *out, unsigned int value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (unsigned char)value;
+    return length;
+}
+
+int unpackVarint(const unsigned char **cursor, const unsigned char *end, unsigned int *value) {
+    *value = 0;
+    for (int shift = 0; shift < 35 && *cursor < end; shift += 7) {
+        unsigned char byte = *(*cursor)++;
+        *value |= (unsigned int)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to read an integer field of any size
+int recordFieldInt(const char *field, int size) {
+    if (size == sizeof(short)) {
+        short value;
+        memcpy(&value, field, sizeof(value));
+        return value;
+    }
+    if (size == sizeof(int)) {
+        int value;
+        memcpy(&value, field, sizeof(value));
+        return value;
+    }
+    return *(const unsigned char *)field;
+}
+
+// Function to store an integer field of any size
+void setRecordFieldInt(char *field, int size, int value) {
+    if (size == sizeof(short)) {
+        short narrow = (short)value;
+        memcpy(field, &narrow, sizeof(narrow));
+    } else if (size == sizeof(int)) {
+        memcpy(field, &value, sizeof(value));
+    } else {
+        *(unsigned char *)field = (unsigned char)value;
+    }
+}
+
+// Function to pack one record
+
+/**
+ * @brief Packs a record into 'out', which must have room for the record's size plus 
+ * 5 bytes per field. 'previous' holds the integer fields of the previous record 
+ * (all 0 before the first) and is updated.
+ * 
+ * @return The number of bytes written.
+ */
+
+size_t packRecord(const RecordLayout *layout, const char *record, int *previous, unsigned char *out) {
+    size_t length = 0;
+    for (int i = 0; i < layout->fieldCount; i++) {
+        const RecordField *field = &layout->fields[i];
+        const char *value = record + field->offset;
+        if (field->kind == FIELD_TEXT) {
+            const char *nul = memchr(value, '\0', field->size);
+            size_t textLength = nul != NULL ? (size_t)(nul - value) : field->size - 1u;
+            length += packVarint(out + length, (unsigned int)textLength);
+            memcpy(out + length, value, textLength);
+            length += textLength;
+        } else if (field->kind == FIELD_INT) {
+            int number = recordFieldInt(value, field->size);
+            unsigned int delta = (unsigned int)number - (unsigned int)previous[i];
+            length += packVarint(out + length, (delta << 1) ^ (0u - (delta >> 31)));  // Zigzag
+            previous[i] = number;
+        } else {
+            memcpy(out + length, value, field->size);
+            length += field->size;
+        }
+    }
+    return length;
+}
+
+// Function to unpack one record
+
+/**
+ * @brief Unpacks the record at '*cursor' into 'record', which must be zero-filled, 
+ * and moves the cursor past it. 'previous' is kept as in packRecord.
+ * 
+ * @return 1 if the record was unpacked, 0 if it runs past 'end' or a text is too long.
+ */
+
+int unpackRecord(const RecordLayout *layout, const unsigned char **cursor, const unsigned char *end, int *previous, char *record) {
+    for (int i = 0; i < layout->fieldCount; i++) {
+        const RecordField *field = &layout->fields[i];
+        char *value = record + field->offset;
+        unsigned int number;
+        if (field->kind == FIELD_TEXT) {
+            if (!unpackVarint(cursor, end, &number) || number >= field->size || (size_t)(end - *cursor) < number) {
+                return 0;
+            }
+            memcpy(value, *cursor, number);
+            *cursor += number;
+        } else if (field->kind == FIELD_INT) {
+            if (!unpackVarint(cursor, end, &number)) {
+                return 0;
+            }
+            unsigned int delta = (number >> 1) ^ (0u - (number & 1));
+            previous[i] = (int)((unsigned int)previous[i] + delta);
+            setRecordFieldInt(value, field->size, previous[i]);
+        } else {
+            if ((size_t)(end - *cursor) < field->size) {
+                return 0;
+            }
+            memcpy(value, *cursor, field->size);
+            *cursor += field->size;
+        }
+    }
+    return 1;
+}
+
+// Function to write a packed section
+
+/**
+ * @brief Packs the records of a table into a buffer and writes it to the file whenever 
+ * it fills, setting the section's checksum and length.
+ * 
+ * @return 1 if the section was written, 0 otherwise.
+ */
+
+int writePackedSection(FILE *file, const SectionSource *source, const RecordLayout *layout, DataSection *section) {
+    unsigned char *buffer = malloc(PACK_BUFFER_SIZE);
+    int previous[RECORD_MAX_FIELDS] = {0};
+    size_t used = 0, largest = source->table->recordSize + 5 * layout->fieldCount;
+    int written = buffer != NULL;
+
+    section->checksum = CHECKSUM_START;
+    section->length = 0;
+    for (int i = 0; i <= source->count && written; i++) {
+        if (i == source->count || PACK_BUFFER_SIZE - used < largest) {
+            section->checksum = checksumUpdate(section->checksum, buffer, used);
+            section->length += used;
+            written = fwrite(buffer, 1, used, file) == used;
+            used = 0;
+        }
+        if (i < source->count) {
+            used += packRecord(layout, tableAt(source->table, i), previous, buffer + used);
+        }
+    }
+    free(buffer);
+    return written;
+}
+
+// Function to load a packed section into a table
+
+/**
+ * @brief Unpacks every record of a packed section into an empty table.
+ * 
+ * Unlike a section that is mapped in place, this reads the whole section at load 
+ * time, which is the price of the smaller file.
+ * 
+ * @return 1 if the section was loaded, 0 if memory ran out or the section is damaged.
+ */
+
+int unpackSection(DataFile *file, DataSection *section, RecordTable *table, int *count) {
+    const RecordLayout *layout = findRecordLayout(section->id & ~SECTION_PACKED);
+    const unsigned char *cursor = (const unsigned char *)file->base + section->offset;
+    const unsigned char *end = cursor + section->length;
+    int previous[RECORD_MAX_FIELDS] = {0};
+    if (layout == NULL) {
+        return 0;
+    }
+#ifndef _WIN32
+    // Start reading the whole section from disk, so the later pages arrive while the first records are decoded
+    size_t start = (size_t)section->offset & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+    madvise(file->base + start, (size_t)(section->offset + section->length) - start, MADV_WILLNEED);
+#endif
+
+    for (unsigned int i = 0; i < section->count; i++) {
+        char *slot = tableSlot(table, (int)i);
+        if (slot == NULL) {
+            return 0;
+        }
+        memset(slot, 0, table->recordSize);
+        if (!unpackRecord(layout, &cursor, end, previous, slot)) {
+            return 0;
+        }
+    }
+    *count = (int)section->count;
+    return 1;
+}
+
+// Function to verify the section checksums of a data file
+
+/**
+ * @brief Checks every section of a data file against its checksum.
+ * 
+ * This reads every record of the file, so it only runs when the environment 
+ * variable HOSPITAL_VERIFY_DATA is set. Mismatches are reported as warnings, and 
+ * openDataFile then treats the file as damaged.
+ * 
+ * @return 1 if every section matches its checksum, 0 otherwise.
+ */
+
+int verifyDataFile(DataFile *file, const char *path) {
+    int valid = 1;
+    for (unsigned int i = 0; i < file->header->sectionCount; i++) {
+        DataSection *section = &file->sections[i];
+        if (checksumBytes(file->base + section->offset, (size_t)section->length) != section->checksum) {
+            printf("Warning: section %u of %s does not match its checksum.\n", section->id & ~SECTION_PACKED, path);
+            valid = 0;
+        }
+    }
+    return valid;
+}
+
+// Functions to load each data file
+
+/*
+ * Functions to load each data file.
+ * Each function opens its file, maps its sections into the matching tables and, once the file has
+ * loaded, remembers the journal sequence number it was saved at. A file without a header (written by an earlier version) is read
+ * with the old layout instead, and DATA_FILE_LEGACY is returned so that loadData can convert it.
+ * The name indexes of the loaded tables are marked stale and rebuilt on their first lookup.
+ * Each function returns one of the DATA_FILE_* results.
+ */
+
+int loadDoctorsFile() {
+    DataFile file;
+    int status = openDataFile("doctors.dat", &file);
+    int mapped = status == DATA_FILE_OK;
+    unsigned int sequence = 0;
+
+    if (status == DATA_FILE_OK) {
+        sequence = file.header->journalSequence;
+        if (!attachSection(&file, SECTION_DOCTORS, &doctorTable, &doctorCount)) {
+            status = DATA_FILE_CORRUPT;
+        }
+    } else if (status == DATA_FILE_LEGACY) {
+        // Read the number of doctors and their data from the file
+        FILE *doctorFile = fopen("doctors.dat", "rb");
+        if (doctorFile == NULL || fread(&doctorCount, sizeof(int), 1, doctorFile) != 1 || doctorCount < 0 ||
+            !tableRead(&doctorTable, doctorCount, doctorFile)) {
+            status = DATA_FILE_CORRUPT;
+        }
+        if (doctorFile) fclose(doctorFile);
+    }
+
+    if (status == DATA_FILE_CORRUPT) {
+        printf("Error reading doctors data.\n");
+        doctorCount = 0;
+        tableDetach(&doctorTable);
+    } else {
+        dataFileSequence[DATA_DOCTORS] = sequence;
+    }
+    if (mapped) {
+        closeDataFile(&file, status != DATA_FILE_CORRUPT);
+    }
+    doctorNameIndex.stale = 1;
+    textIndexes[SEARCH_SPECIALTY].stale = 1;
+    return status;
+}
+
+int loadPatientsFile() {
+    DataFile file;
+    int status = openDataFile("patients.dat", &file);
+    int mapped = status == DATA_FILE_OK;
+
+    int assignIDs = 0;  // Set for files written before patients had IDs
+    unsigned int sequence = 0;
+
+    if (status == DATA_FILE_OK) {
+        sequence = file.header->journalSequence;
+        DataSection *ids = findDataSection(&file, SECTION_PATIENT_IDS);
+        if (ids != NULL && ids->recordSize == sizeof(int) && ids->count == 1) {
+            memcpy(&patientIDs.nextID, file.base + ids->offset, sizeof(int));
+        } else {
+            assignIDs = 1;
+        }
+        if (file.header->version >= 2) {
+            if (!attachSection(&file, SECTION_PATIENTS, &patientTable, &patientSlotCount) ||
+                !attachSection(&file, SECTION_MEDICATIONS, &medicationTable, &medicationCatalogCount) ||
+                !attachSection(&file, SECTION_DOSAGES, &dosageTable, &dosageCount) ||
+                !attachSection(&file, SECTION_PRESCRIPTIONS, &prescriptionTable, &prescriptionCount)) {
+                status = DATA_FILE_CORRUPT;
+            }
+        } else {
+            // Version 1 kept the medications inside each patient; move them into the catalog
+            DataSection *section = findDataSection(&file, SECTION_PATIENTS);
+            size_t copySize = section == NULL ? 0 : section->recordSize < sizeof(LegacyPatient) ? section->recordSize : sizeof(LegacyPatient);
+            for (unsigned int i = 0; section != NULL && i < section->count && status != DATA_FILE_CORRUPT; i++) {
+                LegacyPatient legacy;
+                memset(&legacy, 0, sizeof(legacy));
+                memcpy(&legacy, file.base + section->offset + (size_t)i * section->recordSize, copySize);
+                Patient *patient = tableSlot(&patientTable, (int)i);
+                if (patient == NULL || !convertLegacyPatient(&legacy, patient)) {
+                    status = DATA_FILE_CORRUPT;
+                }
+                patientSlotCount = (int)i + 1;
+            }
+            if (status != DATA_FILE_CORRUPT) {
+                status = DATA_FILE_LEGACY;  // Rewritten in the current format by loadData
+            }
+        }
+    } else if (status == DATA_FILE_LEGACY) {
+        // Read the number of patients and their data from the file, in the layout without IDs
+        FILE *patientFile = fopen("patients.dat", "rb");
+        int legacyCount = 0;
+        if (patientFile == NULL || fread(&legacyCount, sizeof(int), 1, patientFile) != 1 || legacyCount < 0) {
+            status = DATA_FILE_CORRUPT;
+        }
+        for (int i = 0; status != DATA_FILE_CORRUPT && i < legacyCount; i++) {
+            LegacyPatient legacy;
+            memset(&legacy, 0, sizeof(legacy));
+            Patient *patient = tableSlot(&patientTable, i);
+            if (patient == NULL || fread(&legacy, LEGACY_PATIENT_SIZE, 1, patientFile) != 1 ||
+                !convertLegacyPatient(&legacy, patient)) {
+                status = DATA_FILE_CORRUPT;
+            }
+            patientSlotCount = i + 1;
+        }
+        if (patientFile) fclose(patientFile);
+        assignIDs = 1;
+    }
+
+    if (status == DATA_FILE_CORRUPT) {
+        printf("Error reading patients data.\n");
+        patientSlotCount = 0;
+        medicationCatalogCount = dosageCount = prescriptionCount = 0;
+        tableDetach(&patientTable);
+        tableDetach(&medicationTable);
+        tableDetach(&dosageTable);
+        tableDetach(&prescriptionTable);
+    } else {
+        dataFileSequence[DATA_PATIENTS] = sequence;
+    }
+    if (mapped) {
+        closeDataFile(&file, status != DATA_FILE_CORRUPT);  // Version 1 files were copied, so they are released too
+    }
+    if (status != DATA_FILE_CORRUPT && assignIDs) {
+        // Number the patients in their current order, which is the order they were added in
+        for (int i = 0; i < patientSlotCount; i++) {
+            patientAt(i)->id = i;
+        }
+        patientIDs.nextID = patientSlotCount;
+    }
+    patientCount = patientSlotCount;  // Saved files have no free slots; recounted when the ID map is built
+    patientIDs.stale = 1;
+    patientNameIndex.stale = 1;
+    medicationNameIndex.stale = 1;
+    dosageIndex.stale = 1;
+    medicationIndex.stale = 1;
+    patientColumns.stale = 1;
+    roomInventory.stale = 1;
+    textIndexes[SEARCH_PATIENT_NAME].stale = textIndexes[SEARCH_DIAGNOSIS].stale = 1;
+    unlinkedPrescriptions = 0;
+    return status;
+}
+
+// Function to convert a patient from an earlier file layout
+
+/**
+ * @brief Copies a patient read in the layout with inline medications, moving the medications
+ * into the medication catalog.
+ * 
+ * @return 1 if the patient was converted, 0 if memory ran out.
+ */
+
+int convertLegacyPatient(const LegacyPatient *legacy, Patient *patient) {
+    memset(patient, 0, sizeof(Patient));
+    memcpy(patient->name, legacy->name, sizeof(patient->name));
+    memcpy(patient->diagnosis, legacy->diagnosis, sizeof(patient->diagnosis));
+    patient->name[sizeof(patient->name) - 1] = patient->diagnosis[sizeof(patient->diagnosis) - 1] = '\0';
+    patient->age = legacy->age;
+    patient->roomNumber = legacy->roomNumber;
+    patient->doctorID = legacy->doctorID;
+    patient->id = legacy->id;
+    patient->admissionDate = legacy->admissionDate;
+    patient->firstMedication = patient->lastMedication = -1;
+
+    for (int i = 0; i < legacy->medicationCount && i < LEGACY_MAX_MEDICATIONS; i++) {
+        char name[sizeof(legacy->medications[i].name)], dosage[sizeof(legacy->medications[i].dosage)];
+        snprintf(name, sizeof(name), "%s", legacy->medications[i].name);
+        snprintf(dosage, sizeof(dosage), "%s", legacy->medications[i].dosage);
+        int medicationID = internMedication(name);
+        int dosageID = medicationID == -1 ? -1 : internDosage(dosage);
+        if (dosageID == -1 && medicationID != -1) {
+            dosageID = internDosage("");  // The normalized dosage did not fit
+        }
+        if (dosageID == -1 || appendPrescription(patient, medicationID, dosageID) == -1) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int loadStaffFile() {
+    DataFile file;
+    int status = openDataFile("staff.dat", &file);
+    int mapped = status == DATA_FILE_OK;
+    unsigned int sequence = 0;
+
+    if (status == DATA_FILE_OK) {
+        sequence = file.header->journalSequence;
+        if (!attachSection(&file, SECTION_STAFF, &staffTable, &staffCount) ||
+            !attachSection(&file, SECTION_SHIFTS, &shiftTable, &shiftCount) ||
+            !attachSection(&file, SECTION_ROLES, &roleTable, &roleCount)) {
+            status = DATA_FILE_CORRUPT;
+        }
+    } else if (status == DATA_FILE_LEGACY) {
+        // Read the number of staff and their data from the file. The oldest files hold exactly
+        // 'staffCount' records with a fixed inline schedule and nothing else; later ones are
+        // followed by the shift table and the role names.
+        FILE *staffFile = fopen("staff.dat", "rb");
+        long staffFileSize = 0;
+        if (staffFile != NULL) {
+            fseek(staffFile, 0, SEEK_END);
+            staffFileSize = ftell(staffFile);
+            fseek(staffFile, 0, SEEK_SET);
+        }
+        if (staffFile == NULL || fread(&staffCount, sizeof(int), 1, staffFile) != 1 || staffCount < 0) {
+            status = DATA_FILE_CORRUPT;
+        } else if (staffCount > 0 && staffFileSize == (long)(sizeof(int) + staffCount * sizeof(LegacyStaff))) {
+            if (!readLegacyStaff(staffFile, staffCount)) {
+                status = DATA_FILE_CORRUPT;
+            }
+        } else if (!tableRead(&staffTable, staffCount, staffFile) ||
+                   (staffCount > 0 && (fread(&shiftCount, sizeof(int), 1, staffFile) != 1 || shiftCount < 0 ||
+                                       !tableRead(&shiftTable, shiftCount, staffFile) ||
+                                       fread(&roleCount, sizeof(int), 1, staffFile) != 1 || roleCount < 0 ||
+                                       !tableRead(&roleTable, roleCount, staffFile)))) {
+            status = DATA_FILE_CORRUPT;
+        }
+        if (staffFile) fclose(staffFile);
+    }
+
+    if (status == DATA_FILE_CORRUPT) {
+        printf("Error reading staff data.\n");
+        staffCount = shiftCount = roleCount = 0;
+        tableDetach(&staffTable);
+        tableDetach(&shiftTable);
+        tableDetach(&roleTable);
+    } else {
+        dataFileSequence[DATA_STAFF] = sequence;
+    }
+    if (mapped) {
+        closeDataFile(&file, status != DATA_FILE_CORRUPT);
+    }
+    staffNameIndex.stale = 1;
+    roleNameIndex.stale = 1;
+    return status;
+}
+
+// Function to find the data file a journal record belongs to
+
+/**
+ * @brief Returns the DATA_* data file that holds the changes made by a type of journal record.
+ * 
+ * Journal replay skips a record when that data file was saved after the record was written.
+ */
+
+int journalRecordFile(int type) {
+    switch (type) {
+        case JOURNAL_ADD_DOCTOR:
+            return DATA_DOCTORS;
+        case JOURNAL_ADD_STAFF:
+        case JOURNAL_ADD_SHIFT:
+            return DATA_STAFF;
+        default:
+            return DATA_PATIENTS;
+    }
+}
+
+// Functions to convert between calendar dates and day numbers
+
+/**
+ * @brief Convert a calendar date to a day number and back.
+ * 
+ * Day numbers count the days since 1970-01-01 in the Gregorian calendar, so 
+ * consecutive dates have consecutive numbers and dates compare as integers. 
+ * parseDate accepts dates written as YYYY-MM-DD (years 1900-9999) and returns 
+ * INVALID_DATE for text that is not a valid date. formatDate writes YYYY-MM-DD into a buffer 
+ * of at least 11 characters. currentDate returns today's day number (in UTC).
+ */
+
+int daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = year / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+int parseDate(const char *text) {
+    int year, month, day;
+    char extra;
+    if (sscanf(text, "%4d-%2d-%2d%c", &year, &month, &day, &extra) != 3 ||
+        year < 1900 || month < 1 || month > 12 || day < 1) {
+        return INVALID_DATE;
+    }
+
+    static const int daysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int leapYear = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    if (day > daysInMonth[month - 1] + (month == 2 && leapYear)) {
+        return INVALID_DATE;
+    }
+    return daysFromCivil(year, month, day);
+}
+
+void formatDate(int dayNumber, char *buffer) {
+    int z = dayNumber + 719468;
+    int era = z / 146097;
+    int dayOfEra = z - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int monthIndex = (5 * dayOfYear + 2) / 153;
+    int day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    int month = monthIndex + (monthIndex < 10 ? 3 : -9);
+    int year = yearOfEra + era * 400 + (month <= 2);
+    sprintf(buffer, "%04d-%02d-%02d", year % 10000, month, day);
+}
+
+int currentDate() {
+    return (int)(time(NULL) / (24 * 60 * 60));
+}
+
+// Function to open the appointment store
+
+/**
+ * @brief Opens appointments.dat and maps it for reading, if it exists.
+ * 
+ * Only the header is read; the columns are paged in as they are scanned. The 
+ * file is created by the first appended appointment, so a missing file simply 
+ * means no appointments have been scheduled yet. Files written by version 1, 
+ * which had no time slots, are converted first.
+ * 
+ * @return 1 if the store is ready to use (or does not exist yet), 0 if the file is damaged.
+ */
+
+int appointmentStoreOpen() {
+    AppointmentStoreHeader header;
+    FILE *file = fopen(APPOINTMENT_STORE_FILE, "r+b");
+    if (file == NULL) {
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, APPOINTMENT_STORE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.blockRows != APPOINTMENT_BLOCK_ROWS) {
+        fclose(file);
+        printf("Error reading appointments data.\n");
+        return 0;
+    }
+
+    // Files from version 1 have no slot column; rewrite them in the current layout (this closes 'file')
+    if (header.version == 1 && header.columnCount == APPOINTMENT_LEGACY_COLUMNS) {
+        if (!appointmentStoreUpgrade(file, (int)header.rowCount)) {
+            printf("Error converting appointments data.\n");
+            return 0;
+        }
+        return appointmentStoreOpen();
+    }
+    if (header.version != APPOINTMENT_STORE_VERSION || header.columnCount != APPOINTMENT_COLUMNS) {
+        fclose(file);
+        printf("Error reading appointments data.\n");
+        return 0;
+    }
+
+    appointmentStore.file = file;
+    appointmentCount = (int)header.rowCount;
+    appointmentStore.blockCount = (appointmentCount + APPOINTMENT_BLOCK_ROWS - 1) / APPOINTMENT_BLOCK_ROWS;
+    return appointmentStoreRemap();
+}
+
+// Function to open the appointment store as one of loadData's tasks
+int loadAppointmentsFile() {
+    return appointmentStoreOpen() ? DATA_FILE_OK : DATA_FILE_CORRUPT;
+}
+
+// Function to map the appointment store's blocks
+
+/**
+ * @brief Maps every allocated block of the appointment store into memory.
+ * 
+ * The mapping is shared and read-only, so rows appended through the file are 
+ * visible through it straight away. Called again whenever a block is added.
+ * 
+ * @return 1 if the blocks are mapped, 0 otherwise.
+ */
+
+int appointmentStoreRemap() {
+    size_t size = APPOINTMENT_HEADER_SIZE + (size_t)appointmentStore.blockCount * APPOINTMENT_BLOCK_BYTES;
+#ifdef _WIN32
+    // Without mmap, columns are read block by block into a cache in appointmentColumn
+    appointmentStore.cachedBlock = -1;
+#else
+    if (appointmentStore.map != NULL) {
+        munmap(appointmentStore.map, appointmentStore.mapSize);
+        appointmentStore.map = NULL;
+    }
+    if (appointmentStore.blockCount > 0) {
+        void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(appointmentStore.file), 0);
+        if (map == MAP_FAILED) {
+            return 0;
+        }
+        appointmentStore.map = map;
+    }
+#endif
+    appointmentStore.mapSize = size;
+    return 1;
+}
+
+// Function to get one column of one block of the appointment store
+
+/**
+ * @brief Returns the APPOINTMENT_BLOCK_ROWS values of a column within a block.
+ * 
+ * Scans call this once per block for each column they need, so columns that a 
+ * query does not use are never read from disk.
+ * 
+ * @return Pointer to the column's values for the block.
+ */
+
+const int *appointmentColumn(int block, int column) {
+    size_t offset = APPOINTMENT_HEADER_SIZE + (size_t)block * APPOINTMENT_BLOCK_BYTES +
+                    (size_t)column * APPOINTMENT_BLOCK_ROWS * sizeof(int);
+#ifdef _WIN32
+    if (appointmentStore.cachedBlock != block) {
+        for (int c = 0; c < APPOINTMENT_COLUMNS; c++) {
+            appointmentStore.cachedColumnValid[c] = 0;
+        }
+        appointmentStore.cachedBlock = block;
+    }
+    if (!appointmentStore.cachedColumnValid[column]) {
+        fflush(appointmentStore.file);
+        fseek(appointmentStore.file, (long)offset, SEEK_SET);
+        fread(appointmentStore.cache[column], sizeof(int), APPOINTMENT_BLOCK_ROWS, appointmentStore.file);
+        appointmentStore.cachedColumnValid[column] = 1;
+    }
+    return appointmentStore.cache[column];
+#else
+    return (const int *)(appointmentStore.map + offset);
+#endif
+}
+
+// Function to get one appointment from the store
+
+/**
+ * @brief Reads the appointment at 'index' (0 to appointmentCount - 1) from all four columns.
+ * 
+ * @return The appointment.
+ */
+
+Appointment appointmentAt(int index) {
+    int block = index / APPOINTMENT_BLOCK_ROWS;
+    int row = index % APPOINTMENT_BLOCK_ROWS;
+    Appointment appointment;
+    appointment.patientID = appointmentColumn(block, APPOINTMENT_COLUMN_PATIENT)[row];
+    appointment.doctorID = appointmentColumn(block, APPOINTMENT_COLUMN_DOCTOR)[row];
+    appointment.date = appointmentColumn(block, APPOINTMENT_COLUMN_DATE)[row];
+    appointment.slot = appointmentColumn(block, APPOINTMENT_COLUMN_SLOT)[row];
+    return appointment;
+}
+
+// Function to create an empty appointment store
+
+/**
+ * @brief Creates an empty appointment store at 'path' and makes it the open store.
+ * 
+ * @return 1 if the file was created, 0 otherwise.
+ */
+
+int appointmentStoreCreate(const char *path) {
+    AppointmentStoreHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, APPOINTMENT_STORE_MAGIC, sizeof(header.magic));
+    header.version = APPOINTMENT_STORE_VERSION;
+    header.columnCount = APPOINTMENT_COLUMNS;
+    header.blockRows = APPOINTMENT_BLOCK_ROWS;
+
+    appointmentStore.file = fopen(path, "w+b");
+    if (appointmentStore.file == NULL) {
+        return 0;
+    }
+    if (fwrite(&header, sizeof(header), 1, appointmentStore.file) != 1) {
+        fclose(appointmentStore.file);
+        appointmentStore.file = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// Function to append an appointment to the store
+
+/**
+ * @brief Appends one appointment to the end of the appointment store.
+ * 
+ * The file grows one block at a time. Each value is written into its column's 
+ * slot, and the row count in the header is updated last, so a crash part-way 
+ * through an append never exposes a half-written row. The written rows reach 
+ * the disk at the next appointmentStoreSync.
+ * 
+ * @return 1 if the appointment was stored, 0 if the file could not be written.
+ */
+
+int appointmentStoreAppend(int patientID, int doctorID, int date, int slot) {
+    // Create the file with an empty header on the first append, unless a damaged file is in the way
+    if (appointmentStore.file == NULL && (appointmentStore.damaged || !appointmentStoreCreate(APPOINTMENT_STORE_FILE))) {
+        return 0;
+    }
+
+    // Add a block when the last one is full
+    int block = appointmentCount / APPOINTMENT_BLOCK_ROWS;
+    int row = appointmentCount % APPOINTMENT_BLOCK_ROWS;
+    if (block == appointmentStore.blockCount) {
+        fflush(appointmentStore.file);
+        if (ftruncate(fileno(appointmentStore.file), APPOINTMENT_HEADER_SIZE + (long)(block + 1) * APPOINTMENT_BLOCK_BYTES) != 0) {
+            return 0;
+        }
+        appointmentStore.blockCount++;
+        if (!appointmentStoreRemap()) {
+            return 0;
+        }
+    }
+
+    // Write the row's value into each column, then publish the new row count
+    int values[APPOINTMENT_COLUMNS];
+    values[APPOINTMENT_COLUMN_PATIENT] = patientID;
+    values[APPOINTMENT_COLUMN_DOCTOR] = doctorID;
+    values[APPOINTMENT_COLUMN_DATE] = date;
+    values[APPOINTMENT_COLUMN_SLOT] = slot;
+    for (int column = 0; column < APPOINTMENT_COLUMNS; column++) {
+        long offset = APPOINTMENT_HEADER_SIZE + (long)block * APPOINTMENT_BLOCK_BYTES +
+                      ((long)column * APPOINTMENT_BLOCK_ROWS + row) * (long)sizeof(int);
+        if (fseek(appointmentStore.file, offset, SEEK_SET) != 0 ||
+            fwrite(&values[column], sizeof(int), 1, appointmentStore.file) != 1) {
+            return 0;
+        }
+#ifdef _WIN32
+        appointmentStore.cachedColumnValid[column] = 0;
+#endif
+    }
+
+    unsigned int rowCount = (unsigned int)appointmentCount + 1;
+    if (fseek(appointmentStore.file, offsetof(AppointmentStoreHeader, rowCount), SEEK_SET) != 0 ||
+        fwrite(&rowCount, sizeof(rowCount), 1, appointmentStore.file) != 1 || fflush(appointmentStore.file) != 0) {
+        return 0;
+    }
+    appointmentCount++;
+    appointmentStore.unsynced = 1;
+    return 1;
+}
+
+// Function to mark an appointment in the store as cancelled
+
+/**
+ * @brief Sets the patient column of appointment number 'appointment' to -1.
+ * 
+ * Cancelled rows stay in the store, so the numbers of the other appointments 
+ * do not change, but every scan, index and calendar rebuild skips them. The 
+ * change reaches the disk at the next appointmentStoreSync.
+ * 
+ * @return 1 if the row was written, 0 otherwise.
+ */
+
+int appointmentStoreCancel(int appointment) {
+    int block = appointment / APPOINTMENT_BLOCK_ROWS;
+    int row = appointment % APPOINTMENT_BLOCK_ROWS;
+    int cancelled = -1;
+    long offset = APPOINTMENT_HEADER_SIZE + (long)block * APPOINTMENT_BLOCK_BYTES +
+                  ((long)APPOINTMENT_COLUMN_PATIENT * APPOINTMENT_BLOCK_ROWS + row) * (long)sizeof(int);
+    if (appointmentStore.file == NULL || fseek(appointmentStore.file, offset, SEEK_SET) != 0 ||
+        fwrite(&cancelled, sizeof(int), 1, appointmentStore.file) != 1 || fflush(appointmentStore.file) != 0) {
+        return 0;
+    }
+#ifdef _WIN32
+    appointmentStore.cachedColumnValid[APPOINTMENT_COLUMN_PATIENT] = 0;
+#endif
+    appointmentStore.unsynced = 1;
+    return 1;
+}
+
+// Function to convert an appointment store from version 1
+
+/**
+ * @brief Rewrites a version 1 appointment store, which had no slot column, in the current layout.
+ * 
+ * Reads the three old columns into memory, closes 'legacy', and writes every 
+ * appointment to a new store in its original order. Each appointment is given 
+ * the first free slot of its doctor's day; appointments on days that are 
+ * already full keep NO_SLOT. The new file replaces the old one only once it 
+ * is complete.
+ * 
+ * @return 1 if the store was converted, 0 otherwise.
+ */
+
+int appointmentStoreUpgrade(FILE *legacy, int rowCount) {
+    size_t legacyBlockBytes = (size_t)APPOINTMENT_LEGACY_COLUMNS * APPOINTMENT_BLOCK_ROWS * sizeof(int);
+    int *columns = malloc((size_t)(rowCount > 0 ? rowCount : 1) * APPOINTMENT_LEGACY_COLUMNS * sizeof(int));
+    if (columns == NULL) {
+        fclose(legacy);
+        return 0;
+    }
+
+    // Read each column of each block into one array per column
+    for (int first = 0; first < rowCount; first += APPOINTMENT_BLOCK_ROWS) {
+        int rows = rowCount - first < APPOINTMENT_BLOCK_ROWS ? rowCount - first : APPOINTMENT_BLOCK_ROWS;
+        for (int column = 0; column < APPOINTMENT_LEGACY_COLUMNS; column++) {
+            long offset = (long)(APPOINTMENT_HEADER_SIZE + (size_t)(first / APPOINTMENT_BLOCK_ROWS) * legacyBlockBytes +
+                                 (size_t)column * APPOINTMENT_BLOCK_ROWS * sizeof(int));
+            if (fseek(legacy, offset, SEEK_SET) != 0 ||
+                fread(columns + (size_t)column * rowCount + first, sizeof(int), rows, legacy) != (size_t)rows) {
+                free(columns);
+                fclose(legacy);
+                return 0;
+            }
+        }
+    }
+    fclose(legacy);
+
+    // Write the appointments to a new store, reserving a slot for each on an empty calendar
+    calendarClear();
+    appointmentCount = 0;
+    int written = appointmentStoreCreate(APPOINTMENT_STORE_FILE ".tmp");
+    for (int i = 0; written && i < rowCount; i++) {
+        int patientID = columns[i];
+        int doctorID = columns[(size_t)rowCount + i];
+        int date = columns[2 * (size_t)rowCount + i];
+        CalendarDay *day = calendarFind(doctorID, date, 1);
+        int slot = day != NULL ? nearestFreeSlot(day->slots, 0) : NO_SLOT;
+        if (slot != NO_SLOT) {
+            day->slots |= 1u << slot;
+        }
+        written = appointmentStoreAppend(patientID, doctorID, date, slot);
+    }
+    free(columns);
+
+    written = appointmentStoreClose() && written;
+    doctorCalendar.stale = 1;
+    appointmentCount = 0;
+    return written && replaceFile(APPOINTMENT_STORE_FILE ".tmp", APPOINTMENT_STORE_FILE);
+}
+
+// Function to close the appointment store
+
+/**
+ * @brief Syncs, unmaps and closes the appointment store.
+ * 
+ * @return 1 if the appended appointments reached the disk, 0 otherwise.
+ */
+
+int appointmentStoreClose() {
+    int synced = 1;
+    if (appointmentStore.file != NULL) {
+        synced = fflush(appointmentStore.file) == 0 && fsync(fileno(appointmentStore.file)) == 0;
+        fclose(appointmentStore.file);
+    }
+#ifndef _WIN32
+    if (appointmentStore.map != NULL) {
+        munmap(appointmentStore.map, appointmentStore.mapSize);
+    }
+#endif
+    memset(&appointmentStore, 0, sizeof(appointmentStore));
+    return synced;
+}
+
+// Function to flush the appointment store to disk
+
+/**
+ * @brief Forces appended appointments to disk. Called when the program is idle and at exit.
+ */
+
+void appointmentStoreSync() {
+    if (appointmentStore.file != NULL && appointmentStore.unsynced) {
+        fflush(appointmentStore.file);
+        fsync(fileno(appointmentStore.file));
+        appointmentStore.unsynced = 0;
+    }
+}
+
+// Function to scan the appointment store with a filter
+
+/**
+ * @brief Calls 'visit' for every appointment that matches a filter, in the order they were scheduled.
+ * 
+ * The doctor and date columns are only read when the filter uses them, so 
+ * a filtered scan reads a fraction of the store. Cancelled appointments (those 
+ * of removed patients) are skipped.
+ * 
+ * @param doctorID Only match appointments with this doctor, or -1 for any doctor.
+ * @param fromDate, toDate Only match appointments between these day numbers (inclusive).
+ * @param visit Function called with the index and contents of each matching appointment.
+ * @return The number of matching appointments.
+ */
+
+int scanAppointments(int doctorID, int fromDate, int toDate, void (*visit)(int index, const Appointment *appointment)) {
+    int matches = 0;
+    int blockCount = (appointmentCount + APPOINTMENT_BLOCK_ROWS - 1) / APPOINTMENT_BLOCK_ROWS;
+    int checkDates = fromDate > INT_MIN || toDate < INT_MAX;
+
+    for (int block = 0; block < blockCount; block++) {
+        int rows = appointmentCount - block * APPOINTMENT_BLOCK_ROWS;
+        if (rows > APPOINTMENT_BLOCK_ROWS) {
+            rows = APPOINTMENT_BLOCK_ROWS;
+        }
+        const int *patients = appointmentColumn(block, APPOINTMENT_COLUMN_PATIENT);
+        const int *doctors = doctorID >= 0 ? appointmentColumn(block, APPOINTMENT_COLUMN_DOCTOR) : NULL;
+        const int *dates = checkDates ? appointmentColumn(block, APPOINTMENT_COLUMN_DATE) : NULL;
+
+        for (int row = 0; row < rows; row++) {
+            if (patients[row] < 0 || (doctors != NULL && doctors[row] != doctorID) ||
+                (dates != NULL && (dates[row] < fromDate || dates[row] > toDate))) {
+                continue;
+            }
+            matches++;
+            if (visit != NULL) {
+                Appointment appointment = appointmentAt(block * APPOINTMENT_BLOCK_ROWS + row);
+                visit(block * APPOINTMENT_BLOCK_ROWS + row, &appointment);
+            }
+        }
+    }
+    return matches;
+}
+
+// Function to make room for one more entry in a posting list
+
+/**
+ * @brief Returns the posting list of 'key', growing the index and the list so one more entry fits.
+ * 
+ * If memory runs out the index is marked stale, so it is rebuilt on its next query.
+ * 
+ * @return The posting list, or NULL if memory could not be allocated.
+ */
+
+PostingList *appointmentIndexList(AppointmentIndex *index, int key) {
+    // Add posting lists up to 'key'
+    if (key >= index->listCount) {
+        int listCount = index->listCount > 0 ? index->listCount : 16;
+        while (listCount <= key) {
+            listCount *= 2;
+        }
+        PostingList *lists = realloc(index->lists, listCount * sizeof(PostingList));
+        if (lists == NULL) {
+            index->stale = 1;
+            return NULL;
+        }
+        memset(lists + index->listCount, 0, (listCount - index->listCount) * sizeof(PostingList));
+        index->lists = lists;
+        index->listCount = listCount;
+    }
+
+    PostingList *list = &index->lists[key];
+    if (list->count == list->capacity) {
+        int capacity = list->capacity > 0 ? list->capacity * 2 : 8;
+        DatePosting *entries = realloc(list->entries, capacity * sizeof(DatePosting));
+        if (entries == NULL) {
+            index->stale = 1;
+            return NULL;
+        }
+        list->entries = entries;
+        list->capacity = capacity;
+    }
+    return list;
+}
+
+// Function to add an appointment to a date index
+
+/**
+ * @brief Adds appointment number 'appointment' on 'date' to the posting list of 'key'.
+ * 
+ * The entry is inserted after every entry with the same or an earlier date, so 
+ * appointments on the same day stay in the order they were scheduled. A stale 
+ * index is left alone; the appointment is picked up when it is rebuilt.
+ */
+
+void appointmentIndexAdd(AppointmentIndex *index, int key, int date, int appointment) {
+    PostingList *list = index->stale ? NULL : appointmentIndexList(index, key);
+    if (list == NULL) {
+        return;
+    }
+
+    // Find the first entry with a later date and shift the rest of the list up by one
+    int position = postingLowerBound(list, date + 1);
+    memmove(&list->entries[position + 1], &list->entries[position], (list->count - position) * sizeof(DatePosting));
+    list->entries[position].date = date;
+    list->entries[position].appointment = appointment;
+    list->count++;
+}
+
+// Function to find the first entry of a posting list on or after a date
+
+/**
+ * @brief Binary searches a posting list for the first entry whose date is not before 'date'.
+ * 
+ * @return The position of that entry, or list->count if every entry is earlier.
+ */
+
+int postingLowerBound(const PostingList *list, int date) {
+    int low = 0, high = list->count;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (list->entries[middle].date < date) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Function to compare two posting list entries
+
+/**
+ * @brief qsort comparison function ordering entries by date, then by appointment number.
+ */
+
+int comparePostings(const void *first, const void *second) {
+    const DatePosting *a = first, *b = second;
+    if (a->date != b->date) {
+        return a->date < b->date ? -1 : 1;
+    }
+    return (a->appointment > b->appointment) - (a->appointment < b->appointment);
+}
+
+// Function to rebuild a date index from the appointment store
+
+/**
+ * @brief Clears a date index and adds every appointment in the store.
+ * 
+ * Reads only the ID column and the date column of each block. Entries are 
+ * appended to their lists in store order and each list is sorted once at the 
+ * end, which is much faster than inserting them one by one in date order.
+ * 
+ * @return 1 if the index was built, 0 if memory could not be allocated (the index stays stale).
+ */
+
+int appointmentIndexRebuild(AppointmentIndex *index) {
+    for (int i = 0; i < index->listCount; i++) {
+        index->lists[i].count = 0;
+    }
+    index->stale = 0;
+
+    int blockCount = (appointmentCount + APPOINTMENT_BLOCK_ROWS - 1) / APPOINTMENT_BLOCK_ROWS;
+    for (int block = 0; block < blockCount; block++) {
+        int rows = appointmentCount - block * APPOINTMENT_BLOCK_ROWS;
+        if (rows > APPOINTMENT_BLOCK_ROWS) {
+            rows = APPOINTMENT_BLOCK_ROWS;
+        }
+        const int *keys = appointmentColumn(block, index->column);
+        const int *patients = appointmentColumn(block, APPOINTMENT_COLUMN_PATIENT);
+        const int *dates = appointmentColumn(block, APPOINTMENT_COLUMN_DATE);
+
+        for (int row = 0; row < rows; row++) {
+            if (keys[row] < 0 || patients[row] < 0) {
+                continue;  // Cancelled
+            }
+            PostingList *list = appointmentIndexList(index, keys[row]);
+            if (list == NULL) {
+                printf("Not enough memory to index appointments.\n");
+                return 0;
+            }
+            list->entries[list->count].date = dates[row];
+            list->entries[list->count].appointment = block * APPOINTMENT_BLOCK_ROWS + row;
+            list->count++;
+        }
+    }
+
+    for (int i = 0; i < index->listCount; i++) {
+        if (index->lists[i].count > 1) {  // Empty lists have no entries array to sort
+            qsort(index->lists[i].entries, index->lists[i].count, sizeof(DatePosting), comparePostings);
+        }
+    }
+    return 1;
+}
+
+// Function to find the appointments of one doctor or patient in a range of dates
+
+/**
+ * @brief Calls 'visit' for each appointment of 'key' dated between 'fromDate' and 'toDate' (inclusive), in date order.
+ * 
+ * Takes O(log n + k) time for a doctor or patient with n appointments, k of 
+ * which match.
+ * 
+ * @return The number of matching appointments.
+ */
+
+int queryAppointments(AppointmentIndex *index, int key, int fromDate, int toDate, void (*visit)(int index, const Appointment *appointment)) {
+    if (index->stale && !appointmentIndexRebuild(index)) {
+        return 0;
+    }
+    if (key < 0 || key >= index->listCount) {
+        return 0;
+    }
+
+    PostingList *list = &index->lists[key];
+    int matches = 0;
+    for (int i = postingLowerBound(list, fromDate); i < list->count && list->entries[i].date <= toDate; i++) {
+        matches++;
+        if (visit != NULL) {
+            Appointment appointment = appointmentAt(list->entries[i].appointment);
+            visit(list->entries[i].appointment, &appointment);
+        }
+    }
+    return matches;
+}
+
+// Function to cancel the appointments of a removed patient
+
+/**
+ * @brief Marks every appointment of 'patientID' as cancelled in the store and 
+ * takes them out of the doctors' calendars and the date indexes.
+ * 
+ * The patient's appointments are found through the patient index, so this takes 
+ * O(k log n) time for k appointments. Their slots become free to book again. 
+ * A calendar or index that is stale is left alone, since it skips cancelled 
+ * appointments when it is rebuilt.
+ */
+
+void cancelPatientAppointments(int patientID) {
+    AppointmentIndex *index = &patientAppointmentIndex;
+    if (appointmentStore.file == NULL || (index->stale && !appointmentIndexRebuild(index)) ||
+        patientID < 0 || patientID >= index->listCount) {
+        return;
+    }
+
+    PostingList *list = &index->lists[patientID];
+    for (int i = 0; i < list->count; i++) {
+        int number = list->entries[i].appointment;
+        Appointment appointment = appointmentAt(number);
+        if (!appointmentStoreCancel(number)) {
+            // The row still names the removed patient; the views leave it out when they look the patient up
+            printf("Error updating appointments data.\n");
+            continue;
+        }
+
+        // Free the slot on the doctor's calendar
+        CalendarDay *day = doctorCalendar.stale || appointment.slot < 0 || appointment.slot >= CALENDAR_SLOTS ? NULL :
+                           calendarFind(appointment.doctorID, appointment.date, 0);
+        if (day != NULL) {
+            day->slots &= ~(1u << appointment.slot);
+        }
+
+        // Remove the entry from the doctor's posting list, among the entries on the same date
+        AppointmentIndex *doctors = &doctorAppointmentIndex;
+        if (!doctors->stale && appointment.doctorID >= 0 && appointment.doctorID < doctors->listCount) {
+            PostingList *doctorList = &doctors->lists[appointment.doctorID];
+            for (int p = postingLowerBound(doctorList, appointment.date);
+                 p < doctorList->count && doctorList->entries[p].date == appointment.date; p++) {
+                if (doctorList->entries[p].appointment == number) {
+                    memmove(&doctorList->entries[p], &doctorList->entries[p + 1], (doctorList->count - p - 1) * sizeof(DatePosting));
+                    doctorList->count--;
+                    break;
+                }
+            }
+        }
+    }
+    list->count = 0;
+}
+
+// Function to find a day in the doctors' calendar
+
+/**
+ * @brief Looks up the calendar entry of 'doctorID' on 'date', adding an empty one if 'create' is set.
+ * 
+ * Probes the hash table from the pair's hash until the entry or an empty slot is 
+ * found, so it takes O(1) time on average. The table is doubled before it becomes 
+ * half full.
+ * 
+ * @return The calendar entry, or NULL if it does not exist (or memory could not be allocated).
+ */
+
+CalendarDay *calendarFind(int doctorID, int date, int create) {
+    if (create && (doctorCalendar.used + 1) * 2 > doctorCalendar.capacity) {
+        int capacity = doctorCalendar.capacity > 0 ? doctorCalendar.capacity * 2 : 64;
+        CalendarDay *days = malloc(capacity * sizeof(CalendarDay));
+        if (days == NULL) {
+            return NULL;
+        }
+        for (int i = 0; i < capacity; i++) {
+            days[i].doctorID = -1;
+        }
+
+        // Move the existing entries into the larger table
+        CalendarDay *oldDays = doctorCalendar.days;
+        int oldCapacity = doctorCalendar.capacity;
+        doctorCalendar.days = days;
+        doctorCalendar.capacity = capacity;
+        for (int i = 0; i < oldCapacity; i++) {
+            if (oldDays[i].doctorID >= 0) {
+                unsigned int j = calendarHash(oldDays[i].doctorID, oldDays[i].date) & (capacity - 1);
+                while (days[j].doctorID >= 0) {
+                    j = (j + 1) & (capacity - 1);
+                }
+                days[j] = oldDays[i];
+            }
+        }
+        free(oldDays);
+    }
+    if (doctorCalendar.capacity == 0) {
+        return NULL;
+    }
+
+    unsigned int mask = doctorCalendar.capacity - 1;
+    unsigned int i = calendarHash(doctorID, date) & mask;
+    while (doctorCalendar.days[i].doctorID >= 0) {
+        CalendarDay *day = &doctorCalendar.days[i];
+        if (day->doctorID == doctorID && day->date == date) {
+            return day;
+        }
+        i = (i + 1) & mask;
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    CalendarDay *day = &doctorCalendar.days[i];
+    day->doctorID = doctorID;
+    day->date = date;
+    day->slots = 0;
+    doctorCalendar.used++;
+    return day;
+}
+
+// Function to hash a doctor and a date for the calendar
+unsigned int calendarHash(int doctorID, int date) {
+    return ((unsigned int)doctorID * 2654435761u) ^ ((unsigned int)date * 40503u);
+}
+
+// Function to empty the doctors' calendar
+void calendarClear() {
+    for (int i = 0; i < doctorCalendar.capacity; i++) {
+        doctorCalendar.days[i].doctorID = -1;
+    }
+    doctorCalendar.used = 0;
+    doctorCalendar.stale = 0;
+}
+
+// Function to rebuild the doctors' calendar from the appointment store
+
+/**
+ * @brief Clears the calendar and marks the slot of every appointment in the store.
+ * 
+ * Reads the patient column (to skip cancelled appointments) and the doctor, date 
+ * and slot columns of each block.
+ * 
+ * @return 1 if the calendar was built, 0 if memory could not be allocated (the calendar stays stale).
+ */
+
+int calendarRebuild() {
+    calendarClear();
+
+    int blockCount = (appointmentCount + APPOINTMENT_BLOCK_ROWS - 1) / APPOINTMENT_BLOCK_ROWS;
+    for (int block = 0; block < blockCount; block++) {
+        int rows = appointmentCount - block * APPOINTMENT_BLOCK_ROWS;
+        if (rows > APPOINTMENT_BLOCK_ROWS) {
+            rows = APPOINTMENT_BLOCK_ROWS;
+        }
+        const int *patients = appointmentColumn(block, APPOINTMENT_COLUMN_PATIENT);
+        const int *doctors = appointmentColumn(block, APPOINTMENT_COLUMN_DOCTOR);
+        const int *dates = appointmentColumn(block, APPOINTMENT_COLUMN_DATE);
+        const int *slots = appointmentColumn(block, APPOINTMENT_COLUMN_SLOT);
+
+        for (int row = 0; row < rows; row++) {
+            if (patients[row] < 0 || slots[row] < 0 || slots[row] >= CALENDAR_SLOTS) {
+                continue;
+            }
+            CalendarDay *day = calendarFind(doctors[row], dates[row], 1);
+            if (day == NULL) {
+                printf("Not enough memory to build the doctors' calendars.\n");
+                doctorCalendar.stale = 1;
+                return 0;
+            }
+            day->slots |= 1u << slots[row];
+        }
+    }
+    return 1;
+}
+
+// Function to get the booked slots of a doctor on a day
+
+/**
+ * @brief Returns the bitmap of the slots booked for 'doctorID' on 'date' (bit i is slot i).
+ * 
+ * The number of set bits is the number of booked slots, which gives the day's 
+ * utilisation without looking at any appointments.
+ */
+
+unsigned int calendarSlots(int doctorID, int date) {
+    if (doctorCalendar.stale && !calendarRebuild()) {
+        return 0;
+    }
+    CalendarDay *day = calendarFind(doctorID, date, 0);
+    return day != NULL ? day->slots : 0;
+}
+
+// Function to find the free slot nearest to a given slot
+
+/**
+ * @brief Returns the free slot in the bitmap 'booked' that is closest to 'slot', preferring the earlier one on a tie.
+ * 
+ * @return The free slot, or NO_SLOT if the day is fully booked.
+ */
+
+int nearestFreeSlot(unsigned int booked, int slot) {
+    if ((booked & CALENDAR_FULL_DAY) == CALENDAR_FULL_DAY) {
+        return NO_SLOT;
+    }
+    for (int distance = 0; distance < CALENDAR_SLOTS; distance++) {
+        if (slot - distance >= 0 && !(booked & (1u << (slot - distance)))) {
+            return slot - distance;
+        }
+        if (slot + distance < CALENDAR_SLOTS && !(booked & (1u << (slot + distance)))) {
+            return slot + distance;
+        }
+    }
+    return NO_SLOT;
+}
+
+// Function to convert a time of day to a calendar slot
+
+/**
+ * @brief Converts minutes since midnight to a slot, or to NO_SLOT if the time is 
+ * outside working hours or does not fall on the start of a slot.
+ */
+
+int slotFromTime(int minutes) {
+    int offset = minutes - CALENDAR_DAY_START;
+    if (minutes < 0 || offset < 0 || offset % CALENDAR_SLOT_MINUTES != 0 ||
+        offset / CALENDAR_SLOT_MINUTES >= CALENDAR_SLOTS) {
+        return NO_SLOT;
+    }
+    return offset / CALENDAR_SLOT_MINUTES;
+}
+
+// Function to get the start time of a calendar slot
+int slotTime(int slot) {
+    return CALENDAR_DAY_START + slot * CALENDAR_SLOT_MINUTES;
+}
+
+// Function to make sure the patient ID map is up to date
+
+/**
+ * @brief Builds the ID→slot map and the free slot list from the patient table, if they are stale.
+ * 
+ * Runs once after loading data: it reads the ID of every slot, so lookups by 
+ * ID afterwards take O(1) time. Free (tombstoned) slots found on the way are 
+ * put on the free list, and the number of live patients is recounted.
+ * 
+ * @return 1 if the map is ready, 0 if memory could not be allocated.
+ */
+
+int patientIDMapReady() {
+    if (!patientIDs.stale) {
+        return 1;
+    }
+
+    for (int id = 0; id < patientIDs.capacity; id++) {
+        patientIDs.slots[id] = -1;
+    }
+    patientIDs.freeCount = 0;
+    patientCount = 0;
+    for (int slot = 0; slot < patientSlotCount; slot++) {
+        int id = patientAt(slot)->id;
+        if (id < 0) {
+            if (!pushFreePatientSlot(slot)) {
+                return 0;
+            }
+        } else if (!patientIDMapSet(id, slot)) {
+            return 0;
+        } else {
+            patientCount++;
+        }
+    }
+    patientIDs.stale = 0;
+    return 1;
+}
+
+// Function to record the slot of a patient ID
+
+/**
+ * @brief Sets the slot of 'patientID' in the ID→slot map, growing the map if needed.
+ * 
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+
+int patientIDMapSet(int patientID, int slot) {
+    if (patientID >= patientIDs.capacity) {
+        int capacity = patientIDs.capacity > 0 ? patientIDs.capacity : 64;
+        while (capacity <= patientID) {
+            capacity *= 2;
+        }
+        int *slots = realloc(patientIDs.slots, capacity * sizeof(int));
+        if (slots == NULL) {
+            return 0;
+        }
+        for (int id = patientIDs.capacity; id < capacity; id++) {
+            slots[id] = -1;
+        }
+        patientIDs.slots = slots;
+        patientIDs.capacity = capacity;
+    }
+    patientIDs.slots[patientID] = slot;
+    return 1;
+}
+
+// Function to add a slot to the list of free patient slots
+
+/**
+ * @brief Pushes a tombstoned slot onto the free list, so the next new patient can reuse it.
+ * 
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+
+int pushFreePatientSlot(int slot) {
+    if (patientIDs.freeCount == patientIDs.freeCapacity) {
+        int capacity = patientIDs.freeCapacity > 0 ? patientIDs.freeCapacity * 2 : 16;
+        int *freeSlots = realloc(patientIDs.freeSlots, capacity * sizeof(int));
+        if (freeSlots == NULL) {
+            return 0;
+        }
+        patientIDs.freeSlots = freeSlots;
+        patientIDs.freeCapacity = capacity;
+    }
+    patientIDs.freeSlots[patientIDs.freeCount++] = slot;
+    return 1;
+}
+
+// Function to find the slot of a patient
+
+/**
+ * @brief Looks up the table slot holding the patient with ID 'patientID' in O(1) time.
+ * 
+ * @return The slot, or -1 if there is no such patient (or it was removed).
+ */
+
+int patientSlot(int patientID) {
+    if (!patientIDMapReady() || patientID < 0 || patientID >= patientIDs.capacity) {
+        return -1;
+    }
+    return patientIDs.slots[patientID];
+}
+
+// Function to get a patient by ID
+
+/**
+ * @brief Returns the patient with ID 'patientID', or NULL if there is no such patient.
+ */
+
+Patient *patientByID(int patientID) {
+    int slot = patientSlot(patientID);
+    return slot >= 0 ? patientAt(slot) : NULL;
+}
+
+// Function to get the doctor treating a patient
+
+/**
+ * @brief Returns the doctor treating 'patient', or NULL if the patient has none 
+ * because the doctors' data was lost (see loadCheckReferences).
+ */
+
+Doctor *patientDoctor(const Patient *patient) {
+    return patient->doctorID >= 0 && patient->doctorID < doctorCount ? doctorAt(patient->doctorID) : NULL;
+}
+
+// Function to find a patient by position
+
+/**
+ * @brief Returns the ID of the patient at 'position' when patients are listed in ID order.
+ * 
+ * Journals written by earlier versions refer to patients by their position in 
+ * the old, always compact patient array. IDs are handed out in insertion order 
+ * and that array kept insertion order, so the position of a patient there is its 
+ * rank among the live patients by ID. Takes O(n) time; only used for old records.
+ * 
+ * @return The patient ID, or -1 if there are not that many patients.
+ */
+
+int patientIDAtPosition(int position) {
+    if (!patientIDMapReady() || position < 0) {
+        return -1;
+    }
+    for (int id = 0; id < patientIDs.nextID && id < patientIDs.capacity; id++) {
+        if (patientIDs.slots[id] >= 0 && position-- == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+// Function to compare two slot numbers
+int compareSlots(const void *first, const void *second) {
+    int a = *(const int *)first, b = *(const int *)second;
+    return (a > b) - (a < b);
+}
+
+// Function to compact the patient table
+
+/**
+ * @brief Moves patients from the end of the table into the free slots so the live patients fill slots 0 to patientCount - 1.
+ * 
+ * Each free slot is filled by the last live patient, so the work is proportional 
+ * to the number of removed patients, not to the size of the table. Patients 
+ * keep their IDs; only the ID→slot map and the name index entries of the moved 
+ * patients change. Called when the program is idle and before saving.
+ */
+
+void compactPatients() {
+    if (!patientIDMapReady() || patientIDs.freeCount == 0) {
+        return;
+    }
+
+    qsort(patientIDs.freeSlots, patientIDs.freeCount, sizeof(int), compareSlots);
+    int high = patientSlotCount - 1;
+    for (int next = 0; next < patientIDs.freeCount; next++) {
+        while (high >= 0 && patientAt(high)->id < 0) {
+            high--;
+        }
+        int hole = patientIDs.freeSlots[next];
+        if (hole >= high) {
+            break;  // Every remaining free slot is past the last live patient
+        }
+
+        Patient *from = patientAt(high);
+        memcpy(patientAt(hole), from, sizeof(Patient));
+        patientIDs.slots[from->id] = hole;
+        patientColumnsSet(hole, patientAt(hole));
+        if (!patientNameIndex.stale) {
+            nameIndexRemove(&patientNameIndex, from->name);
+            if (nameIndexInsert(&patientNameIndex, hole) < 0) {
+                patientNameIndex.stale = 1;
+            }
+        }
+        from->id = -1;
+        from->name[0] = '\0';
+        high--;
+    }
+
+    // Drop the free slots that are now past the end of the table
+    patientSlotCount = patientCount;
+    if (patientColumns.count > patientSlotCount) {
+        patientColumns.count = patientSlotCount;
+    }
+    patientIDs.freeCount = 0;
+}
+
+// Function to compact the patient table when the program is idle
+
+/**
+ * @brief Compacts the patient table once removed patients make up a sizeable part of it.
+ * 
+ * New patients reuse free slots first, so the table only needs compacting 
+ * after more removals than additions.
+ */
+
+void compactPatientsIdle() {
+    int freeSlots = patientSlotCount - patientCount;
+    if (!patientIDs.stale && freeSlots > 0 && freeSlots * PATIENT_COMPACT_FRACTION >= patientSlotCount) {
+        compactPatients();
+    }
+}
+
+// Functions that maintain the report aggregates
+
+/*
+ * Functions that maintain the report aggregates (see ReportAggregates).
+ * - countAdd: Add to the count of an ID, growing the array as needed.
+ * - aggregateStaff / aggregateShift: Count a new staff member or shift.
+ * - aggregatePatient: Count a patient as added (delta 1) or removed (delta -1).
+ * The aggregate* functions do nothing while the aggregates are stale, and mark them stale if memory runs out.
+ * - aggregatesReady: Build the aggregates from the tables if they are stale.
+ */
+
+int countAdd(CountArray *array, int id, int delta) {
+    if (id >= array->capacity) {
+        int capacity = array->capacity > 0 ? array->capacity : 16;
+        while (capacity <= id) {
+            capacity *= 2;
+        }
+        int *counts = realloc(array->counts, capacity * sizeof(int));
+        if (counts == NULL) {
+            return 0;
+        }
+        memset(counts + array->capacity, 0, (capacity - array->capacity) * sizeof(int));
+        array->counts = counts;
+        array->capacity = capacity;
+    }
+    array->counts[id] += delta;
+    return 1;
+}
+
+void aggregateStaff(Staff *member) {
+    if (reportAggregates.stale) {
+        return;
+    }
+    int roleID = internRole(member->role);
+    if (roleID == -1 || !countAdd(&reportAggregates.staffPerRole, roleID, 1)) {
+        reportAggregates.stale = 1;
+        return;
+    }
+    if (member->shiftCount == 0) {
+        reportAggregates.staffWithNoShifts++;
+    }
+}
+
+void aggregateShift(Staff *member, Shift *shift) {
+    if (reportAggregates.stale) {
+        return;
+    }
+    if (!countAdd(&reportAggregates.shiftsPerRole, shift->roleID, 1)) {
+        reportAggregates.stale = 1;
+        return;
+    }
+    reportAggregates.shiftsPerDay[shift->day]++;
+    if (member->shiftCount == 1) {
+        reportAggregates.staffWithNoShifts--;  // This was the member's first shift
+    }
+}
+
+void aggregatePatient(Patient *patient, int delta) {
+    if (reportAggregates.stale || patient->doctorID < 0) {
+        return;
+    }
+    if (!countAdd(&reportAggregates.patientsPerDoctor, patient->doctorID, delta)) {
+        reportAggregates.stale = 1;
+    }
+}
+
+int aggregatesReady() {
+    ReportAggregates *aggregates = &reportAggregates;
+    if (!aggregates->stale) {
+        return 1;
+    }
+
+    // Start from zero, keeping the allocated arrays
+    aggregates->stale = 0;
+    aggregates->staffWithNoShifts = 0;
+    memset(aggregates->shiftsPerDay, 0, sizeof(aggregates->shiftsPerDay));
+    CountArray *arrays[] = {&aggregates->shiftsPerRole, &aggregates->staffPerRole, &aggregates->patientsPerDoctor};
+    for (int i = 0; i < 3; i++) {
+        if (arrays[i]->capacity > 0) {
+            memset(arrays[i]->counts, 0, arrays[i]->capacity * sizeof(int));
+        }
+    }
+
+    for (int i = 0; i < staffCount && !aggregates->stale; i++) {
+        Staff *member = staffAt(i);
+        aggregateStaff(member);
+        for (int s = member->firstShift; s != -1 && !aggregates->stale; s = shiftAt(s)->next) {
+            Shift *shift = shiftAt(s);
+            if (!countAdd(&aggregates->shiftsPerRole, shift->roleID, 1)) {
+                aggregates->stale = 1;
+            }
+            aggregates->shiftsPerDay[shift->day]++;
+        }
+    }
+    for (int i = 0; i < patientSlotCount && !aggregates->stale; i++) {
+        if (patientAt(i)->id >= 0) {
+            aggregatePatient(patientAt(i), 1);
+        }
+    }
+    if (aggregates->stale) {
+        printf("Not enough memory to build the report summary.\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Function to update the query columns of a patient slot
+
+/**
+ * @brief Copies the filtered fields of the patient in a slot into the query columns.
+ * 
+ * Called whenever a slot changes (a patient is added, removed or moved by compaction), 
+ * so the columns always match the table. A slot past the end grows the columns; if 
+ * memory runs out the columns are marked stale and rebuilt on their next use.
+ */
+
+void patientColumnsSet(int slot, const Patient *patient) {
+    PatientColumns *columns = &patientColumns;
+    if (columns->stale) {
+        return;
+    }
+    if (slot >= columns->capacity) {
+        int capacity = columns->capacity > 0 ? columns->capacity : 1024;
+        while (capacity <= slot) {
+            capacity *= 2;
+        }
+        int **arrays[] = {&columns->ages, &columns->rooms, &columns->doctors, &columns->ids};
+        for (int i = 0; i < 4; i++) {
+            int *grown = realloc(*arrays[i], capacity * sizeof(int));
+            if (grown == NULL) {
+                columns->stale = 1;
+                return;
+            }
+            *arrays[i] = grown;
+        }
+        columns->capacity = capacity;
+    }
+
+    columns->ages[slot] = patient->age;
+    columns->rooms[slot] = patient->roomNumber;
+    columns->doctors[slot] = patient->doctorID;
+    columns->ids[slot] = patient->id;
+    if (slot >= columns->count) {
+        columns->count = slot + 1;
+    }
+}
+
+// Function to build the query columns if they are stale
+int patientColumnsReady() {
+    PatientColumns *columns = &patientColumns;
+    if (!columns->stale) {
+        return 1;
+    }
+    columns->stale = 0;
+    columns->count = 0;
+    for (int i = 0; i < patientSlotCount && !columns->stale; i++) {
+        patientColumnsSet(i, patientAt(i));
+    }
+    if (columns->stale) {
+        printf("Not enough memory to index the patients for queries.\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Function to scan the query columns
+
+/**
+ * @brief Finds the patient slots in [first, last) that match a query.
+ * 
+ * Each column is read in order, four slots at a time with SSE2 where the compiler 
+ * offers it, and a slot is rejected when any of its compares fails, so the loop has 
+ * no branches on the data and runs at the speed the columns stream from memory. 
+ * Free slots hold ID -1 and never match. The matching slots are written in order 
+ * to 'slots' (which must hold last - first + 4 entries), or only counted when 
+ * 'slots' is NULL.
+ * 
+ * @return The number of matching slots.
+ */
+
+int patientQueryScan(const PatientQuery *query, int first, int last, int *slots) {
+    const PatientColumns *columns = &patientColumns;
+    int matched = 0, i = first;
+
+#ifdef __SSE2__
+    static const unsigned char bitCounts[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    const __m128i minAge = _mm_set1_epi32(query->minAge), maxAge = _mm_set1_epi32(query->maxAge);
+    const __m128i minRoom = _mm_set1_epi32(query->minRoom), maxRoom = _mm_set1_epi32(query->maxRoom);
+    const __m128i doctor = _mm_set1_epi32(query->doctorID);
+    const __m128i anyDoctor = _mm_set1_epi32(query->doctorID == -1 ? -1 : 0);
+    const __m128i noID = _mm_setzero_si128();
+    for (; i + 4 <= last; i += 4) {
+        __m128i age = _mm_loadu_si128((const __m128i *)(columns->ages + i));
+        __m128i room = _mm_loadu_si128((const __m128i *)(columns->rooms + i));
+        __m128i doctors = _mm_loadu_si128((const __m128i *)(columns->doctors + i));
+        __m128i ids = _mm_loadu_si128((const __m128i *)(columns->ids + i));
+        __m128i reject = _mm_or_si128(_mm_cmplt_epi32(age, minAge), _mm_cmpgt_epi32(age, maxAge));
+        reject = _mm_or_si128(reject, _mm_or_si128(_mm_cmplt_epi32(room, minRoom), _mm_cmpgt_epi32(room, maxRoom)));
+        reject = _mm_or_si128(reject, _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(doctors, doctor), anyDoctor),
+                                                       _mm_set1_epi32(-1)));
+        reject = _mm_or_si128(reject, _mm_cmplt_epi32(ids, noID));
+        int mask = ~_mm_movemask_ps(_mm_castsi128_ps(reject)) & 15;
+        if (slots == NULL) {
+            matched += bitCounts[mask];
+        } else {
+            // Write every slot and advance past the matching ones, which needs no branches
+            for (int lane = 0; lane < 4; lane++) {
+                slots[matched] = i + lane;
+                matched += (mask >> lane) & 1;
+            }
+        }
+    }
+#endif
+
+    // The remaining slots (or all of them without SSE2), in a loop the compiler can vectorize
+    for (; i < last; i++) {
+        int match = (columns->ages[i] >= query->minAge) & (columns->ages[i] <= query->maxAge) &
+                    (columns->rooms[i] >= query->minRoom) & (columns->rooms[i] <= query->maxRoom) &
+                    ((query->doctorID == -1) | (columns->doctors[i] == query->doctorID)) & (columns->ids[i] >= 0);
+        if (slots != NULL) {
+            slots[matched] = i;
+        }
+        matched += match;
+    }
+    return matched;
+}
+
+// Function to count the patients that match a query
+int countPatients(const PatientQuery *query) {
+    if (!patientColumnsReady()) {
+        return -1;
+    }
+    return patientQueryScan(query, 0, patientColumns.count, NULL);
+}
+
+// Function to list the patients that match a query
+
+/**
+ * @brief Lists the patients that match a query, in slot order like viewPatients, through the output layer.
+ * 
+ * The slots are found by patientQueryScan over the columns, so only the matching 
+ * patient records are read.
+ * 
+ * @return STATUS_OK or STATUS_NO_MEMORY.
+ */
+
+int listQueryPatients(const PatientQuery *query) {
+    if (!patientColumnsReady()) {
+        return STATUS_NO_MEMORY;
+    }
+    int *slots = malloc((patientColumns.count + 4) * sizeof(int));
+    if (slots == NULL) {
+        return STATUS_NO_MEMORY;
+    }
+    int matched = patientQueryScan(query, 0, patientColumns.count, slots);
+
+    outputBegin();
+    outputText("\n----- Matching Patients -----\n");
+    for (int i = 0; i < matched; i++) {
+        outputPatient(i + 1, patientAt(slots[i]));
+    }
+    outputText("%d patient(s) matched.\n", matched);
+    outputEnd();
+    free(slots);
+    return STATUS_OK;
+}
+
+// Function to parse one limit of a patient query
+int parseQueryLimit(const char *text, int unlimited, int *value) {
+    *value = unlimited;
+    return strcmp(text, "*") == 0 || batchNumber(text, value);
+}
+
+// Function to query the patients with limits chosen by the user
+
+/*
+ * Function to query the patients by age, room and doctor.
+ * This function prompts for a range of ages, a range of rooms and a doctor, each of which may be left
+ * open with '*', then lists the matching patients through listQueryPatients.
+ */
+
+void queryPatients() {
+    char texts[5][100];
+    const char *prompts[] = {"the lowest age", "the highest age", "the first room", "the last room",
+                             "the doctor's name or ID"};
+    for (int i = 0; i < 5; i++) {
+        printf("Enter %s (* for any): ", prompts[i]);
+        scanf("%99s", texts[i]);
+    }
+
+    PatientQuery query;
+    if (!parseQueryLimit(texts[0], INT_MIN, &query.minAge) || !parseQueryLimit(texts[1], INT_MAX, &query.maxAge) ||
+        !parseQueryLimit(texts[2], INT_MIN, &query.minRoom) || !parseQueryLimit(texts[3], INT_MAX, &query.maxRoom)) {
+        printf("Invalid limit. Enter a number or *.\n");
+        return;
+    }
+    query.doctorID = -1;
+    if (strcmp(texts[4], "*") != 0 && (query.doctorID = batchDoctor(texts[4])) == -1) {
+        printf("Doctor not found.\n");
+        return;
+    }
+    if (listQueryPatients(&query) != STATUS_OK) {
+        printf("Not enough memory to query the patients.\n");
+    }
+}
+
+// Functions that make changes to the data
+
+/*
+ * Functions that make changes to the data.
+ * These functions hold the logic shared by the interactive menu and journal replay:
+ * they validate their arguments, update the tables and indexes, and log the change
+ * to the journal. They never prompt or print; the result is reported as a Status.
+ * - insertDoctor / insertPatient / insertStaff: Add a record (names must be unique).
+ * - insertShift: Add a shift to the staff member at 'staffIndex'.
+ * - insertMedication: Add a medication to the patient with ID 'patientID', interning its name and dosage
+ *   in the medication catalog.
+ * - deletePatient: Remove the patient with ID 'patientID' in O(1) time, leaving a tombstone in its slot,
+ *   and cancel the patient's appointments (see cancelPatientAppointments), freeing their slots.
+ * - insertAppointment: Add an appointment in a free slot of the doctor's calendar. Appointments go straight
+ *   into the appointment store, which is itself an append-only file (rows are only cancelled in place),
+ *   so they are not journaled. Replaying a removal from the journal cancels the appointments again.
+ * The functions that add or remove patients, staff and shifts also update the report aggregates, and
+ * insertPatient, insertMedication and insertAppointment post their charges to the billing ledger.
+ */
+
+int insertDoctor(const char *name, int age, const char *specialty, int visitingFees) {
+    if (name[0] == '\0' || age < 0 || visitingFees < 0) {
+        return STATUS_INVALID;
+    }
+    if (nameIndexFind(&doctorNameIndex, name) != -1) {
+        return STATUS_DUPLICATE;
+    }
+
+    Doctor *doctor = tableSlot(&doctorTable, doctorCount);
+    if (doctor == NULL) {
+        return STATUS_NO_MEMORY;
+    }
+    memset(doctor, 0, sizeof(Doctor));
+    if (!copyText(doctor->name, sizeof(doctor->name), name) ||
+        !copyText(doctor->specialty, sizeof(doctor->specialty), specialty)) {
+        return STATUS_INVALID;
+    }
+    doctor->age = age;
+    doctor->visitingFees = visitingFees;
+
+    if (nameIndexInsert(&doctorNameIndex, doctorCount) < 0) {
+        return STATUS_NO_MEMORY;
+    }
+    doctorCount++;
+    textIndexAdd(&textIndexes[SEARCH_SPECIALTY], doctorCount - 1);
+
+    JournalRecord record;
+    journalRecordBegin(&record, JOURNAL_ADD_DOCTOR);
+    recordPutString(&record, name);
+    recordPutInt(&record, age);
+    recordPutString(&record, specialty);
+    recordPutInt(&record, visitingFees);
+    journalLog(&record);
+    return STATUS_OK;
+}
+
+int insertPatient(const char *name, int age, const char *diagnosis, int roomNumber, int doctorID, int admissionDate) {
+    if (name[0] == '\0' || age < 0 || roomNumber < 0 || roomNumber >= ROOM_NUMBER_LIMIT) {
+        return STATUS_INVALID;
+    }
+    if (doctorID < 0 || doctorID >= doctorCount) {
+        return STATUS_NOT_FOUND;
+    }
+    if (nameIndexFind(&patientNameIndex, name) != -1) {
+        return STATUS_DUPLICATE;
+    }
+    if (!roomInventoryReady()) {
+        return STATUS_NO_MEMORY;
+    }
+    if (!roomHasFreeBed(roomNumber) && !journal.replaying) {
+        return STATUS_OCCUPIED;  // Changes in the journal were accepted when they were made
+    }
+
+    // Reuse the slot of a removed patient if there is one
+    if (!patientIDMapReady()) {
+        return STATUS_NO_MEMORY;
+    }
+    int slot = patientIDs.freeCount > 0 ? patientIDs.freeSlots[patientIDs.freeCount - 1] : patientSlotCount;
+    Patient *patient = tableSlot(&patientTable, slot);
+    if (patient == NULL) {
+        return STATUS_NO_MEMORY;
+    }
+    memset(patient, 0, sizeof(Patient));  // The slot may still hold a removed patient
+    patient->id = -1;
+    patient->firstMedication = patient->lastMedication = -1;
+    if (!copyText(patient->name, sizeof(patient->name), name) ||
+        !copyText(patient->diagnosis, sizeof(patient->diagnosis), diagnosis)) {
+        patient->name[0] = '\0';
+        return STATUS_INVALID;
+    }
+    patient->age = age;
+    patient->roomNumber = roomNumber;
+    patient->doctorID = doctorID;
+    patient->admissionDate = admissionDate;
+
+    if (!patientIDMapSet(patientIDs.nextID, slot) || nameIndexInsert(&patientNameIndex, slot) < 0) {
+        patient->name[0] = '\0';
+        return STATUS_NO_MEMORY;
+    }
+    patient->id = patientIDs.nextID++;
+    if (slot == patientSlotCount) {
+        patientSlotCount++;
+    } else {
+        patientIDs.freeCount--;
+    }
+    patientCount++;
+    patientColumnsSet(slot, patient);
+    roomInventoryAdd(roomNumber, 1);
+    textIndexAdd(&textIndexes[SEARCH_PATIENT_NAME], patient->id);
+    textIndexAdd(&textIndexes[SEARCH_DIAGNOSIS], patient->id);
+    aggregatePatient(patient, 1);
+    billingPost(patient->id, CHARGE_DOCTOR, doctorAt(doctorID)->visitingFees);
+
+    JournalRecord record;
+    journalRecordBegin(&record, JOURNAL_ADD_PATIENT);
+    recordPutString(&record, name);
+    recordPutInt(&record, age);
+    recordPutString(&record, diagnosis);
+    recordPutInt(&record, roomNumber);
+    recordPutInt(&record, doctorID);
+    recordPutInt(&record, admissionDate);
+    journalLog(&record);
+    return STATUS_OK;
+}
+
+int insertStaff(const char *name, const char *role, const char *contactInfo) {
+    if (name[0] == '\0') {
+        return STATUS_INVALID;
+    }
+    if (nameIndexFind(&staffNameIndex, name) != -1) {
+        return STATUS_DUPLICATE;
+    }
+
+    Staff *member = tableSlot(&staffTable, staffCount);
+    if (member == NULL) {
+        return STATUS_NO_MEMORY;
+    }
+    memset(member, 0, sizeof(Staff));
+    if (!copyText(member->name, sizeof(member->name), name) ||
+        !copyText(member->role, sizeof(member->role), role) ||
+        !copyText(member->contactInfo, sizeof(member->contactInfo), contactInfo)) {
+        return STATUS_INVALID;
+    }
+    member->firstShift = member->lastShift = -1;  // Start with an empty shift list
+    member->shiftCount = 0;
+
+    if (nameIndexInsert(&staffNameIndex, staffCount) < 0) {
+        return STATUS_NO_MEMORY;
+    }
+    staffCount++;
+    aggregateStaff(member);
+
+    JournalRecord record;
+    journalRecordBegin(&record, JOURNAL_ADD_STAFF);
+    recordPutString(&record, name);
+    recordPutString(&record, role);
+    recordPutString(&record, contactInfo);
+    journalLog(&record);
+    return STATUS_OK;
+}
+
+int insertShift(int staffIndex, int day, int startTime, int endTime, const char *role) {
+    if (staffIndex < 0 || staffIndex >= staffCount) {
+        return STATUS_NOT_FOUND;
+    }
+    if (day < SUNDAY || day > SATURDAY || startTime < 0 || startTime >= 24 * 60 ||
+        endTime < 0 || endTime >= 24 * 60 || strlen(role) >= sizeof(((Role *)0)->name)) {
+        return STATUS_INVALID;
+    }
+
+    int roleID = internRole(role);
+    int shiftIndex = roleID == -1 ? -1 : appendShift(staffIndex, day, startTime, endTime, roleID);
+    if (shiftIndex == -1) {
+        return STATUS_NO_MEMORY;
+    }
+    aggregateShift(staffAt(staffIndex), shiftAt(shiftIndex));
+
+    JournalRecord record;
+    journalRecordBegin(&record, JOURNAL_ADD_SHIFT);
+    recordPutInt(&record, staffIndex);
+    recordPutInt(&record, day);
+    recordPutInt(&record, startTime);
+    recordPutInt(&record, endTime);
+    recordPutString(&record, role);
+    journalLog(&record);
+    return STATUS_OK;
+}
+
+int insertMedication(int patientID, const char *name, const char *dosage) {
+    Patient *patient = patientByID(patientID);
+    if (patient == NULL) {
+        return STATUS_NOT_FOUND;
+    }
+    if (name[0] == '\0' || strlen(name) >= sizeof(((Medication *)0)->name) ||
+        strlen(dosage) >= sizeof(((Dosage *)0)->text)) {
+        return STATUS_INVALID;
+    }
+    int medicationID = internMedication(name);
+    int dosageID = medicationID == -1 ? -1 : internDosage(dosage);
+    if (dosageID == -1) {
+        return STATUS_INVALID;  // The normalized dosage is too long, or memory ran out
+    }
+    if (appendPrescription(patient, medicationID, dosageID) == -1) {
+        return STATUS_NO_MEMORY;
+    }
+    medicationIndexAdd(medicationID, patientID);
+    billingPost(patientID, CHARGE_MEDICATION, medicationCost(name));
+
+    JournalRecord record;
+    journalRecordBegin(&record, JOURNAL_ADD_MEDICATION);
+    recordPutInt(&record, patientID);
+    recordPutString(&record, name);
+    recordPutString(&record, dosage);
+    journalLog(&record);
+    return STATUS_OK;
+}
+
+int insertAppointment(int patientID, int doctorID, int date, int slot) {
+    if (patientByID(patientID) == NULL || doctorID < 0 || doctorID >= doctorCount) {
+        return STATUS_NOT_FOUND;
+    }
+    if (date == INVALID_DATE || slot < 0 || slot >= CALENDAR_SLOTS) {
+        return STATUS_INVALID;
+    }
+
+    // Reserve the slot on the doctor's calendar, refusing slots that are already booked
+    if (doctorCalendar.stale && !calendarRebuild()) {
+        return STATUS_NO_MEMORY;
+    }
+    CalendarDay *day = calendarFind(doctorID, date, 1);
+    if (day == NULL) {
+        return STATUS_NO_MEMORY;
+    }
+    if (day->slots & (1u << slot)) {
+        return STATUS_DUPLICATE;
+    }
+    if (!appointmentStoreAppend(patientID, doctorID, date, slot)) {
+        return STATUS_IO_ERROR;
+    }
+    day->slots |= 1u << slot;
+    appointmentIndexAdd(&doctorAppointmentIndex, doctorID, date, appointmentCount - 1);
+    appointmentIndexAdd(&patientAppointmentIndex, patientID, date, appointmentCount - 1);
+    billingPost(patientID, CHARGE_APPOINTMENT, billingRates.appointmentFee);
+    return STATUS_OK;
+}
+
+int deletePatient(int patientID) {
+    int slot = patientSlot(patientID);
+    if (slot < 0) {
+        return STATUS_NOT_FOUND;
+    }
+
+    // Leave a tombstone in the slot and put it on the free list; no other patient moves
+    Patient *patient = patientAt(slot);
+    aggregatePatient(patient, -1);
+    nameIndexRemove(&patientNameIndex, patient->name);
+    patient->id = -1;
+    patient->name[0] = '\0';
+    unlinkedPrescriptions += patient->medicationCount;  // Dropped by compactPrescriptions before the next save
+    patient->firstMedication = patient->lastMedication = -1;
+    patient->medicationCount = 0;
+    patientIDs.slots[patientID] = -1;
+    patientColumnsSet(slot, patient);
+    roomInventoryAdd(patient->roomNumber, -1);
+    cancelPatientAppointments(patientID);
+    textIndexRemove(&textIndexes[SEARCH_PATIENT_NAME]);
+    textIndexRemove(&textIndexes[SEARCH_DIAGNOSIS]);
+    if (!pushFreePatientSlot(slot)) {
+        patientIDs.stale = 1;  // The tombstone is found again when the map is rebuilt
+    }
+    patientCount--;
+
+    JournalRecord record;
+    journalRecordBegin(&record, JOURNAL_REMOVE_PATIENT);
+    recordPutInt(&record, patientID);
+    journalLog(&record);
+    return STATUS_OK;
+}
+
+// Function to add a new doctor
+
+/**
+ * @brief Adds a new doctor to the system.
+ * 
+ * Prompts the user to enter details for a new doctor, including their name, age, 
+ * specialty, and visiting fee. The doctor is then added by insertDoctor, which 
+ * stores it in the `doctorTable` and records the change in the journal.
+ * 
+ * - Name acts as a unique identifier; a name that is already in use is rejected.
+ * - Reports an error if memory for the new doctor cannot be allocated.
+ */
+
+void addDoctor() {
+    char name[100], specialty[100];
+
+    printf("Enter doctor's name (this will be used as the ID): ");
+    scanf("%99s", name);  // Doctor's name is used as ID
+    if (nameIndexFind(&doctorNameIndex, name) != -1) {
+        printf("A doctor named %s already exists.\n", name);
+        return;
+    }
+    printf("Enter doctor's age: ");
+    int age = readInteger();
+    printf("Enter doctor's specialty: ");
+    scanf("%99s", specialty);
+    printf("Enter doctor's visiting fee: ");
+    int visitingFees = readInteger();
+
+    switch (insertDoctor(name, age, specialty, visitingFees)) {
+        case STATUS_OK:
+            printf("Doctor added successfully!\n");
+            break;
+        case STATUS_DUPLICATE:
+            printf("A doctor named %s already exists.\n", name);
+            break;
+        case STATUS_INVALID:
+            printf("The age and visiting fee must not be negative.\n");
+            break;
+        default:
+            printf("Not enough memory to add another doctor.\n");
+            break;
+    }
+}
+
+// Function to add a new patient
+
+/**
+ * @brief Adds a new patient to the system.
+ * 
+ * This function collects details about the patient, such as name, age, 
+ * diagnosis, and room number. It also links the patient to a specific doctor 
+ * by matching the doctor’s name. The patient is then added by insertPatient, 
+ * which stores it in the `patientTable` and records the change in the journal.
+ * 
+ * - Links the patient to a doctor using the doctor's name as an identifier.
+ * - Checks if the entered doctor exists in the system using the doctor name index.
+ * - Rejects a patient whose name is already in use.
+ */
+
+void addPatient() {
+    char name[100], diagnosis[100], doctorName[100];
+
+    printf("Enter patient's name: ");
+    scanf("%99s", name);
+    if (nameIndexFind(&patientNameIndex, name) != -1) {
+        printf("A patient named %s already exists.\n", name);
+        return;
+    }
+    printf("Enter patient's age: ");
+    int age = readInteger();
+    printf("Enter patient's diagnosis: ");
+    scanf("%99s", diagnosis);
+    printf("Enter patient's room number: ");
+    int roomNumber = readInteger();
+
+    // Ask for the doctor's name and assign the doctor ID based on the name
+    printf("Enter the doctor's name (used as doctor ID): ");
+    scanf("%99s", doctorName);
+
+    // Find the doctor with the matching name and assign to the patient
+    int doctorID = nameIndexFind(&doctorNameIndex, doctorName);
+    if (doctorID == -1) {
+        printf("Doctor not found.\n");
+        return;
+    }
+
+    int status = insertPatient(name, age, diagnosis, roomNumber, doctorID, currentDate());
+    if (status == STATUS_OCCUPIED) {
+        int freeRoom = findFreeRoomOfClass(roomClassOf(roomNumber)->name);
+        printf("Every bed in room %d is taken.", roomNumber);
+        if (freeRoom >= 0) {
+            printf(" Room %d of the same class has a free bed.", freeRoom);
+        } else if (freeRoom == -3) {
+            printf(" There was not enough memory to look for a free room.");
+        }
+        printf("\n");
+        return;
+    }
+    switch (status) {
+        case STATUS_OK:
+            printf("Patient added successfully!\n");
+            break;
+        case STATUS_DUPLICATE:
+            printf("A patient named %s already exists.\n", name);
+            break;
+        case STATUS_INVALID:
+            printf("The age must not be negative and the room number must be below %d.\n", ROOM_NUMBER_LIMIT);
+            break;
+        case STATUS_NOT_FOUND:
+            printf("Doctor not found.\n");
+            break;
+        default:
+            printf("Not enough memory to add another patient.\n");
+            break;
+    }
+}
+
+// Function to sort a list of record indexes
+
+/**
+ * @brief Builds a sorted permutation of the record indexes 0 to count - 1.
+ * 
+ * Uses a bottom-up merge sort, which takes O(n log n) comparisons and is stable, 
+ * so records that compare equal on every key keep their table order. Only the 
+ * array of indexes is rearranged: the records themselves never move, so doctor 
+ * and patient IDs stored elsewhere stay valid while a sorted list is in use.
+ * 
+ * @param compare Function comparing the records at two indexes using the given keys.
+ * @param keys Sort keys in priority order; later keys break ties between earlier ones.
+ * @return A newly allocated array of 'count' indexes (free it with free), or NULL if memory ran out.
+ */
+
+int *sortRecordOrder(int count, RecordCompare compare, const int *keys, int keyCount) {
+    int *order = malloc((count > 0 ? count : 1) * sizeof(int));
+    int *buffer = malloc((count > 0 ? count : 1) * sizeof(int));
+    if (order == NULL || buffer == NULL) {
+        free(order);
+        free(buffer);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        order[i] = i;
+    }
+
+    // Merge runs of 'width' indexes into runs of twice the width until one run is left
+    for (int width = 1; width < count; width *= 2) {
+        for (int left = 0; left < count; left += 2 * width) {
+            int middle = left + width < count ? left + width : count;
+            int right = left + 2 * width < count ? left + 2 * width : count;
+            int i = left, j = middle, k = left;
+
+            while (i < middle && j < right) {
+                // Take from the left run on ties to keep the sort stable
+                if (compare(order[j], order[i], keys, keyCount) < 0) {
+                    buffer[k++] = order[j++];
+                } else {
+                    buffer[k++] = order[i++];
+                }
+            }
+            while (i < middle) {
+                buffer[k++] = order[i++];
+            }
+            while (j < right) {
+                buffer[k++] = order[j++];
+            }
+        }
+
+        int *swap = order;
+        order = buffer;
+        buffer = swap;
+    }
+
+    free(buffer);
+    return order;
+}
+
+// Functions to compare two doctors or two patients
+
+/**
+ * @brief Compare the records at two indexes using a list of sort keys.
+ * 
+ * Keys are checked in order and the first key on which the records differ 
+ * decides the result. Text fields are compared alphabetically, numbers in 
+ * ascending order.
+ * 
+ * @return A negative number, zero, or a positive number if the first record sorts before, 
+ * together with, or after the second one.
+ */
+
+int compareDoctors(int first, int second, const int *keys, int keyCount) {
+    Doctor *a = doctorAt(first);
+    Doctor *b = doctorAt(second);
+
+    for (int k = 0; k < keyCount; k++) {
+        int result = 0;
+        switch (keys[k]) {
+            case DOCTOR_KEY_NAME:
+                result = strcmp(a->name, b->name);
+                break;
+            case DOCTOR_KEY_AGE:
+                result = (a->age > b->age) - (a->age < b->age);
+                break;
+            case DOCTOR_KEY_SPECIALTY:
+                result = strcmp(a->specialty, b->specialty);
+                break;
+            case DOCTOR_KEY_FEE:
+                result = (a->visitingFees > b->visitingFees) - (a->visitingFees < b->visitingFees);
+                break;
+        }
+        if (result != 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+int comparePatients(int first, int second, const int *keys, int keyCount) {
+    Patient *a = patientAt(first);
+    Patient *b = patientAt(second);
+
+    for (int k = 0; k < keyCount; k++) {
+        int result = 0;
+        switch (keys[k]) {
+            case PATIENT_KEY_NAME:
+                result = strcmp(a->name, b->name);
+                break;
+            case PATIENT_KEY_AGE:
+                result = (a->age > b->age) - (a->age < b->age);
+                break;
+            case PATIENT_KEY_DIAGNOSIS:
+                result = strcmp(a->diagnosis, b->diagnosis);
+                break;
+            case PATIENT_KEY_ROOM:
+                result = (a->roomNumber > b->roomNumber) - (a->roomNumber < b->roomNumber);
+                break;
+            case PATIENT_KEY_DOCTOR:
+                result = strcmp(patientDoctor(a) != NULL ? patientDoctor(a)->name : "",
+                                patientDoctor(b) != NULL ? patientDoctor(b)->name : "");
+                break;
+        }
+        if (result != 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+// Function to read a list of sort keys from the user
+
+/**
+ * @brief Prompts the user for up to MAX_SORT_KEYS sort keys in priority order.
+ * 
+ * Lists the available keys (numbered from 1) and reads key numbers until the 
+ * user enters 0 or the maximum number of keys is reached. Out-of-range 
+ * numbers are ignored.
+ * 
+ * @param keyNames Names of the available keys, indexed by key value.
+ * @param keys Array receiving the chosen key values.
+ * @return The number of keys chosen.
+ */
+
+int readSortKeys(const char *const *keyNames, int keyNameCount, int *keys) {
+    printf("Sort keys:\n");
+    for (int i = 0; i < keyNameCount; i++) {
+        printf("  %d. %s\n", i + 1, keyNames[i]);
+    }
+    printf("Enter up to %d keys in priority order, then 0 to finish: ", MAX_SORT_KEYS);
+
+    int keyCount = 0;
+    while (keyCount < MAX_SORT_KEYS) {
+        int key = readInteger();
+        if (key == 0) {
+            break;
+        }
+        if (key <= keyNameCount) {
+            keys[keyCount++] = key - 1;
+        }
+    }
+    return keyCount;
+}
+
+// Function to write a doctor as a record of a listing
+
+/**
+ * @brief Writes one doctor record, numbered 'number' in its listing, through the output layer.
+ */
+
+void outputDoctor(int number, int doctorID) {
+    if (!outputRecordBegin()) {
+        outputRecordEnd();
+        return;  // Outside the selected records
+    }
+    Doctor *doctor = doctorAt(doctorID);
+    outputText("Doctor #%d (ID %d)\n", number, doctorID);
+    outputInt("id", NULL, doctorID);
+    outputField("name", "Name", doctor->name);
+    outputInt("age", "Age", doctor->age);
+    outputField("specialty", "Specialty", doctor->specialty);
+    outputInt("visitingFee", "Visiting Fee", doctor->visitingFees);
+    outputRecordEnd();
+}
+
+// Function to write a patient as a record of a listing
+
+/**
+ * @brief Writes one patient record, numbered 'number' in its listing, through the output layer.
+ * 
+ * The record includes the assigned doctor and the list of medications.
+ */
+
+void outputPatient(int number, Patient *patient) {
+    if (!outputRecordBegin()) {
+        outputRecordEnd();
+        return;  // Outside the selected records
+    }
+    outputText("Patient #%d (ID %d)\n", number, patient->id);
+    outputInt("id", NULL, patient->id);
+    outputField("name", "Name", patient->name);
+    outputInt("age", "Age", patient->age);
+    outputField("diagnosis", "Diagnosis", patient->diagnosis);
+    outputInt("roomNumber", "Room Number", patient->roomNumber);
+    Doctor *doctor = patientDoctor(patient);
+    outputField("doctor", "Assigned Doctor", doctor != NULL ? doctor->name : "none");
+
+    outputListBegin("medications", patient->medicationCount > 0 ? "Medications" : NULL);
+    for (int p = patient->firstMedication; p != -1; p = prescriptionAt(p)->next) {
+        Prescription *prescription = prescriptionAt(p);
+        outputListItem("%s, Dosage: %s", medicationAt(prescription->medicationID)->name,
+                       dosageAt(prescription->dosageID)->text);
+    }
+    outputListEnd();
+    if (patient->medicationCount == 0) {
+        outputText("No medications assigned.\n");
+    }
+    outputRecordEnd();
+}
+
+// Function to view doctors in a sorted order
+
+/**
+ * @brief Displays all doctors ordered by the given sort keys.
+ * 
+ * The order is computed as a permutation of doctor IDs, so the doctors 
+ * themselves are not moved. Each entry shows the doctor's ID, which stays 
+ * valid for scheduling appointments.
+ */
+
+void viewDoctorsSorted(const int *keys, int keyCount) {
+    if (doctorCount == 0) {
+        printf("No doctors available.\n");
+        return;
+    }
+
+    int *order = sortRecordOrder(doctorCount, compareDoctors, keys, keyCount);
+    if (order == NULL) {
+        printf("Not enough memory to sort doctors.\n");
+        return;
+    }
+
+    outputBegin();
+    outputText("\n----- Sorted Doctors List -----\n");
+    for (int i = 0; i < doctorCount; i++) {
+        outputDoctor(i + 1, order[i]);
+    }
+    outputEnd();
+    free(order);
+}
+
+// Function to view patients in a sorted order
+
+/**
+ * @brief Displays all patients ordered by the given sort keys.
+ * 
+ * Like viewDoctorsSorted, this sorts a permutation of patient slots and leaves 
+ * the patient records (and every ID that refers to them) untouched. Free slots 
+ * are sorted along but not shown.
+ */
+
+void viewPatientsSorted(const int *keys, int keyCount) {
+    if (patientCount == 0) {
+        printf("No patients available.\n");
+        return;
+    }
+
+    int *order = sortRecordOrder(patientSlotCount, comparePatients, keys, keyCount);
+    if (order == NULL) {
+        printf("Not enough memory to sort patients.\n");
+        return;
+    }
+
+    outputBegin();
+    outputText("\n----- Sorted Patients List -----\n");
+    for (int i = 0, number = 0; i < patientSlotCount; i++) {
+        Patient *patient = patientAt(order[i]);
+        if (patient->id < 0) {
+            continue;  // Skip the slots of removed patients
+        }
+        outputPatient(++number, patient);
+    }
+    outputEnd();
+    free(order);
+}
+
+// Function to sort doctors by name
+
+/**
+ * @brief Displays the list of doctors alphabetically by their names.
+ * 
+ * Sorts a permutation of doctor IDs rather than the `doctorTable` itself, 
+ * so the IDs that patients and appointments hold keep pointing at the right doctor.
+ */
+
+void sortDoctorsByName() {
+    int keys[] = {DOCTOR_KEY_NAME};
+    viewDoctorsSorted(keys, 1);
+}
+
+// Function to sort patients by age
+
+/**
+ * @brief Displays the list of patients in ascending order of their ages.
+ * 
+ * Patients of the same age are listed by name. Like sortDoctorsByName, 
+ * only a permutation of patient slots is sorted.
+ */
+
+void sortPatientsByAge() {
+    int keys[] = {PATIENT_KEY_AGE, PATIENT_KEY_NAME};
+    viewPatientsSorted(keys, 2);
+}
+
+// Function to save the current data of doctors, patients, and staff into respective files.
+
+/*
+ * Function to save the current data of doctors, patients, and staff into respective files.
+ * This function writes the data of all doctors, patients, and staff to their corresponding files in binary mode.
+ * Each file is a versioned data file (see writeDataFile) with one section per table; the staff file also
+ * holds the shared shift table and the role names used by the shifts, and the patient file holds the next
+ * patient ID. The patient table is compacted first, so removed patients take no space in the file.
+ * The data is written to temporary files which replace the old files only once they are complete.
+ * Saving is also the journal's checkpoint: once the files are replaced, the journal is emptied.
+ * Returns 1 if the data was saved; otherwise an error message is displayed and 0 is returned.
+ */
+
+int saveData() {
+    long long started = statsStart();
+    saveWait();  // A background save writes the same files
+
+    // Make sure everything in the journal is on disk before it is folded into the data files
+    journalCommit();
+    compactPatients();  // Saved files never contain free patient slots
+    compactPrescriptions();  // ... or the prescriptions of removed patients
+    saveState.started = statsNow();
+    if (writeSnapshot(journal.nextSequence) < 0) {
+        // Error handling if files can't be written; the journal still holds every change
+        printf("Error saving data.\n");
+        reportDamagedFiles();
+        statsRecord(STATS_SAVE_DATA, "io", "saveData", started);
+        return 0;
+    }
+
+    // Every journaled change is now in the data files, so the journal can start over
+    journalReset();
+    statsRecord(STATS_SAVE_DATA, "io", "saveData", started);
+    return 1;
+}
+
+// Function to write every table to the data files
+
+/**
+ * @brief Writes the doctor, patient and staff files from the tables as they are now.
+ * 
+ * The data is written to temporary files which replace the old files only once 
+ * they are all complete, so a failed save leaves the old files intact. Nothing 
+ * is written while a damaged file could not be moved aside (dataFilesReplaceable).
+ * 
+ * @param sequence Sequence number of the first journal record not included in the files.
+ * @return The number of bytes written, or -1 if a file could not be written.
+ */
+
+long long writeSnapshot(unsigned int sequence) {
+    // Describe the sections of each data file
+    SectionSource doctorSections[] = {{SECTION_DOCTORS, &doctorTable, doctorCount}};
+    RecordTable patientIDTable = {sizeof(int), NULL, 0, 0, (char *)&patientIDs.nextID, 1};
+    SectionSource patientSections[] = {
+        {SECTION_PATIENTS, &patientTable, patientSlotCount},
+        {SECTION_PATIENT_IDS, &patientIDTable, 1},
+        {SECTION_MEDICATIONS, &medicationTable, medicationCatalogCount},
+        {SECTION_DOSAGES, &dosageTable, dosageCount},
+        {SECTION_PRESCRIPTIONS, &prescriptionTable, prescriptionCount}
+    };
+    SectionSource staffSections[] = {
+        {SECTION_STAFF, &staffTable, staffCount},
+        {SECTION_SHIFTS, &shiftTable, shiftCount},
+        {SECTION_ROLES, &roleTable, roleCount}
+    };
+    if (!dataFilesReplaceable()) {
+        return -1;  // A damaged file is still in place; the journal keeps every change meanwhile
+    }
+
+    long long doctorBytes = writeDataFile("doctors.dat.tmp", doctorSections, 1, sequence);
+    long long patientBytes = doctorBytes > 0 ? writeDataFile("patients.dat.tmp", patientSections, 5, sequence) : 0;
+    long long staffBytes = patientBytes > 0 ? writeDataFile("staff.dat.tmp", staffSections, 3, sequence) : 0;
+    if (staffBytes == 0 || !replaceFile("doctors.dat.tmp", "doctors.dat") ||
+        !replaceFile("patients.dat.tmp", "patients.dat") || !replaceFile("staff.dat.tmp", "staff.dat")) {
+        return -1;
+    }
+    return doctorBytes + patientBytes + staffBytes;
+}
+
+// Function to save data in the background
+
+/**
+ * @brief Takes a snapshot of the data and writes it to the data files in a child process.
+ * 
+ * The program only waits for the compaction of the patient table and the fork; 
+ * the child's copy-on-write view of memory is the snapshot, and it is written while 
+ * the program carries on. saveIdle collects the result. Journal records that are not 
+ * committed yet need no commit first: they are written after the part of the journal 
+ * the save replaces, and replay skips them as older than the data files. Without fork 
+ * (on Windows) the data is saved at once with saveData.
+ * 
+ * @return 1 if the save was started (or done), 0 if it could not be, or if another is still running.
+ */
+
+int saveDataBackground() {
+#ifdef _WIN32
+    return saveData();
+#else
+    journalLock();
+    if (saveState.child != 0 || !dataFilesReplaceable()) {
+        journalUnlock();
+        return 0;
+    }
+    long long started = statsNow(), statsStarted = statsStart();
+    compactPatients();
+    compactPrescriptions();
+
+    int results[2];
+    pid_t child = -1;
+    unsigned int sequence = journal.nextSequence;
+    if (pipe(results) == 0) {
+        fflush(stdout);
+        child = fork();
+        if (child == 0) {
+            // The child: write the snapshot, report, and leave without running the program's exit handlers
+            close(results[0]);
+            long long report[2];
+            report[1] = writeSnapshot(sequence);
+            report[0] = statsNow() - started;
+            _exit(write(results[1], report, sizeof(report)) == sizeof(report) && report[1] >= 0 ? 0 : 1);
+        }
+        close(results[1]);
+        if (child < 0) {
+            close(results[0]);
+        }
+    }
+    if (child < 0) {
+        journalUnlock();
+        return saveData();
+    }
+
+    saveState.child = (int)child;
+    saveState.results = results[0];
+    saveState.journalBytes = journal.fileBytes;
+    saveState.started = started;
+    saveState.pauseNs = statsNow() - started;
+    journalUnlock();
+    statsRecord(STATS_SAVE_SNAPSHOT, "io", "saveSnapshot", statsStarted);
+    return 1;
+#endif
+}
+
+// Function to collect the results of a finished background save
+
+/**
+ * @brief Records the duration and size of a background save whose child has exited with 
+ * 'status', and drops the saved records from the journal if it succeeded. 
+ * With 'report' set, a line about the save is printed.
+ */
+
+void saveFinish(int status, int report) {
+#ifdef _WIN32
+    (void)status, (void)report;
+#else
+    long long results[2] = {0, -1};
+    if (read(saveState.results, results, sizeof(results)) != sizeof(results) ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        results[1] = -1;
+    }
+    close(saveState.results);
+    saveState.child = 0;
+
+    if (results[1] < 0) {
+        saveState.failures++;
+        printf("Error saving data in the background; the journal still holds every change.\n");
+        return;
+    }
+    journalTrim(saveState.journalBytes);
+    saveState.saves++;
+    saveState.lastDurationNs = results[0];
+    saveState.lastPauseNs = saveState.pauseNs;
+    saveState.lastBytes = results[1];
+    if (report) {
+        printf("Data saved successfully in the background (%lld bytes in %.1f ms, of which the program waited %.1f ms).\n",
+               results[1], results[0] / 1e6, saveState.pauseNs / 1e6);
+    }
+#endif
+}
+
+// Function to wait for a background save to finish
+void saveWait() {
+#ifndef _WIN32
+    int status;
+    journalLock();
+    if (saveState.child != 0 && waitpid(saveState.child, &status, 0) == saveState.child) {
+        saveFinish(status, 0);
+    }
+    journalUnlock();
+#endif
+}
+
+// Function to do the housekeeping of saves while the program is idle
+
+/**
+ * @brief Collects a background save that has finished, then starts an automatic one 
+ * if the autosave interval has passed since the last save and the journal holds 
+ * changes that are not in the data files yet (or there is no journal to tell).
+ */
+
+void saveIdle() {
+    saveCollect();
+    int unsaved = !journal.enabled || journal.fileBytes + (long)journal.pendingBytes > 0;
+    if (saveState.autosaveSeconds > 0 && saveState.child == 0 && unsaved &&
+        statsNow() - saveState.started >= saveState.autosaveSeconds * 1000000000LL) {
+        saveDataBackground();
+        saveState.started = statsNow();  // Even if it failed, wait a whole interval before trying again
+    }
+}
+
+// Function to collect a background save that has finished
+void saveCollect() {
+#ifndef _WIN32
+    int status;
+    journalLock();
+    if (saveState.child != 0 && waitpid(saveState.child, &status, WNOHANG) == saveState.child) {
+        saveFinish(status, 1);
+    }
+    journalUnlock();
+#endif
+}
+
+// Function to check whether a save should start
+
+/**
+ * @brief Returns 1 when no save is running and either the journal has grown past 
+ * JOURNAL_CHECKPOINT_BYTES or the autosave interval has passed with changes in the 
+ * journal (or no journal to tell). Only reads what the journal's lock guards, so the server can check 
+ * without the data lock.
+ */
+
+int saveDue() {
+    if (saveState.child != 0) {
+        return 0;
+    }
+    int unsaved = !journal.enabled || journal.fileBytes > 0;
+    return (journal.enabled && journal.fileBytes > JOURNAL_CHECKPOINT_BYTES) ||
+           (saveState.autosaveSeconds > 0 && unsaved &&
+            statsNow() - saveState.started >= saveState.autosaveSeconds * 1000000000LL);
+}
+
+// Function to read the autosave interval
+
+/**
+ * @brief Reads the time between automatic saves, in seconds, from HOSPITAL_AUTOSAVE 
+ * ("0" turns them off), and arranges for a running save to be waited for at exit.
+ */
+
+void saveInit() {
+    const char *setting = getenv("HOSPITAL_AUTOSAVE");
+    saveState.autosaveSeconds = setting != NULL ? atoi(setting) : AUTOSAVE_DEFAULT_SECONDS;
+    saveState.started = statsNow();
+    atexit(saveWait);
+}
+
+// Function to replace a file with a newly written one
+
+/*
+ * Function to replace a file with a newly written one.
+ * Renames 'source' to 'destination', removing the old destination first where rename cannot overwrite it.
+ * Returns 1 on success and 0 otherwise.
+ */
+
+int replaceFile(const char *source, const char *destination) {
+#ifdef _WIN32
+    remove(destination);
+#endif
+    return rename(source, destination) == 0;
+}
+
+// Function to move a damaged file aside
+
+/*
+ * Function to move a damaged file aside.
+ * Renames 'path' to "PATH.corrupt" (or "PATH.corrupt.N" if that is taken, so an earlier damaged copy
+ * is kept), so that the next save writes a new file instead of replacing the damaged one.
+ * Prints where the file went and returns 1 on success; returns 0 if it could not be moved.
+ */
+
+int moveDamagedFile(const char *path) {
+    char destination[FILENAME_MAX];
+    for (int i = 0; i < 100; i++) {
+        if (i == 0) {
+            snprintf(destination, sizeof(destination), "%s.corrupt", path);
+        } else {
+            snprintf(destination, sizeof(destination), "%s.corrupt.%d", path, i);
+        }
+        FILE *exists = fopen(destination, "rb");
+        if (exists != NULL) {
+            fclose(exists);
+            continue;
+        }
+        if (rename(path, destination) != 0) {
+            return 0;
+        }
+        printf("%s is damaged and was moved to %s.\n", path, destination);
+        return 1;
+    }
+    return 0;
+}
+
+// Function to check that saving may replace every data file
+int dataFilesReplaceable() {
+    for (int i = 0; i < DATA_FILE_COUNT; i++) {
+        if (dataFileDamaged[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Function to tell why saving is refused
+void reportDamagedFiles() {
+    for (int i = 0; i < DATA_FILE_COUNT; i++) {
+        if (dataFileDamaged[i]) {
+            printf("Saving is refused: %s is damaged and could not be moved aside. "
+                   "Move it away and restart the program to save again.\n", dataFileNames[i]);
+        }
+    }
+}
+
+#ifndef _WIN32
+// Function run by each of loadData's threads
+void *dataLoadThread(void *argument) {
+    DataLoadTask *task = argument;
+    task->status = task->load();
+    return NULL;
+}
+#endif
+
+// Function to check the references between the loaded files
+
+/*
+ * Function to check the references between the loaded files.
+ * Each file loads on its own, so when doctors.dat is missing or damaged the patients may still refer to
+ * doctors that no longer exist (and that new doctors would otherwise take the IDs of). Those patients are
+ * left with no doctor (-1), which every user of a patient's doctor tolerates (patientDoctor).
+ * Likewise, when patients.dat is missing or damaged the appointment store may still hold appointments
+ * of the lost patients, so new patient IDs start above every ID in the store and no new patient takes
+ * over an old patient's appointments. The checks only run for a file that did not load, so a normal
+ * start still reads no records.
+ */
+
+void loadCheckReferences(int doctorsLoaded, int patientsLoaded) {
+    int orphans = 0;
+    for (int i = 0; !doctorsLoaded && i < patientSlotCount; i++) {
+        Patient *patient = patientAt(i);
+        if (patient->id >= 0 && patient->doctorID >= doctorCount) {
+            patient->doctorID = -1;
+            orphans++;
+        }
+    }
+    if (orphans > 0) {
+        printf("%d patient(s) refer to doctors that were not loaded; they now have no doctor.\n", orphans);
+    }
+
+    int nextID = patientIDs.nextID;
+    for (int i = 0; !patientsLoaded && i < appointmentCount; i++) {
+        int patientID = appointmentAt(i).patientID;
+        if (patientID >= nextID) {
+            nextID = patientID + 1;
+        }
+    }
+    if (nextID > patientIDs.nextID) {
+        printf("Appointments of patients that were not loaded are kept; new patient IDs start at %d.\n", nextID);
+        patientIDs.nextID = nextID;
+    }
+}
+
+// Function to load previously saved data for doctors, patients, and staff from files.
+
+/*
+ * Function to load previously saved data for doctors, patients, and staff from files.
+ * This function maps the corresponding files into memory and checks their headers; records are only read
+ * from disk when they are first used, so startup time does not grow with the number of records.
+ * Sections written packed are decoded instead, so each file (and the appointment store) is loaded on a
+ * thread of its own and startup takes as long as the largest file rather than all of them together.
+ * Each file loads on its own: a missing or damaged file leaves its tables empty without affecting the others.
+ * A damaged file is renamed to "NAME.corrupt" so the next save cannot overwrite it; if that fails, the
+ * file is left in place and saving is refused until it is dealt with.
+ * The name indexes are rebuilt on their first lookup. It then replays the journal, restoring changes made
+ * since the files were last saved. Files written by earlier versions are converted to the current format.
+ * If the files don't exist or can't be opened, a message is displayed indicating no saved data.
+ */
+
+void loadData() {
+    long long started = statsStart();
+    loadBillingRates();
+
+    // The loaders touch only their own tables, so they can run at the same time
+    DataLoadTask tasks[] = {
+        [DATA_DOCTORS] = {"doctors.dat", "doctors", loadDoctorsFile, DATA_FILE_MISSING},
+        [DATA_PATIENTS] = {"patients.dat", "patients", loadPatientsFile, DATA_FILE_MISSING},
+        [DATA_STAFF] = {"staff.dat", "staff", loadStaffFile, DATA_FILE_MISSING},
+        [DATA_FILE_COUNT] = {APPOINTMENT_STORE_FILE, "appointments", loadAppointmentsFile, DATA_FILE_MISSING}
+    };
+    int taskCount = (int)(sizeof(tasks) / sizeof(tasks[0]));
+#ifdef _WIN32
+    for (int i = 0; i < taskCount; i++) {
+        tasks[i].status = tasks[i].load();
+    }
+#else
+    pthread_t threads[sizeof(tasks) / sizeof(tasks[0])];
+    int startedThreads[sizeof(tasks) / sizeof(tasks[0])];
+    for (int i = 1; i < taskCount; i++) {
+        startedThreads[i] = pthread_create(&threads[i], NULL, dataLoadThread, &tasks[i]) == 0;
+    }
+    tasks[0].status = tasks[0].load();  // The calling thread loads the first file
+    for (int i = 1; i < taskCount; i++) {
+        if (startedThreads[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            tasks[i].status = tasks[i].load();  // No thread could be started for this file
+        }
+    }
+#endif
+
+    // Move damaged files aside, so that saving cannot replace them; one that stays in place is never replaced
+    for (int i = 0; i < taskCount; i++) {
+        if (tasks[i].status == DATA_FILE_CORRUPT && !moveDamagedFile(tasks[i].path)) {
+            printf("%s is damaged and could not be moved aside; it will not be written over until it is removed.\n",
+                   tasks[i].path);
+            if (i < DATA_FILE_COUNT) {
+                dataFileDamaged[i] = 1;
+            } else {
+                appointmentStore.damaged = 1;
+            }
+        }
+    }
+
+    loadCheckReferences(tasks[DATA_DOCTORS].status != DATA_FILE_MISSING && tasks[DATA_DOCTORS].status != DATA_FILE_CORRUPT,
+                        tasks[DATA_PATIENTS].status != DATA_FILE_MISSING && tasks[DATA_PATIENTS].status != DATA_FILE_CORRUPT);
+
+    // Report missing files; the tables of a missing file start empty
+    int converted = 0, missing = 0;
+    for (int i = 0; i < DATA_FILE_COUNT; i++) {
+        converted |= tasks[i].status == DATA_FILE_LEGACY;
+        missing += tasks[i].status == DATA_FILE_MISSING;
+    }
+    if (missing == DATA_FILE_COUNT) {
+        printf("No saved data found, starting fresh.\n");
+    } else {
+        for (int i = 0; i < DATA_FILE_COUNT; i++) {
+            if (tasks[i].status == DATA_FILE_MISSING) {
+                printf("%s not found, starting with no %s.\n", tasks[i].path, tasks[i].content);
+            }
+        }
+    }
+
+    // Continue the journal's sequence numbers after the newest data file
+    for (int i = 0; i < DATA_FILE_COUNT; i++) {
+        if (dataFileSequence[i] > journal.nextSequence) {
+            journal.nextSequence = dataFileSequence[i];
+        }
+    }
+
+    // Re-apply the changes made after the data files were last saved
+    journalReplay();
+
+    // Rewrite files from earlier versions in the current format, once
+    if (converted && saveData()) {
+        printf("Converted the data files to format version %d.\n", DATA_FILE_VERSION);
+    }
+    statsRecord(STATS_LOAD_DATA, "io", "loadData", started);
+}
+
+// Function to generate a detailed report of staff members and their schedules.
+
+/*
+ * Function to generate a detailed report of staff members and their schedules.
+ * This function iterates over all staff members and generates a report that includes:
+ * - Staff member's name, role, and contact information
+ * - The shifts assigned to each staff member
+ * - A summary of the total shifts assigned across all staff
+ * - A breakdown of shifts per day of the week and of shifts and staff members per role
+ * - The number of patients per doctor and the occupied rooms
+ * It also includes details of staff members who have no shifts assigned.
+ * The summary is read from the report aggregates, which are kept up to date as records are
+ * added and removed, so only the per-staff details scan the data.
+ */
+
+void generateReport() {
+    // If no staff members are available, print a message and return
+    if (staffCount == 0) {
+        printf("No staff members available to generate a report.\n");
+        return;
+    }
+    if (!aggregatesReady()) {
+        return;
+    }
+    ReportAggregates *aggregates = &reportAggregates;
+
+    // Print header for the staff report
+    printf("\n--- Staff Schedule Report ---\n");
+    printf("Total number of staff: %d\n", staffCount);
+
+    // Loop through all staff members to display their details
+    for (int i = 0; i < staffCount; i++) {
+        printf("\nStaff Member: %s\n", staffAt(i)->name);
+        printf("Role: %s\n", staffAt(i)->role);
+        printf("Contact Info: %s\n", staffAt(i)->contactInfo);
+
+        // If the staff member has no shifts, print a message
+        if (staffAt(i)->shiftCount == 0) {
+            printf("No shifts assigned.\n");
+        } else {
+            // Print each shift assigned to the staff member
+            printf("Assigned Shifts:\n");
+            printShifts(staffAt(i));
+        }
+    }
+
+    // Print summary of shifts and staff members with no shifts
+    printf("\n--- Report Summary ---\n");
+    printf("Total number of shifts assigned across all staff: %d\n", shiftCount);
+    printf("Staff members with no shifts: %d\n", aggregates->staffWithNoShifts);
+
+    // Print the number of shifts assigned per day (Sunday-Saturday)
+    printf("\n--- Shifts Summary by Day ---\n");
+    for (int i = 0; i < 7; i++) {
+        printf("%s: %d shifts\n", weekdayNames[i], aggregates->shiftsPerDay[i]);
+    }
+
+    // Print the roles that have staff members or shifts
+    printf("\n--- Summary by Role ---\n");
+    for (int i = 0; i < roleCount; i++) {
+        int staff = i < aggregates->staffPerRole.capacity ? aggregates->staffPerRole.counts[i] : 0;
+        int shifts = i < aggregates->shiftsPerRole.capacity ? aggregates->shiftsPerRole.counts[i] : 0;
+        if (staff > 0 || shifts > 0) {
+            printf("%s: %d staff, %d shifts\n", roleAt(i)->name, staff, shifts);
+        }
+    }
+
+    // Print the number of patients assigned to each doctor
+    printf("\n--- Patients by Doctor ---\n");
+    for (int i = 0; i < doctorCount; i++) {
+        int patients = i < aggregates->patientsPerDoctor.capacity ? aggregates->patientsPerDoctor.counts[i] : 0;
+        printf("%s: %d patients\n", doctorAt(i)->name, patients);
+    }
+    if (roomInventoryReady()) {
+        printf("%d patients in %d occupied rooms\n", patientCount, roomInventory.occupiedRooms);
+    }
+
+    // End of report
+    printf("\n--- End of Report ---\n");
+}
+
+// Functions of the billing engine
+
+/*
+ * Functions of the billing engine.
+ * A bill is made of the charges posted to the patient's account in the billing ledger (the doctor's
+ * fee, medications and appointments, priced from the rate tables when they happened) plus the stay,
+ * charged at the daily rate of the room's class for every day since admission.
+ * - loadBillingRates: Read the rate tables from RATES_FILE.
+ * - roomClassOf / medicationCost: Look up a rate in O(log n) time.
+ * - billingPost: Add a charge to a patient's account; does nothing while the ledger is stale.
+ * - billingLedgerReady: Build the ledger from the patients and the appointment store if it is stale.
+ * - billPatient: Itemize the bill of the patient in a slot without changing anything, so several
+ *   threads can bill patients at once once the ledger is ready.
+ */
+
+int compareRoomClasses(const void *first, const void *second) {
+    int a = ((const RoomClass *)first)->firstRoom, b = ((const RoomClass *)second)->firstRoom;
+    return (a > b) - (a < b);
+}
+
+int compareMedicationRates(const void *first, const void *second) {
+    return strcmp(((const MedicationRate *)first)->name, ((const MedicationRate *)second)->name);
+}
+
+// Function to read the billing rates
+
+/**
+ * @brief Reads the rate tables from RATES_FILE, if it exists.
+ *
+ * Each line of the file sets one rate, with arguments written as in batch files:
+ *
+ *   room FIRST LAST CLASS RATE [BEDS]   Rooms FIRST to LAST are of class CLASS, cost RATE per day
+ *                                       and have BEDS beds each (1 if left out)
+ *   room * * CLASS RATE [BEDS]          The same for the rooms outside every range
+ *   medication NAME COST         Assigning medication NAME costs COST ('*' for all others)
+ *   appointment FEE              Each appointment costs FEE
+ *
+ * Lines that cannot be read, and room ranges that overlap an earlier one, are skipped with a warning.
+ */
+
+void loadBillingRates() {
+    FILE *file = fopen(RATES_FILE, "r");
+    if (file == NULL) {
+        return;
+    }
+
+    char line[512];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *arguments[6];
+        int count = batchTokenize(line, arguments, 6);
+        if (count == 0) {
+            continue;
+        }
+
+        int valid = 0, first, last, rate, beds = 1;
+        if ((count == 5 || (count == 6 && batchNumber(arguments[5], &beds) && beds > 0)) &&
+            strcmp(arguments[0], "room") == 0 && batchNumber(arguments[4], &rate) &&
+            strlen(arguments[3]) < sizeof(billingRates.defaultRoomClass.name)) {
+            if (strcmp(arguments[1], "*") == 0 && strcmp(arguments[2], "*") == 0) {
+                strcpy(billingRates.defaultRoomClass.name, arguments[3]);
+                billingRates.defaultRoomClass.dailyRate = rate;
+                billingRates.defaultRoomClass.beds = beds;
+                valid = 1;
+            } else if (batchNumber(arguments[1], &first) && batchNumber(arguments[2], &last) && first <= last) {
+                RoomClass *classes = realloc(billingRates.roomClasses,
+                                             (billingRates.roomClassCount + 1) * sizeof(RoomClass));
+                if (classes != NULL) {
+                    billingRates.roomClasses = classes;
+                    RoomClass *roomClass = &classes[billingRates.roomClassCount++];
+                    roomClass->firstRoom = first;
+                    roomClass->lastRoom = last;
+                    strcpy(roomClass->name, arguments[3]);
+                    roomClass->dailyRate = rate;
+                    roomClass->beds = beds;
+                    valid = 1;
+                }
+            }
+        } else if (count == 3 && strcmp(arguments[0], "medication") == 0 && batchNumber(arguments[2], &rate)) {
+            if (strcmp(arguments[1], "*") == 0) {
+                billingRates.defaultMedicationCost = rate;
+                valid = 1;
+            } else if (strlen(arguments[1]) < sizeof(billingRates.medicationRates->name)) {
+                MedicationRate *rates = realloc(billingRates.medicationRates,
+                                                (billingRates.medicationRateCount + 1) * sizeof(MedicationRate));
+                if (rates != NULL) {
+                    billingRates.medicationRates = rates;
+                    strcpy(rates[billingRates.medicationRateCount].name, arguments[1]);
+                    rates[billingRates.medicationRateCount++].cost = rate;
+                    valid = 1;
+                }
+            }
+        } else if (count == 2 && strcmp(arguments[0], "appointment") == 0 && batchNumber(arguments[1], &rate)) {
+            billingRates.appointmentFee = rate;
+            valid = 1;
+        }
+        if (!valid) {
+            printf("Warning: line %d of %s is not a valid rate.\n", lineNumber, RATES_FILE);
+        }
+    }
+    fclose(file);
+
+    // Sort both tables for binary search, dropping overlapping ranges and repeated medications
+    // (an empty table may have no array at all)
+    if (billingRates.roomClassCount > 1) {
+        qsort(billingRates.roomClasses, billingRates.roomClassCount, sizeof(RoomClass), compareRoomClasses);
+    }
+    int kept = 0;
+    for (int i = 0; i < billingRates.roomClassCount; i++) {
+        RoomClass *roomClass = &billingRates.roomClasses[i];
+        if (kept > 0 && roomClass->firstRoom <= billingRates.roomClasses[kept - 1].lastRoom) {
+            printf("Warning: rooms %d to %d in %s overlap another class.\n", roomClass->firstRoom, roomClass->lastRoom,
+                   RATES_FILE);
+            continue;
+        }
+        billingRates.roomClasses[kept++] = *roomClass;
+    }
+    billingRates.roomClassCount = kept;
+
+    if (billingRates.medicationRateCount > 1) {
+        qsort(billingRates.medicationRates, billingRates.medicationRateCount, sizeof(MedicationRate), compareMedicationRates);
+    }
+    kept = 0;
+    for (int i = 0; i < billingRates.medicationRateCount; i++) {
+        MedicationRate *rate = &billingRates.medicationRates[i];
+        if (kept > 0 && strcmp(rate->name, billingRates.medicationRates[kept - 1].name) == 0) {
+            printf("Warning: %s has more than one cost in %s.\n", rate->name, RATES_FILE);
+            continue;
+        }
+        billingRates.medicationRates[kept++] = *rate;
+    }
+    billingRates.medicationRateCount = kept;
+    billingLedger.stale = 1;  // Charges already posted used the old rates
+    roomInventory.stale = 1;  // ... and the beds are counted by class
+}
+
+// Functions to look up a rate
+
+/**
+ * @brief Returns the class of a room, or the default class for rooms outside every range.
+ */
+
+const RoomClass *roomClassOf(int roomNumber) {
+    int low = 0, high = billingRates.roomClassCount;  // Find the last class starting at or before the room
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (billingRates.roomClasses[middle].firstRoom <= roomNumber) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low > 0 && roomNumber <= billingRates.roomClasses[low - 1].lastRoom) {
+        return &billingRates.roomClasses[low - 1];
+    }
+    return &billingRates.defaultRoomClass;
+}
+
+/**
+ * @brief Returns the cost of assigning a medication.
+ */
+
+int medicationCost(const char *name) {
+    MedicationRate key;
+    if (billingRates.medicationRateCount == 0 || !copyText(key.name, sizeof(key.name), name)) {
+        return billingRates.defaultMedicationCost;
+    }
+    MedicationRate *rate = bsearch(&key, billingRates.medicationRates, billingRates.medicationRateCount,
+                                   sizeof(MedicationRate), compareMedicationRates);
+    return rate != NULL ? rate->cost : billingRates.defaultMedicationCost;
+}
+
+// Function to post a charge to a patient's account
+
+/**
+ * @brief Adds 'amount' to the charges of kind 'kind' on a patient's account, growing the ledger as needed.
+ *
+ * If the ledger cannot grow, it is marked stale and rebuilt when it is next used.
+ */
+
+void billingPost(int patientID, int kind, int amount) {
+    BillingLedger *ledger = &billingLedger;
+    if (ledger->stale) {
+        return;
+    }
+    if (patientID >= ledger->capacity) {
+        int capacity = ledger->capacity > 0 ? ledger->capacity : 1024;
+        while (capacity <= patientID) {
+            capacity *= 2;
+        }
+        BillingAccount *accounts = realloc(ledger->accounts, capacity * sizeof(BillingAccount));
+        if (accounts == NULL) {
+            ledger->stale = 1;
+            return;
+        }
+        memset(accounts + ledger->capacity, 0, (capacity - ledger->capacity) * sizeof(BillingAccount));
+        ledger->accounts = accounts;
+        ledger->capacity = capacity;
+    }
+    ledger->accounts[patientID].charges[kind] += amount;
+    if (kind == CHARGE_APPOINTMENT) {
+        ledger->accounts[patientID].appointments++;
+    }
+}
+
+// Function to build the billing ledger
+
+/**
+ * @brief Builds the ledger from the patients and the appointment store if it is stale.
+ *
+ * Reads only the patient column of the appointment store.
+ *
+ * @return 1 if the ledger is ready, 0 if memory ran out (the ledger stays stale).
+ */
+
+int billingLedgerReady() {
+    BillingLedger *ledger = &billingLedger;
+    if (!ledger->stale) {
+        return 1;
+    }
+    if (ledger->capacity > 0) {
+        memset(ledger->accounts, 0, ledger->capacity * sizeof(BillingAccount));
+    }
+    ledger->stale = 0;
+
+    for (int i = 0; i < patientSlotCount && !ledger->stale; i++) {
+        Patient *patient = patientAt(i);
+        if (patient->id < 0) {
+            continue;
+        }
+        Doctor *doctor = patientDoctor(patient);
+        billingPost(patient->id, CHARGE_DOCTOR, doctor != NULL ? doctor->visitingFees : 0);
+        for (int p = patient->firstMedication; p != -1; p = prescriptionAt(p)->next) {
+            billingPost(patient->id, CHARGE_MEDICATION, medicationCost(medicationAt(prescriptionAt(p)->medicationID)->name));
+        }
+    }
+
+    int blockCount = (appointmentCount + APPOINTMENT_BLOCK_ROWS - 1) / APPOINTMENT_BLOCK_ROWS;
+    for (int block = 0; block < blockCount && !ledger->stale; block++) {
+        int rows = appointmentCount - block * APPOINTMENT_BLOCK_ROWS;
+        if (rows > APPOINTMENT_BLOCK_ROWS) {
+            rows = APPOINTMENT_BLOCK_ROWS;
+        }
+        const int *patients = appointmentColumn(block, APPOINTMENT_COLUMN_PATIENT);
+        for (int row = 0; row < rows; row++) {
+            if (patientSlot(patients[row]) >= 0) {  // Appointments of removed patients are no longer billed
+                billingPost(patients[row], CHARGE_APPOINTMENT, billingRates.appointmentFee);
+            }
+        }
+    }
+
+    if (ledger->stale) {
+        printf("Not enough memory to build the billing ledger.\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Function to itemize a patient's bill
+
+/**
+ * @brief Fills in the invoice of the patient in a slot, charging the stay up to 'today'.
+ *
+ * Only reads the patient, the rates and the ledger, which must be ready. A free slot
+ * gives an invoice with a patient ID of -1.
+ */
+
+void billPatient(Patient *patient, int today, Invoice *invoice) {
+    memset(invoice, 0, sizeof(Invoice));
+    invoice->patientID = patient->id;
+    if (patient->id < 0) {
+        return;
+    }
+
+    invoice->roomClass = roomClassOf(patient->roomNumber);
+    invoice->days = patient->admissionDate > 0 && patient->admissionDate <= today ? today - patient->admissionDate + 1 : 1;
+    invoice->roomCharge = invoice->days * invoice->roomClass->dailyRate;
+    invoice->medications = patient->medicationCount;
+    invoice->total = invoice->roomCharge;
+    if (!billingLedger.stale && patient->id < billingLedger.capacity) {
+        BillingAccount *account = &billingLedger.accounts[patient->id];
+        for (int kind = 0; kind < CHARGE_KIND_COUNT; kind++) {
+            invoice->charges[kind] = account->charges[kind];
+            invoice->total += account->charges[kind];
+        }
+        invoice->appointments = account->appointments;
+    }
+}
+
+// Function to calculate patient's bill based on room and doctor's fees.
+
+/*
+ * Function to calculate the total bill for a patient.
+ * This function makes sure the billing ledger is ready and returns the total of the patient's itemized
+ * bill as of today: the stay at the daily rate of the room's class, plus the doctor's fee, medications
+ * and appointments posted to the patient's account.
+ */
+
+int calculateBill(Patient *patient) {
+    Invoice invoice;
+    billingLedgerReady();
+    billPatient(patient, currentDate(), &invoice);
+    return invoice.total;
+}
+
+// Function to print a patient's itemized bill
+
+/**
+ * @brief Prints the bill of a patient, one line per kind of charge.
+ */
+
+void printInvoice(Patient *patient, const Invoice *invoice) {
+    printf("Patient: %s\n", patient->name);
+    printf("Room Charge: %d (room %d, %s, %d day(s) at %d)\n", invoice->roomCharge, patient->roomNumber,
+           invoice->roomClass->name, invoice->days, invoice->roomClass->dailyRate);
+    printf("Doctor's Fee: %d\n", invoice->charges[CHARGE_DOCTOR]);
+    printf("Medications: %d (%d assigned)\n", invoice->charges[CHARGE_MEDICATION], invoice->medications);
+    printf("Appointments: %d (%d scheduled)\n", invoice->charges[CHARGE_APPOINTMENT], invoice->appointments);
+    printf("Total Bill: %d\n", invoice->total);
+}
+
+// Function to write an invoice as a record of a listing
+
+/**
+ * @brief Writes one invoice, numbered 'number' in its listing, through the output layer.
+ */
+
+void outputInvoice(int number, Patient *patient, const Invoice *invoice) {
+    if (!outputRecordBegin()) {
+        outputRecordEnd();
+        return;  // Outside the selected records
+    }
+    outputText("Invoice #%d\n", number);
+    outputInt("patientID", "Patient ID", invoice->patientID);
+    outputField("name", "Patient", patient->name);
+    outputInt("roomNumber", "Room Number", patient->roomNumber);
+    outputField("roomClass", "Room Class", invoice->roomClass->name);
+    outputInt("days", "Days", invoice->days);
+    outputInt("roomCharge", "Room Charge", invoice->roomCharge);
+    outputInt("doctorFee", "Doctor's Fee", invoice->charges[CHARGE_DOCTOR]);
+    outputInt("medications", "Medications", invoice->medications);
+    outputInt("medicationCharge", "Medication Charges", invoice->charges[CHARGE_MEDICATION]);
+    outputInt("appointments", "Appointments", invoice->appointments);
+    outputInt("appointmentCharge", "Appointment Charges", invoice->charges[CHARGE_APPOINTMENT]);
+    outputInt("total", "Total Bill", invoice->total);
+    outputRecordEnd();
+}
+
+// Function to bill a range of patient slots
+void billPatients(BillingTask *task) {
+    for (int i = 0; i < task->count; i++) {
+        billPatient(patientAt(task->first + i), task->today, &task->invoices[i]);
+    }
+}
+
+#ifndef _WIN32
+// Function run by each billing thread
+void *billingThread(void *argument) {
+    billPatients(argument);
+    return NULL;
+}
+#endif
+
+// Function to bill every patient
+
+/**
+ * @brief Writes the invoice of every patient to a file ('-' for the output stream, which is stdout 
+ * or a server client's connection) in the current output format.
+ *
+ * The patient table is billed in blocks of BILLING_BLOCK_SIZE slots. Each block is split between up
+ * to BILLING_MAX_THREADS threads (one per processor), then its invoices are written in slot order
+ * through the output layer, so the whole census is written in one pass with bounded memory. The
+ * output offset and limit are ignored.
+ *
+ * @param billed Set to the number of invoices written.
+ * @param total Set to the sum of their totals.
+ * @return STATUS_OK, STATUS_IO_ERROR if the file cannot be written, or STATUS_NO_MEMORY.
+ */
+
+int billAllPatients(const char *path, int *billed, long long *total) {
+    *billed = 0;
+    *total = 0;
+    Invoice *invoices = malloc(BILLING_BLOCK_SIZE * sizeof(Invoice));
+    if (invoices == NULL || !billingLedgerReady()) {
+        free(invoices);
+        return STATUS_NO_MEMORY;
+    }
+    FILE *stream = output.stream != NULL ? output.stream : stdout;
+    FILE *file = strcmp(path, "-") == 0 ? stream : fopen(path, "w");
+    if (file == NULL) {
+        free(invoices);
+        return STATUS_IO_ERROR;
+    }
+
+    int threadCount = 1;
+#ifndef _WIN32
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    threadCount = processors > 1 ? (int)processors : 1;
+#endif
+    if (threadCount > BILLING_MAX_THREADS) {
+        threadCount = BILLING_MAX_THREADS;
+    }
+
+    outputFlush();
+    Output saved = output;
+    output.offset = output.limit = 0;
+    output.stream = file;
+    outputBegin();
+    int today = currentDate();
+    for (int first = 0; first < patientSlotCount; first += BILLING_BLOCK_SIZE) {
+        int count = patientSlotCount - first < BILLING_BLOCK_SIZE ? patientSlotCount - first : BILLING_BLOCK_SIZE;
+
+        // Split the block between the threads
+        BillingTask tasks[BILLING_MAX_THREADS];
+        int taskCount = count < threadCount ? 1 : threadCount;
+        for (int i = 0; i < taskCount; i++) {
+            int start = count / taskCount * i;
+            tasks[i].first = first + start;
+            tasks[i].count = i == taskCount - 1 ? count - start : count / taskCount;
+            tasks[i].today = today;
+            tasks[i].invoices = invoices + start;
+        }
+#ifdef _WIN32
+        for (int i = 0; i < taskCount; i++) {
+            billPatients(&tasks[i]);
+        }
+#else
+        pthread_t threads[BILLING_MAX_THREADS];
+        int started[BILLING_MAX_THREADS];
+        for (int i = 1; i < taskCount; i++) {
+            started[i] = pthread_create(&threads[i], NULL, billingThread, &tasks[i]) == 0;
+        }
+        billPatients(&tasks[0]);  // The calling thread bills the first part
+        for (int i = 1; i < taskCount; i++) {
+            if (started[i]) {
+                pthread_join(threads[i], NULL);
+            } else {
+                billPatients(&tasks[i]);  // No thread could be started for this part
+            }
+        }
+#endif
+
+        // Write the block's invoices in slot order
+        for (int i = 0; i < count; i++) {
+            if (invoices[i].patientID >= 0) {
+                outputInvoice(++*billed, patientAt(first + i), &invoices[i]);
+                *total += invoices[i].total;
+            }
+        }
+    }
+    outputEnd();
+    int written = !ferror(file);
+    saved.buffer = output.buffer;  // The buffer may have been moved while growing
+    saved.capacity = output.capacity;
+    output = saved;
+    if (file != stream) {
+        written = fclose(file) == 0 && written;
+    }
+    free(invoices);
+    return written ? STATUS_OK : STATUS_IO_ERROR;
+}
+
+// Function to bill every patient into a file chosen by the user
+
+/*
+ * Function to run the billing of all patients.
+ * This function prompts for the path of the invoice file, runs billAllPatients and reports
+ * how many invoices were written and their total.
+ */
+
+void billAllPatientsToFile() {
+    char path[260];
+    printf("Enter the path of the invoice file: ");
+    scanf("%259s", path);
+
+    int billed;
+    long long total;
+    int status = billAllPatients(path, &billed, &total);
+    if (status == STATUS_IO_ERROR) {
+        printf("Could not write %s.\n", path);
+    } else if (status == STATUS_NO_MEMORY) {
+        printf("Not enough memory to bill the patients.\n");
+    } else {
+        printf("Wrote %d invoice(s) totalling %lld to %s.\n", billed, total, path);
+    }
+}
+
+// Function to assign medications to a patient
+
+/*
+ * Function to assign medication to a patient by updating their medication list.
+ * The user is prompted to enter the medication name and dosage, which insertMedication adds to the
+ * patient's medication list through the medication catalog. There is no limit on the number of medications.
+ */
+
+void assignMedicationToPatient(int patientID) {
+    char name[100], dosage[50];
+    printf("Enter medication name: ");
+    scanf("%99s", name);
+    printf("Enter medication dosage: ");
+    scanf("%49s", dosage);
+
+    if (insertMedication(patientID, name, dosage) != STATUS_OK) {
+        printf("The medication could not be assigned.\n");
+        return;
+    }
+    printf("Medication assigned successfully!\n");
+}
+
+// Function to view all doctors
+
+/*
+ * Function to display a list of all patients, their details, and assigned medications.
+ * This function iterates over all patients, printing their personal details like name, age, and doctor assigned to them.
+ * It also lists medications that are assigned to each patient, if any.
+ * If no patients are available, a message is displayed indicating no data is available.
+ */
+
+void viewDoctors() {
+    if (doctorCount == 0) {
+        printf("No doctors available.\n");
+        return;
+    }
+
+    outputBegin();
+    outputText("\n----- Doctors List -----\n");
+    for (int i = 0; i < doctorCount; i++) {
+        outputDoctor(i + 1, i);
+    }
+    outputEnd();
+}
+
+// Function to view all patients
+
+/*
+ * Function to view a list of all patients along with their personal and medical details.
+ * This function iterates through the list of patients and displays:
+ * - Patient's name, age, diagnosis, and room number
+ * - Assigned doctor's name
+ * - List of medications assigned to the patient, if any
+ * If no patients are available, a message is displayed indicating the absence of patients.
+ */
+
+void viewPatients() {
+    if (patientCount == 0) {
+        printf("No patients available.\n");
+        return;
+    }
+
+    outputBegin();
+    outputText("\n----- Patients List -----\n");
+    for (int i = 0, number = 0; i < patientSlotCount; i++) {
+        Patient *patient = patientAt(i);
+        if (patient->id < 0) {
+            continue;  // Skip the slots of removed patients
+        }
+        outputPatient(++number, patient);  // Details, assigned doctor and medications
+    }
+    outputEnd();
+}
+
+// Function to schedule an appointment
+
+/*
+ * Function to schedule a new appointment between a patient and a doctor.
+ * This function performs the following steps:
+ * - Requests a valid patient ID and checks if the patient exists
+ * - Requests a valid doctor ID and checks if the doctor exists
+ * - Takes the appointment date as input from the user and checks that it is a valid date
+ * - Takes the appointment time as input and checks that it is the start of a slot in working hours
+ * - If the doctor is already booked in that slot, suggests the nearest free time instead
+ * - Appends the appointment to the appointment store on disk
+ * - If the appointment store cannot be written, an error message is displayed
+ */
+
+void scheduleAppointment() {
+    int patientID, doctorID;
+    char appointmentDate[20];
+
+    // Get the patient ID and validate it
+    printf("Enter patient ID: ");
+    patientID = readInteger();
+    if (patientByID(patientID) == NULL) {
+        printf("Invalid patient ID.\n");
+        return;
+    }
+
+    // Get the doctor ID and validate it
+    printf("Enter doctor ID (0-%d): ", doctorCount - 1);
+    doctorID = readInteger();
+    if (doctorID < 0 || doctorID >= doctorCount) {
+        printf("Invalid doctor ID.\n");
+        return;
+    }
+
+    // Get the appointment date and convert it to a day number
+    printf("Enter appointment date (YYYY-MM-DD): ");
+    scanf("%19s", appointmentDate);
+    int date = parseDate(appointmentDate);
+    if (date == INVALID_DATE) {
+        printf("Invalid date. Use YYYY-MM-DD, e.g. 2024-03-15.\n");
+        return;
+    }
+
+    // Get the appointment time, which must be the start of one of the doctor's slots
+    char first[8], last[8], time[20];
+    formatTime(slotTime(0), first);
+    formatTime(slotTime(CALENDAR_SLOTS - 1), last);
+    printf("Enter appointment time (HH:MM, %s-%s): ", first, last);
+    scanf("%19s", time);
+    int slot = slotFromTime(parseTime(time));
+    if (slot == NO_SLOT) {
+        printf("Invalid time. Appointments start every %d minutes from %s to %s.\n", CALENDAR_SLOT_MINUTES, first, last);
+        return;
+    }
+
+    // Store the appointment, suggesting another time if the slot is taken
+    int status = insertAppointment(patientID, doctorID, date, slot);
+    if (status == STATUS_DUPLICATE) {
+        printf("%s is already booked at %s on %s.\n", doctorAt(doctorID)->name, time, appointmentDate);
+        suggestAppointmentSlot(doctorID, date, slot);
+        return;
+    }
+    if (status != STATUS_OK) {
+        printf("Error saving the appointment.\n");
+        return;
+    }
+    printf("Appointment scheduled successfully!\n");
+}
+
+// Function to view all appointments
+
+/*
+ * Function to view a list of all scheduled appointments.
+ * This function iterates through all scheduled appointments and displays:
+ * - Patient's name
+ * - Doctor's name
+ * - Appointment date
+ * The appointments are read from the appointment store one block at a time.
+ * If no appointments are scheduled, it will print a message indicating so.
+ * It also validates the patient and doctor data before displaying the appointment information.
+ */
+
+void viewAppointments() {
+    if (appointmentCount == 0) {
+        printf("No appointments scheduled.\n");
+        return;
+    }
+
+    outputBegin();
+    outputText("\n----- Appointments List -----\n");
+    scanAppointments(-1, INT_MIN, INT_MAX, printAppointment);
+    outputEnd();
+}
+
+// Function to print one appointment
+
+/*
+ * Function to print one appointment.
+ * Used as the 'visit' function of scanAppointments and queryAppointments. It validates the patient and doctor IDs
+ * and writes the appointment number, patient name, doctor name, date and time as a record of the current listing.
+ */
+
+void printAppointment(int index, const Appointment *appointment) {
+    int patientID = appointment->patientID;
+    int doctorID = appointment->doctorID;
+
+    if (!outputRecordBegin()) {
+        outputRecordEnd();
+        return;  // Outside the selected records
+    }
+
+    // Validate the patient and doctor ID before displaying
+    Patient *patient = patientByID(patientID);
+
+    outputInt("id", NULL, index);
+    outputInt("patientID", NULL, patientID);
+    outputInt("doctorID", NULL, doctorID);
+    if (patient != NULL && doctorID >= 0 && doctorID < doctorCount) {
+        char date[16], time[8] = "";
+        formatDate(appointment->date, date);
+        if (appointment->slot != NO_SLOT) {
+            formatTime(slotTime(appointment->slot), time);
+        }
+        outputText("Appointment #%d\n", index + 1);
+        outputField("patient", "Patient", patient->name);
+        outputField("doctor", "Doctor", doctorAt(doctorID)->name);
+        outputField("date", "Date", date);
+        outputField("time", "Time", appointment->slot != NO_SLOT ? time : "not set");
+    } else {
+        outputText("Error: Invalid patient or doctor data for appointment #%d\n", index + 1);
+    }
+    outputRecordEnd();
+}
+
+// Function to read a range of dates
+
+/*
+ * Function to read a range of dates from the user.
+ * This function prompts for a first and a last date, either of which can be left out by
+ * entering '*'. It stores the day numbers of the range in 'fromDate' and 'toDate' and returns 1,
+ * or prints an error message and returns 0 if a date is not valid.
+ */
+
+int readDateRange(int *fromDate, int *toDate) {
+    char fromText[20], toText[20];
+    *fromDate = INT_MIN;
+    *toDate = INT_MAX;
+
+    printf("Enter the first date (YYYY-MM-DD, * for no limit): ");
+    scanf("%19s", fromText);
+    printf("Enter the last date (YYYY-MM-DD, * for no limit): ");
+    scanf("%19s", toText);
+    if ((strcmp(fromText, "*") != 0 && (*fromDate = parseDate(fromText)) == INVALID_DATE) ||
+        (strcmp(toText, "*") != 0 && (*toDate = parseDate(toText)) == INVALID_DATE)) {
+        printf("Invalid date. Use YYYY-MM-DD, e.g. 2024-03-15.\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Function to view appointments filtered by doctor and date
+
+/*
+ * Function to view the appointments of one doctor and/or within a range of dates.
+ * This function prompts for a doctor's name, which can be left out by entering '*', and a range of dates,
+ * and lists the matching appointments with listAppointments.
+ */
+
+void filterAppointments() {
+    char doctorName[100];
+    int doctorID = -1, fromDate, toDate;
+
+    printf("Enter the doctor's name (* for any doctor): ");
+    scanf("%99s", doctorName);
+    if (strcmp(doctorName, "*") != 0) {
+        doctorID = nameIndexFind(&doctorNameIndex, doctorName);
+        if (doctorID == -1) {
+            printf("Doctor not found.\n");
+            return;
+        }
+    }
+    if (!readDateRange(&fromDate, &toDate)) {
+        return;
+    }
+
+    listAppointments(doctorID, fromDate, toDate);
+}
+
+// Function to list appointments by doctor and date
+
+/*
+ * Function to list the appointments of one doctor (or any doctor when 'doctorID' is -1) between two dates.
+ * A single doctor's appointments are looked up in the doctor date index and listed in date order;
+ * otherwise the matching appointments are found by scanning only the date column of the appointment store.
+ */
+
+void listAppointments(int doctorID, int fromDate, int toDate) {
+    outputBegin();
+    outputText("\n----- Matching Appointments -----\n");
+    int matches = doctorID >= 0 ? queryAppointments(&doctorAppointmentIndex, doctorID, fromDate, toDate, printAppointment)
+                                : scanAppointments(-1, fromDate, toDate, printAppointment);
+    outputText("%d appointment(s) found.\n", matches);
+    outputEnd();
+}
+
+// Function to view the appointment history of a patient
+
+/*
+ * Function to view the appointments of one patient in date order.
+ * This function prompts for the patient's name and a range of dates, and lists the
+ * patient's appointments with listPatientAppointments.
+ */
+
+void viewPatientAppointments() {
+    char patientName[100];
+    int fromDate, toDate;
+
+    printf("Enter the patient's name: ");
+    scanf("%99s", patientName);
+    int slot = nameIndexFind(&patientNameIndex, patientName);
+    if (slot == -1) {
+        printf("Patient not found.\n");
+        return;
+    }
+    int patientID = patientAt(slot)->id;
+    if (!readDateRange(&fromDate, &toDate)) {
+        return;
+    }
+    listPatientAppointments(patientID, fromDate, toDate);
+}
+
+// Function to list the appointments of a patient
+
+/*
+ * Function to list the appointments of the patient with ID 'patientID' between two dates, in date order.
+ * The appointments are looked up in the patient date index.
+ */
+
+void listPatientAppointments(int patientID, int fromDate, int toDate) {
+    outputBegin();
+    outputText("\n----- Appointments of %s -----\n", patientByID(patientID)->name);
+    int matches = queryAppointments(&patientAppointmentIndex, patientID, fromDate, toDate, printAppointment);
+    outputText("%d appointment(s) found.\n", matches);
+    outputEnd();
+}
+
+// Function to suggest a free appointment time
+
+/*
+ * Function to suggest another time when a doctor's slot is already booked.
+ * Suggests the free slot closest to 'slot' on the same day, or, if that day is full,
+ * the closest free slot on the next day with room in the following CALENDAR_SEARCH_DAYS days.
+ * Each day is checked with a single calendar lookup.
+ */
+
+void suggestAppointmentSlot(int doctorID, int date, int slot) {
+    for (int offset = 0; offset <= CALENDAR_SEARCH_DAYS; offset++) {
+        int free = nearestFreeSlot(calendarSlots(doctorID, date + offset), slot);
+        if (free == NO_SLOT) {
+            continue;
+        }
+
+        char day[16], time[8];
+        formatDate(date + offset, day);
+        formatTime(slotTime(free), time);
+        if (offset == 0) {
+            printf("The nearest free time that day is %s.\n", time);
+        } else {
+            printf("The doctor is fully booked that day. The next free time is %s at %s.\n", day, time);
+        }
+        return;
+    }
+    printf("The doctor has no free time in the next %d days.\n", CALENDAR_SEARCH_DAYS);
+}
+
+// Function to view a doctor's calendar
+
+/*
+ * Function to view a doctor's calendar.
+ * This function prompts for a doctor's name and a date, then displays:
+ * - Every slot of that day, and whether it is booked or free
+ * - The utilisation (booked slots out of CALENDAR_SLOTS) of each day in the week starting on that date
+ * The information comes from the calendar bitmaps, so no appointments are read.
+ */
+
+void viewDoctorCalendar() {
+    char doctorName[100], dateText[20];
+
+    printf("Enter the doctor's name: ");
+    scanf("%99s", doctorName);
+    int doctorID = nameIndexFind(&doctorNameIndex, doctorName);
+    if (doctorID == -1) {
+        printf("Doctor not found.\n");
+        return;
+    }
+    printf("Enter the date (YYYY-MM-DD): ");
+    scanf("%19s", dateText);
+    int date = parseDate(dateText);
+    if (date == INVALID_DATE) {
+        printf("Invalid date. Use YYYY-MM-DD, e.g. 2024-03-15.\n");
+        return;
+    }
+
+    printf("\n----- Calendar of %s on %s -----\n", doctorName, dateText);
+    unsigned int booked = calendarSlots(doctorID, date);
+    for (int slot = 0; slot < CALENDAR_SLOTS; slot++) {
+        char time[8];
+        formatTime(slotTime(slot), time);
+        printf("%s  %s\n", time, (booked & (1u << slot)) ? "Booked" : "Free");
+    }
+
+    printf("\nUtilisation for the week:\n");
+    for (int offset = 0; offset < 7; offset++) {
+        char day[16];
+        int count = countBits(calendarSlots(doctorID, date + offset));
+        formatDate(date + offset, day);
+        printf("%s: %d of %d slots booked (%d%%)\n", day, count, CALENDAR_SLOTS, count * 100 / CALENDAR_SLOTS);
+    }
+}
+
+// Function to view the current bill of a patient
+
+/*
+ * Function to view and calculate the total bill of a specific patient.
+ * This function performs the following steps:
+ * - Requests the patient ID and validates it
+ * - Itemizes the patient's bill from the billing ledger and the length of stay
+ * - Displays the patient's name, each kind of charge, and the total bill amount
+ * If an invalid patient ID is entered, an error message is displayed.
+ */
+
+void viewPatientBill() {
+    printf("Enter patient ID to view the bill: ");
+    Patient *patient = patientByID(readInteger());
+
+    if (patient != NULL) {
+        // Itemize and display the bill for the patient
+        Invoice invoice;
+        billingLedgerReady();
+        billPatient(patient, currentDate(), &invoice);
+        printInvoice(patient, &invoice);
+    } else {
+        printf("Invalid patient ID.\n");
+    }
+}
+
+// Function to add a new staff member
+
+/*
+ * Function to add a new staff member to the system.
+ * This function prompts the user for the staff member's:
+ * - Name
+ * - Role (e.g., Nurse, Admin, etc.)
+ * - Contact information
+ * It then adds the staff member with an empty shift list through insertStaff.
+ * A name that is already in use by another staff member is rejected.
+ * If memory for the staff member cannot be allocated, an error message is displayed.
+ */
+
+void addStaff() {
+    char name[100], role[50], contactInfo[100];
+
+    printf("Enter staff member's name: ");
+    scanf("%99s", name);
+    if (nameIndexFind(&staffNameIndex, name) != -1) {
+        printf("A staff member named %s already exists.\n", name);
+        return;
+    }
+    printf("Enter staff member's role (e.g., Nurse, Admin): ");
+    scanf("%49s", role);
+    printf("Enter staff member's contact info: ");
+    scanf("%99s", contactInfo);
+    
+    switch (insertStaff(name, role, contactInfo)) {
+        case STATUS_OK:
+            printf("Staff member added successfully!\n");
+            break;
+        case STATUS_DUPLICATE:
+            printf("A staff member named %s already exists.\n", name);
+            break;
+        case STATUS_INVALID:
+            printf("The name must not be empty, and no detail may be too long.\n");
+            break;
+        default:
+            printf("Not enough memory to add another staff member.\n");
+            break;
+    }
+}
+
+
+// Function to assign shift to a staff member
+
+/*
+ * Function to assign a shift to a specific staff member.
+ * This function performs the following steps:
+ * - Requests the name of the staff member and looks it up in the staff name index
+ * - If found, it prompts for the details of the shift: day, start time, end time, and role
+ * - It validates the day of the week and converts the times to minutes since midnight
+ * - It then appends the shift to the staff member's list in the shift table
+ * If the staff member is not found or the shift details are invalid, an error message is displayed.
+ */
+
+void assignShiftToStaff() {
+    char name[100];
+    printf("Enter the staff member's name to assign shift: ");
+    scanf("%99s", name);
+
+    int staffIndex = nameIndexFind(&staffNameIndex, name);
+    if (staffIndex == -1) {
+        printf("Staff member not found.\n");
+        return;
+    }
+
+    char day[20], startText[20], endText[20], role[50];
+    printf("Enter day for the shift: ");
+    scanf("%19s", day);
+    printf("Enter start time for the shift (HH:MM): ");
+    scanf("%19s", startText);
+    printf("Enter end time for the shift (HH:MM): ");
+    scanf("%19s", endText);
+    printf("Enter role for the shift: ");
+    scanf("%49s", role);
+
+    // Validate the day and times before storing the shift
+    int weekday = parseWeekday(day);
+    int startTime = parseTime(startText);
+    int endTime = parseTime(endText);
+    if (weekday == -1) {
+        printf("Invalid day of the week.\n");
+        return;
+    }
+    if (startTime == -1 || endTime == -1) {
+        printf("Invalid shift time. Use HH:MM, e.g. 09:00 or 17:30.\n");
+        return;
+    }
+
+    if (insertShift(staffIndex, weekday, startTime, endTime, role) != STATUS_OK) {
+        printf("Not enough memory to assign another shift.\n");
+        return;
+    }
+    printf("Shift assigned successfully to %s!\n", staffAt(staffIndex)->name);
+}
+
+
+// Function to view all staff schedules
+
+/*
+ * Function to view the schedules of all staff members.
+ * This function iterates through all staff members and displays:
+ * - Staff member's name and role
+ * - Contact information
+ * - The shifts assigned to the staff member (day, start time, end time, and role)
+ * If no shifts are assigned to a staff member, it will print a message indicating that.
+ * If no staff members are available, a message is displayed.
+ */
+
+void viewStaffSchedules() {
+    if (staffCount == 0) {
+        printf("No staff members found.\n");
+        return;
+    }
+
+    outputBegin();
+    outputText("\n----- Staff Schedules -----\n");
+    for (int i = 0; i < staffCount; i++) {
+        Staff *member = staffAt(i);
+        if (!outputRecordBegin()) {
+            outputRecordEnd();
+            continue;  // Outside the selected records
+        }
+        outputText("Staff Member: %s (%s)\n", member->name, member->role);
+        outputField("name", NULL, member->name);
+        outputField("role", NULL, member->role);
+        outputField("contactInfo", "Contact Info", member->contactInfo);
+
+        outputListBegin("shifts", "Assigned Shifts");
+        for (int s = member->firstShift; s != -1; s = shiftAt(s)->next) {
+            Shift *shift = shiftAt(s);
+            char start[8], end[8];
+            formatTime(shift->startTime, start);
+            formatTime(shift->endTime, end);
+            outputListItem("Day: %s, Shift: %s to %s, Role: %s",
+                weekdayNames[shift->day], start, end, roleAt(shift->roleID)->name);
+        }
+        outputListEnd();
+
+        // Check if the staff member has any assigned shifts
+        if (member->shiftCount == 0) {
+            outputText("  No shifts assigned.\n");
+        }
+        outputRecordEnd();
+    }
+    outputEnd();
+}
+
+// Function to choose the output settings
+
+/*
+ * Function to choose how the listings are written.
+ * This function prompts for:
+ * - The format: 'text' (labelled lines), 'csv' (a header line and one line per record) or 'jsonl' (one JSON object per line)
+ * - The number of records to skip at the start of each listing
+ * - The largest number of records to show (0 to show all), which together with the offset selects a page
+ * The settings apply to the doctor, patient, staff and appointment listings until they are changed.
+ */
+
+void outputSettings() {
+    char format[10];
+
+    printf("Enter the output format (text, csv, jsonl): ");
+    scanf("%9s", format);
+    int chosen = parseOutputFormat(format);
+    if (chosen == -1) {
+        printf("Unknown format. Use text, csv or jsonl.\n");
+        return;
+    }
+    printf("Enter the number of records to skip: ");
+    int offset = readInteger();
+    printf("Enter the number of records to show (0 for all): ");
+    int limit = readInteger();
+
+    output.format = (OutputFormat)chosen;
+    output.offset = offset;
+    output.limit = limit;
+    printf("Listings are now written as %s", outputFormatNames[chosen]);
+    if (limit > 0) {
+        printf(", records %d to %d", offset + 1, offset + limit);
+    } else if (offset > 0) {
+        printf(", from record %d", offset + 1);
+    }
+    printf(".\n");
+}
+
+// Function to view the collected statistics
+
+/*
+ * Function to view the statistics collected by the instrumentation.
+ * This function lists, in the current output format:
+ * - Each menu action, batch command, saveData and loadData called so far, with its call count, total,
+ *   median, 99th percentile and maximum latency, and its latency histogram
+ * - The bytes read and written by the data files and the journal
+ * - The current number of records in each table
+ * - The number of background saves, and the duration, pause and snapshot size of the last one
+ * If statistics are not being collected, it offers to start collecting them.
+ */
+
+void viewStatistics() {
+    if (!stats.enabled) {
+        char answer[10];
+        printf("Statistics are not being collected (set HOSPITAL_STATS to collect them from the start).\n");
+        printf("Start collecting them now? (y/n): ");
+        scanf("%9s", answer);
+        if (answer[0] == 'y' || answer[0] == 'Y') {
+            stats.enabled = 1;
+            printf("Statistics are now being collected.\n");
+        }
+        return;
+    }
+    statsWrite();
+}
+
+// Function to parse the name of an output format
+int parseOutputFormat(const char *text) {
+    for (int i = OUTPUT_TEXT; i <= OUTPUT_JSONL; i++) {
+        if (strcmp(text, outputFormatNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Function to remove a patient and display their bill before removal
+
+/*
+ * Function to remove a patient from the system.
+ * This function performs the following:
+ * - Prompts the user for the patient ID to remove
+ * - Displays the patient's bill before removal
+ * - Removes the patient through deletePatient, which frees the patient's slot in O(1) time
+ *   and records the removal in the journal; other patients keep their IDs
+ * If the patient ID is invalid, an error message is displayed.
+ */
+
+void removePatient() {
+    printf("Enter the patient ID to remove: ");
+    int patientID = readInteger();
+    Patient *patient = patientByID(patientID);
+
+    if (patient != NULL) {
+        // Display the final bill for the patient
+        Invoice invoice;
+        billingLedgerReady();
+        billPatient(patient, currentDate(), &invoice);
+        printInvoice(patient, &invoice);
+
+        deletePatient(patientID);
+        printf("Patient removed successfully!\n");
+    } else {
+        printf("Invalid patient ID.\n");
+    }
+}
+
+// Functions of the bulk CSV import
+
+/*
+ * Functions of the bulk CSV import of doctors, patients and staff.
+ * Each line of the file holds one record, with the fields in this order:
+ * - doctors:  name,age,specialty,visitingFee
+ * - patients: name,age,diagnosis,roomNumber,doctor (the doctor's name)
+ * - staff:    name,role,contactInfo
+ * A field holding commas is written in double quotes, with "" for a quote inside it. A first line
+ * whose first field is "name" is taken as a header and skipped, as are blank lines.
+ *
+ * The import works in two phases:
+ * - Parsing: The file is read into memory with a single fread and split at line boundaries into
+ *   chunks, one per thread. Each thread splits its lines into fields in place, checks the numbers
+ *   and field lengths, and resolves the doctor names of patients through the doctor name index,
+ *   which is built beforehand so the threads only read it.
+ * - Committing: The rows are then added in file order by insertDoctor, insertPatient or insertStaff,
+ *   which catch duplicate names, and the journal is committed once for the whole import.
+ * Rejected rows are reported with their line numbers, up to IMPORT_REPORT_LIMIT of them.
+ */
+
+// Function to split a CSV line into fields
+
+/**
+ * @brief Splits a null-terminated CSV line into fields in place, removing quotes.
+ * 
+ * @return The number of fields, or -1 if there are more than 'maxFields' or a quote is not closed.
+ */
+
+int importSplitLine(char *line, char **fields, int maxFields) {
+    int count = 0;
+    char *p = line;
+    while (1) {
+        if (count == maxFields) {
+            return -1;
+        }
+        if (*p == '"') {
+            // Quoted field: copy it down over its quotes, turning "" into "
+            char *out = fields[count++] = ++p;
+            while (1) {
+                if (*p == '\0') {
+                    return -1;
+                }
+                if (*p == '"') {
+                    if (p[1] != '"') {
+                        break;
+                    }
+                    p++;
+                }
+                *out++ = *p++;
+            }
+            *out = '\0';
+            p++;
+            if (*p != ',' && *p != '\0') {
+                return -1;
+            }
+        } else {
+            fields[count++] = p;
+            while (*p != ',' && *p != '\0') {
+                p++;
+            }
+        }
+        if (*p == '\0') {
+            return count;
+        }
+        *p++ = '\0';
+    }
+}
+
+// Function to check one row of an import
+
+/**
+ * @brief Checks the fields of a row and converts its numbers.
+ * 
+ * Numbers are checked against the same ranges as the insert functions, so a row 
+ * they reject later is only ever too long. Patients also have their doctor's name 
+ * resolved to a doctor ID. This function only reads shared data, so the parsing 
+ * threads can call it at the same time.
+ * 
+ * @return NULL if the row is valid, otherwise the reason it is rejected.
+ */
+
+const char *importCheckRow(ImportKind kind, ImportRow *row, int fieldCount) {
+    static const int fieldCounts[] = {4, 5, 3};
+    char **fields = row->fields;
+
+    if (fieldCount != fieldCounts[kind]) {
+        return kind == IMPORT_DOCTORS ? "expected 4 fields: name,age,specialty,visitingFee"
+             : kind == IMPORT_PATIENTS ? "expected 5 fields: name,age,diagnosis,roomNumber,doctor"
+             : "expected 3 fields: name,role,contactInfo";
+    }
+    if (fields[0][0] == '\0') {
+        return "name is empty";
+    }
+    if (kind == IMPORT_STAFF) {
+        return NULL;
+    }
+
+    // batchNumber takes no sign, so a negative number is told apart by its '-'
+    if (!batchNumber(fields[1], &row->numbers[0])) {
+        return fields[1][0] == '-' ? "age is negative" : "age is not a number";
+    }
+    if (!batchNumber(fields[3], &row->numbers[1])) {
+        if (kind == IMPORT_DOCTORS) {
+            return fields[3][0] == '-' ? "visiting fee is negative" : "visiting fee is not a number";
+        }
+        return fields[3][0] == '-' ? "room number is out of range" : "room number is not a number";
+    }
+    if (kind == IMPORT_PATIENTS && row->numbers[1] >= ROOM_NUMBER_LIMIT) {
+        return "room number is out of range";
+    }
+    if (kind == IMPORT_PATIENTS && (row->doctorID = nameIndexFind(&doctorNameIndex, fields[4])) == -1) {
+        return "doctor not found";
+    }
+    return NULL;
+}
+
+// Function to parse one chunk of an import
+
+/**
+ * @brief Parses every line of a chunk into rows; run by one thread per chunk.
+ * 
+ * Lines are numbered from 1 within the chunk; the committing phase adds the number 
+ * of lines in the chunks before it.
+ */
+
+void importParseChunk(ImportChunk *chunk) {
+    char *p = chunk->start;
+    while (p < chunk->end) {
+        char *newline = memchr(p, '\n', chunk->end - p);
+        char *lineEnd = newline != NULL ? newline : chunk->end;
+        *lineEnd = '\0';
+        if (lineEnd > p && lineEnd[-1] == '\r') {
+            lineEnd[-1] = '\0';
+        }
+        chunk->lineCount++;
+
+        char *line = p;
+        p = lineEnd + 1;
+        if (line[0] == '\0') {
+            continue;  // Skip blank lines
+        }
+
+        if (chunk->rowCount == chunk->capacity) {
+            int capacity = chunk->capacity > 0 ? chunk->capacity * 2 : 1024;
+            ImportRow *rows = realloc(chunk->rows, capacity * sizeof(ImportRow));
+            if (rows == NULL) {
+                chunk->failed = 1;
+                return;
+            }
+            chunk->rows = rows;
+            chunk->capacity = capacity;
+        }
+
+        ImportRow *row = &chunk->rows[chunk->rowCount++];
+        row->line = chunk->lineCount;
+        int fieldCount = importSplitLine(line, row->fields, IMPORT_MAX_FIELDS);
+        if (chunk->lineCount == 1 && chunk->first && fieldCount > 0 && strcmp(row->fields[0], "name") == 0) {
+            chunk->rowCount--;  // Header line
+            continue;
+        }
+        row->error = fieldCount < 0 ? "unbalanced quotes or too many fields" : importCheckRow(chunk->kind, row, fieldCount);
+    }
+}
+
+#ifndef _WIN32
+// Function run by each import thread
+void *importThread(void *argument) {
+    importParseChunk(argument);
+    return NULL;
+}
+#endif
+
+// Function to import records from a CSV file
+
+/**
+ * @brief Imports the doctors, patients or staff listed in a CSV file.
+ * 
+ * Parses the file on up to IMPORT_MAX_THREADS threads (one per processor, and at most 
+ * one per IMPORT_MIN_CHUNK bytes), then adds the valid rows in file order and prints 
+ * the line number and reason of each rejected row.
+ * 
+ * @param imported Set to the number of records added.
+ * @param rejected Set to the number of rows rejected.
+ * @return STATUS_OK if the file was imported (even if some rows were rejected), STATUS_NOT_FOUND 
+ *         if it could not be read, or STATUS_NO_MEMORY if memory ran out before any record was added.
+ */
+
+int importCSV(ImportKind kind, const char *path, int *imported, int *rejected) {
+    *imported = *rejected = 0;
+
+    // Read the whole file with a single call, keeping a spare byte to end the last line
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return STATUS_NOT_FOUND;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = size >= 0 ? malloc(size + 1) : NULL;
+    if (data == NULL || fread(data, 1, size, file) != (size_t)size) {
+        fclose(file);
+        free(data);
+        return data == NULL ? STATUS_NO_MEMORY : STATUS_NOT_FOUND;
+    }
+    fclose(file);
+    data[size] = '\0';
+
+    // Split the file into chunks that end at line boundaries
+    int threadCount = 1;
+#ifndef _WIN32
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    threadCount = processors > 1 ? (int)processors : 1;
+#endif
+    if (threadCount > IMPORT_MAX_THREADS) {
+        threadCount = IMPORT_MAX_THREADS;
+    }
+    if (threadCount > size / IMPORT_MIN_CHUNK + 1) {
+        threadCount = (int)(size / IMPORT_MIN_CHUNK + 1);
+    }
+    ImportChunk chunks[IMPORT_MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    char *start = data;
+    for (int i = 0; i < threadCount; i++) {
+        char *end = i == threadCount - 1 ? data + size : data + size / threadCount * (i + 1);
+        if (end < start) {
+            end = start;
+        }
+        if (i < threadCount - 1) {
+            char *newline = memchr(end, '\n', data + size - end);
+            end = newline != NULL ? newline + 1 : data + size;
+        }
+        chunks[i].kind = kind;
+        chunks[i].start = start;
+        chunks[i].end = end;
+        chunks[i].first = i == 0;
+        start = end;
+    }
+
+    // Build the doctor name index now, so the threads never change it
+    if (doctorNameIndex.stale) {
+        nameIndexRebuild(&doctorNameIndex);
+    }
+
+    // Parse the chunks in parallel
+#ifdef _WIN32
+    for (int i = 0; i < threadCount; i++) {
+        importParseChunk(&chunks[i]);
+    }
+#else
+    pthread_t threads[IMPORT_MAX_THREADS];
+    int started[IMPORT_MAX_THREADS];
+    for (int i = 1; i < threadCount; i++) {
+        started[i] = pthread_create(&threads[i], NULL, importThread, &chunks[i]) == 0;
+    }
+    importParseChunk(&chunks[0]);  // The calling thread parses the first chunk
+    for (int i = 1; i < threadCount; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            importParseChunk(&chunks[i]);  // No thread could be started for this chunk
+        }
+    }
+#endif
+
+    int status = STATUS_OK;
+    for (int i = 0; i < threadCount; i++) {
+        if (chunks[i].failed) {
+            status = STATUS_NO_MEMORY;
+        }
+    }
+
+    // Add the valid rows in file order
+    int firstLine = 0, today = currentDate();
+    for (int i = 0; i < threadCount && status == STATUS_OK; i++) {
+        for (int r = 0; r < chunks[i].rowCount; r++) {
+            ImportRow *row = &chunks[i].rows[r];
+            const char *error = row->error;
+            if (error == NULL) {
+                char **fields = row->fields;
+                int result = kind == IMPORT_DOCTORS ? insertDoctor(fields[0], row->numbers[0], fields[2], row->numbers[1])
+                           : kind == IMPORT_PATIENTS ? insertPatient(fields[0], row->numbers[0], fields[2], row->numbers[1], row->doctorID, today)
+                           : insertStaff(fields[0], fields[1], fields[2]);
+                error = result == STATUS_OK ? NULL
+                      : result == STATUS_DUPLICATE ? "name is already used"
+                      : result == STATUS_NO_MEMORY ? "not enough memory"
+                      : result == STATUS_OCCUPIED ? "the room is full"
+                      : result == STATUS_NOT_FOUND ? "doctor not found"
+                      : "a field is too long";
+            }
+            if (error == NULL) {
+                (*imported)++;
+            } else if (++*rejected <= IMPORT_REPORT_LIMIT) {
+                printf("Line %d rejected: %s.\n", firstLine + row->line, error);
+            }
+        }
+        firstLine += chunks[i].lineCount;
+    }
+    if (*rejected > IMPORT_REPORT_LIMIT) {
+        printf("... and %d more rejected line(s).\n", *rejected - IMPORT_REPORT_LIMIT);
+    }
+
+    journalIdle();  // Commit the whole import to the journal at once
+    for (int i = 0; i < threadCount; i++) {
+        free(chunks[i].rows);
+    }
+    free(data);
+    return status;
+}
+
+// Function to import records from a CSV file chosen by the user
+
+/*
+ * Function to import doctors, patients or staff from a CSV file.
+ * This function prompts for the kind of records and the path of the file, runs importCSV,
+ * and reports how many records were added and how many rows were rejected.
+ */
+
+void importRecords() {
+    char kindName[20], path[260];
+
+    printf("Enter the kind of records to import (doctors, patients, staff): ");
+    scanf("%19s", kindName);
+    int kind = parseImportKind(kindName);
+    if (kind == -1) {
+        printf("Unknown kind of records. Use doctors, patients or staff.\n");
+        return;
+    }
+    printf("Enter the path of the CSV file: ");
+    scanf("%259s", path);
+
+    int imported, rejected;
+    int status = importCSV((ImportKind)kind, path, &imported, &rejected);
+    if (status == STATUS_NOT_FOUND) {
+        printf("Could not read %s.\n", path);
+    } else if (status == STATUS_NO_MEMORY) {
+        printf("Not enough memory to import %s.\n", path);
+    } else {
+        printf("Imported %d %s, rejected %d line(s).\n", imported, importKindNames[kind], rejected);
+    }
+}
+
+// Function to parse the kind of records of an import
+int parseImportKind(const char *text) {
+    for (int i = IMPORT_DOCTORS; i <= IMPORT_STAFF; i++) {
+        if (strcmp(text, importKindNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Functions of the batch mode
+
+/*
+ * Functions of the batch mode, which runs commands from a file (or stdin) without prompting.
+ * Started with 'hospital --batch FILE' ('-' reads stdin). The file holds one command per line:
+ *
+ *   add-doctor NAME AGE SPECIALTY FEE            add-staff NAME ROLE CONTACT
+ *   add-patient NAME AGE DIAGNOSIS ROOM DOCTOR   add-shift STAFF DAY START END ROLE
+ *   assign-med PATIENT NAME DOSAGE               remove-patient PATIENT
+ *   schedule PATIENT DOCTOR DATE TIME            output FORMAT OFFSET LIMIT
+ *   list-doctors | list-patients | list-staff    list-appointments DOCTOR FROM TO
+ *   patient-appointments PATIENT FROM TO         import KIND FILE
+ *   bill-all FILE                                on-medication NAME
+ *   query-patients AGE AGE ROOM ROOM DOCTOR      count-patients AGE AGE ROOM ROOM DOCTOR
+ *   search FIELD MATCH TEXT                      free-room CLASS
+ *   occupancy                                    save
+ *
+ * Arguments are separated by spaces or tabs; an argument holding spaces is written in double quotes.
+ * Doctors, patients and staff are given by name, or doctors and patients by ID when the argument is
+ * a number. In list and query commands '*' leaves out the doctor or a limit. Blank lines and lines
+ * starting with '#' are skipped.
+ *
+ * Each command runs through the same insert and listing functions as the menu, then prints one
+ * status line "LINE STATUS COMMAND", followed by "id=N" for a new doctor or patient, e.g.
+ * "3 OK add-patient id=17" or "4 NOT_FOUND schedule". The journal is committed every
+ * BATCH_COMMIT_INTERVAL commands instead of after each one. The server mode speaks the same
+ * commands over a socket (see runServer).
+ */
+
+// Function to read the next line of a batch file
+
+/**
+ * @brief Reads the next line of a batch file into the reader's buffer.
+ * 
+ * Lines are found with memchr in a large buffer that is refilled with fread (or read, for 
+ * a client of the server), so reading costs a few calls per block rather than per line. The returned line is null-terminated 
+ * in place and stays valid until the next call.
+ * 
+ * @return 1 if a line was read, 0 at the end of the file, -1 if the line is longer than 
+ *         the buffer (the rest of it is skipped), or -2 if the reader is nonblocking and 
+ *         the next line has not arrived in full yet.
+ */
+
+int batchReadLine(BatchReader *reader, char **line) {
+    while (1) {
+        char *newline = memchr(reader->buffer + reader->start, '\n', reader->end - reader->start);
+        if (newline != NULL || (reader->eof && reader->start < reader->end)) {
+            if (newline == NULL) {
+                newline = reader->buffer + reader->end++;  // Last line without a newline; end is below the buffer size
+            }
+            *newline = '\0';
+            *line = reader->buffer + reader->start;
+            reader->start = newline + 1 - reader->buffer;
+            reader->lineNumber++;
+            return 1;
+        }
+        if (reader->eof) {
+            return 0;
+        }
+
+        // Move the partial line to the front and read more after it
+        if (reader->start == 0 && reader->end == BATCH_BUFFER_SIZE - 1) {
+            reader->lineNumber++;
+            reader->end = 0;
+            reader->skipping = 1;  // Drop the rest of an overlong line
+            return -1;
+        }
+        memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+        size_t bytes;
+        if (reader->file != NULL) {
+            bytes = fread(reader->buffer + reader->end, 1, BATCH_BUFFER_SIZE - 1 - reader->end, reader->file);
+        } else {
+            long received;  // Whatever has arrived, so a command runs as soon as its line is complete
+            do {
+#ifndef _WIN32
+                received = reader->nonblocking ?
+                    recv(reader->fd, reader->buffer + reader->end, BATCH_BUFFER_SIZE - 1 - reader->end, MSG_DONTWAIT) :
+                    read(reader->fd, reader->buffer + reader->end, BATCH_BUFFER_SIZE - 1 - reader->end);
+#else
+                received = read(reader->fd, reader->buffer + reader->end, BATCH_BUFFER_SIZE - 1 - reader->end);
+#endif
+            } while (received < 0 && errno == EINTR);
+            if (received < 0 && reader->nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return -2;  // Keep the partial line for the next call
+            }
+            bytes = received > 0 ? (size_t)received : 0;
+        }
+        if (bytes == 0) {
+            reader->eof = 1;
+        }
+        reader->end += bytes;
+
+        if (reader->skipping) {
+            char *end = memchr(reader->buffer, '\n', reader->end);
+            if (end == NULL) {
+                reader->end = 0;
+                continue;
+            }
+            reader->start = end + 1 - reader->buffer;
+            reader->skipping = 0;
+        }
+    }
+}
+
+// Function to split a batch line into arguments
+
+/**
+ * @brief Splits a line into arguments in place, handling double-quoted arguments and '#' comments.
+ * 
+ * @return The number of arguments, or -1 if there are more than 'maxTokens' or a quote is not closed.
+ */
+
+int batchTokenize(char *line, char **tokens, int maxTokens) {
+    int count = 0;
+    char *p = line;
+    while (1) {
+        while (*p == ' ' || *p == '\t' || *p == '\r') {
+            p++;
+        }
+        if (*p == '\0' || (*p == '#' && count == 0)) {
+            return count;
+        }
+        if (count == maxTokens) {
+            return -1;
+        }
+
+        if (*p == '"') {
+            tokens[count++] = ++p;
+            p = strchr(p, '"');
+            if (p == NULL) {
+                return -1;
+            }
+        } else {
+            tokens[count++] = p;
+            while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r') {
+                p++;
+            }
+            if (*p == '\0') {
+                return count;
+            }
+        }
+        *p++ = '\0';
+    }
+}
+
+// Function to parse a number argument
+
+/**
+ * @brief Parses a non-negative decimal number that makes up a whole argument.
+ * 
+ * @return 1 on success, 0 if the argument is not such a number.
+ */
+
+int batchNumber(const char *text, int *value) {
+    char *end;
+    if (!isdigit((unsigned char)text[0])) {
+        return 0;
+    }
+    long number = strtol(text, &end, 10);
+    if (*end != '\0' || number > INT_MAX) {
+        return 0;
+    }
+    *value = (int)number;
+    return 1;
+}
+
+// Functions to find the records named by batch arguments
+
+/*
+ * Functions to find the records named by batch arguments.
+ * A number is taken as a doctor or patient ID; anything else is looked up in the name index.
+ * They return the doctor ID, patient ID or staff index, or -1 if there is no such record.
+ */
+
+int batchDoctor(const char *text) {
+    int doctorID;
+    if (batchNumber(text, &doctorID)) {
+        return doctorID < doctorCount ? doctorID : -1;
+    }
+    return nameIndexFind(&doctorNameIndex, text);
+}
+
+int batchPatient(const char *text) {
+    int patientID;
+    if (batchNumber(text, &patientID)) {
+        return patientByID(patientID) != NULL ? patientID : -1;
+    }
+    int slot = nameIndexFind(&patientNameIndex, text);
+    return slot == -1 ? -1 : patientAt(slot)->id;
+}
+
+int batchStaff(const char *text) {
+    return nameIndexFind(&staffNameIndex, text);
+}
+
+// Function to parse a date limit of a batch list command, where '*' stands for 'unlimited'
+int batchDateLimit(const char *text, int unlimited, int *date) {
+    *date = strcmp(text, "*") == 0 ? unlimited : parseDate(text);
+    return strcmp(text, "*") == 0 || *date != INVALID_DATE;
+}
+
+// Functions that run the batch commands
+
+/*
+ * Functions that run the batch commands.
+ * Each receives the command's arguments, already checked for number, and returns a Status;
+ * STATUS_SYNTAX means an argument could not be parsed. The commands that add a doctor or a
+ * patient store its ID in 'newID'.
+ */
+
+int batchAddDoctor(char **arguments, int *newID) {
+    int age, fee;
+    if (!batchNumber(arguments[1], &age) || !batchNumber(arguments[3], &fee)) {
+        return STATUS_SYNTAX;
+    }
+    int status = insertDoctor(arguments[0], age, arguments[2], fee);
+    if (status == STATUS_OK) {
+        *newID = doctorCount - 1;
+    }
+    return status;
+}
+
+int batchAddPatient(char **arguments, int *newID) {
+    int age, roomNumber;
+    if (!batchNumber(arguments[1], &age) || !batchNumber(arguments[3], &roomNumber)) {
+        return STATUS_SYNTAX;
+    }
+    int doctorID = batchDoctor(arguments[4]);
+    if (doctorID == -1) {
+        return STATUS_NOT_FOUND;
+    }
+    int status = insertPatient(arguments[0], age, arguments[2], roomNumber, doctorID, currentDate());
+    if (status == STATUS_OK) {
+        *newID = patientIDs.nextID - 1;
+    }
+    return status;
+}
+
+int batchAssignMedication(char **arguments, int *newID) {
+    (void)newID;
+    int patientID = batchPatient(arguments[0]);
+    return patientID == -1 ? STATUS_NOT_FOUND : insertMedication(patientID, arguments[1], arguments[2]);
+}
+
+int batchRemovePatient(char **arguments, int *newID) {
+    (void)newID;
+    int patientID = batchPatient(arguments[0]);
+    return patientID == -1 ? STATUS_NOT_FOUND : deletePatient(patientID);
+}
+
+int batchSchedule(char **arguments, int *newID) {
+    (void)newID;
+    int date = parseDate(arguments[2]);
+    int time = parseTime(arguments[3]);
+    if (date == INVALID_DATE || time == -1) {
+        return STATUS_SYNTAX;
+    }
+    int patientID = batchPatient(arguments[0]);
+    int doctorID = batchDoctor(arguments[1]);
+    if (patientID == -1 || doctorID == -1) {
+        return STATUS_NOT_FOUND;
+    }
+    int slot = slotFromTime(time);
+    return slot == NO_SLOT ? STATUS_INVALID : insertAppointment(patientID, doctorID, date, slot);
+}
+
+int batchAddStaff(char **arguments, int *newID) {
+    (void)newID;
+    return insertStaff(arguments[0], arguments[1], arguments[2]);
+}
+
+int batchAddShift(char **arguments, int *newID) {
+    (void)newID;
+    int day = parseWeekday(arguments[1]);
+    int startTime = parseTime(arguments[2]);
+    int endTime = parseTime(arguments[3]);
+    if (day == -1 || startTime == -1 || endTime == -1) {
+        return STATUS_SYNTAX;
+    }
+    int staffIndex = batchStaff(arguments[0]);
+    return staffIndex == -1 ? STATUS_NOT_FOUND : insertShift(staffIndex, day, startTime, endTime, arguments[4]);
+}
+
+int batchOutput(char **arguments, int *newID) {
+    (void)newID;
+    int format = parseOutputFormat(arguments[0]);
+    int offset, limit;
+    if (format == -1 || !batchNumber(arguments[1], &offset) || !batchNumber(arguments[2], &limit)) {
+        return STATUS_SYNTAX;
+    }
+    output.format = (OutputFormat)format;
+    output.offset = offset;
+    output.limit = limit;
+    return STATUS_OK;
+}
+
+int batchListDoctors(char **arguments, int *newID) {
+    (void)arguments, (void)newID;
+    viewDoctors();
+    return STATUS_OK;
+}
+
+int batchListPatients(char **arguments, int *newID) {
+    (void)arguments, (void)newID;
+    viewPatients();
+    return STATUS_OK;
+}
+
+int batchListStaff(char **arguments, int *newID) {
+    (void)arguments, (void)newID;
+    viewStaffSchedules();
+    return STATUS_OK;
+}
+
+int batchListAppointments(char **arguments, int *newID) {
+    (void)newID;
+    int fromDate, toDate;
+    if (!batchDateLimit(arguments[1], INT_MIN, &fromDate) || !batchDateLimit(arguments[2], INT_MAX, &toDate)) {
+        return STATUS_SYNTAX;
+    }
+    int doctorID = -1;
+    if (strcmp(arguments[0], "*") != 0 && (doctorID = batchDoctor(arguments[0])) == -1) {
+        return STATUS_NOT_FOUND;
+    }
+    listAppointments(doctorID, fromDate, toDate);
+    return STATUS_OK;
+}
+
+int batchPatientAppointments(char **arguments, int *newID) {
+    (void)newID;
+    int fromDate, toDate;
+    if (!batchDateLimit(arguments[1], INT_MIN, &fromDate) || !batchDateLimit(arguments[2], INT_MAX, &toDate)) {
+        return STATUS_SYNTAX;
+    }
+    int patientID = batchPatient(arguments[0]);
+    if (patientID == -1) {
+        return STATUS_NOT_FOUND;
+    }
+    listPatientAppointments(patientID, fromDate, toDate);
+    return STATUS_OK;
+}
+
+// Function to check that a batch command may use a file
+
+/**
+ * @brief Returns 1 if a command may read or write the file at 'path'. A client of the 
+ * server may not name files at all, since the server would open them with its own 
+ * permissions; it may only have bill-all write to its own connection ("-").
+ */
+
+int batchFileAllowed(const char *path, int writing) {
+#ifndef _WIN32
+    if (server.running) {
+        return writing && strcmp(path, "-") == 0;
+    }
+#endif
+    (void)path;
+    (void)writing;
+    return 1;
+}
+
+int batchImport(char **arguments, int *newID) {
+    (void)newID;
+    if (!batchFileAllowed(arguments[1], 0)) {
+        return STATUS_INVALID;
+    }
+    int kind = parseImportKind(arguments[0]);
+    if (kind == -1) {
+        return STATUS_SYNTAX;
+    }
+    int imported, rejected;
+    int status = importCSV((ImportKind)kind, arguments[1], &imported, &rejected);
+    if (status == STATUS_OK) {
+        batchReply("Imported %d %s, rejected %d line(s).\n", imported, importKindNames[kind], rejected);
+    }
+    return status;
+}
+
+int batchBillAll(char **arguments, int *newID) {
+    (void)newID;
+    int billed;
+    long long total;
+    if (!batchFileAllowed(arguments[0], 1)) {
+        return STATUS_INVALID;
+    }
+    int status = billAllPatients(arguments[0], &billed, &total);
+    if (status == STATUS_OK) {
+        batchReply("Billed %d patient(s), %lld in total.\n", billed, total);
+    }
+    return status;
+}
+
+int batchOnMedication(char **arguments, int *newID) {
+    (void)newID;
+    return listMedicationPatients(arguments[0]);
+}
+
+// Function to parse the arguments of the patient query commands
+int batchQuery(char **arguments, PatientQuery *query) {
+    if (!parseQueryLimit(arguments[0], INT_MIN, &query->minAge) || !parseQueryLimit(arguments[1], INT_MAX, &query->maxAge) ||
+        !parseQueryLimit(arguments[2], INT_MIN, &query->minRoom) || !parseQueryLimit(arguments[3], INT_MAX, &query->maxRoom)) {
+        return STATUS_SYNTAX;
+    }
+    query->doctorID = -1;
+    if (strcmp(arguments[4], "*") != 0 && (query->doctorID = batchDoctor(arguments[4])) == -1) {
+        return STATUS_NOT_FOUND;
+    }
+    return STATUS_OK;
+}
+
+int batchQueryPatients(char **arguments, int *newID) {
+    (void)newID;
+    PatientQuery query;
+    int status = batchQuery(arguments, &query);
+    return status != STATUS_OK ? status : listQueryPatients(&query);
+}
+
+int batchCountPatients(char **arguments, int *newID) {
+    (void)newID;
+    PatientQuery query;
+    int status = batchQuery(arguments, &query);
+    if (status != STATUS_OK) {
+        return status;
+    }
+    int count = countPatients(&query);
+    if (count < 0) {
+        return STATUS_NO_MEMORY;
+    }
+    batchReply("Matched %d patient(s).\n", count);
+    return STATUS_OK;
+}
+
+int batchSearch(char **arguments, int *newID) {
+    (void)newID;
+    int field = parseSearchName(arguments[0], searchFieldNames, SEARCH_FIELD_COUNT);
+    int mode = parseSearchName(arguments[1], searchModeNames, SEARCH_MODE_COUNT);
+    if (field == -1 || mode == -1) {
+        return STATUS_SYNTAX;
+    }
+    return listSearchResults(field, mode, arguments[2]);
+}
+
+int batchFreeRoom(char **arguments, int *newID) {
+    (void)newID;
+    int room = findFreeRoomOfClass(arguments[0]);
+    if (room < 0) {
+        return room == -3 ? STATUS_NO_MEMORY : room == -2 ? STATUS_NOT_FOUND : STATUS_OCCUPIED;
+    }
+    batchReply("Room %d has a free bed.\n", room);
+    return STATUS_OK;
+}
+
+int batchOccupancy(char **arguments, int *newID) {
+    (void)arguments, (void)newID;
+    return listRoomOccupancy();
+}
+
+int batchSave(char **arguments, int *newID) {
+    (void)arguments, (void)newID;
+    return saveData() ? STATUS_OK : STATUS_IO_ERROR;
+}
+
+// Table of the batch commands, with the number of arguments each one takes and how it uses the data
+const BatchCommand batchCommands[] = {
+    {"add-doctor", 4, BATCH_WRITE, batchAddDoctor},
+    {"add-patient", 5, BATCH_WRITE, batchAddPatient},
+    {"assign-med", 3, BATCH_WRITE, batchAssignMedication},
+    {"remove-patient", 1, BATCH_WRITE, batchRemovePatient},
+    {"schedule", 4, BATCH_WRITE, batchSchedule},
+    {"add-staff", 3, BATCH_WRITE, batchAddStaff},
+    {"add-shift", 5, BATCH_WRITE, batchAddShift},
+    {"output", 3, BATCH_SESSION, batchOutput},
+    {"list-doctors", 0, BATCH_READ, batchListDoctors},
+    {"list-patients", 0, BATCH_READ, batchListPatients},
+    {"list-staff", 0, BATCH_READ, batchListStaff},
+    {"list-appointments", 3, BATCH_READ, batchListAppointments},
+    {"patient-appointments", 3, BATCH_READ, batchPatientAppointments},
+    {"import", 2, BATCH_WRITE, batchImport},
+    {"bill-all", 1, BATCH_WRITE, batchBillAll},
+    {"on-medication", 1, BATCH_READ, batchOnMedication},
+    {"query-patients", 5, BATCH_READ, batchQueryPatients},
+    {"count-patients", 5, BATCH_READ, batchCountPatients},
+    {"search", 3, BATCH_READ, batchSearch},
+    {"free-room", 1, BATCH_READ, batchFreeRoom},
+    {"occupancy", 0, BATCH_READ, batchOccupancy},
+    {"save", 0, BATCH_WRITE, batchSave}
+};
+#define BATCH_COMMAND_COUNT (int)(sizeof(batchCommands) / sizeof(batchCommands[0]))
+
+// Function to write a line of a batch command's reply
+void batchReply(const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    vfprintf(output.stream != NULL ? output.stream : stdout, format, arguments);
+    va_end(arguments);
+}
+
+// Function to run one command of a batch file
+
+/**
+ * @brief Runs the command on one line and writes its status line.
+ * 
+ * 'line' is NULL for a line that was too long to read. In server mode the command 
+ * runs under the server's lock (see serverBegin).
+ * 
+ * @return The Status of the command, or -1 for a blank line or comment.
+ */
+
+int runBatchLine(char *line, int lineNumber) {
+    char *tokens[BATCH_MAX_TOKENS];
+    int tokenCount = line != NULL ? batchTokenize(line, tokens, BATCH_MAX_TOKENS) : -1;
+    if (tokenCount == 0) {
+        return -1;  // Blank line or comment
+    }
+
+    int status = STATUS_SYNTAX, newID = -1;
+    const char *name = tokenCount > 0 ? tokens[0] : "?";
+    for (int i = 0; i < BATCH_COMMAND_COUNT && tokenCount > 0; i++) {
+        const BatchCommand *command = &batchCommands[i];
+        if (strcmp(command->name, name) == 0) {
+            if (tokenCount - 1 == command->argumentCount) {
+                long long started = statsStart();
+#ifdef _WIN32
+                status = command->run(tokens + 1, &newID);
+                statsRecord(STATS_BATCH_FIRST + i, "batch", command->name, started);
+#else
+                serverBegin(command->access);
+                status = command->run(tokens + 1, &newID);
+                serverEnd(command->access, STATS_BATCH_FIRST + i, command->name, started);
+#endif
+            }
+            break;
+        }
+    }
+
+    if (newID >= 0) {
+        batchReply("%d %s %s id=%d\n", lineNumber, statusNames[status], name, newID);
+    } else {
+        batchReply("%d %s %s\n", lineNumber, statusNames[status], name);
+    }
+    return status;
+}
+
+// Function to run a batch file
+
+/**
+ * @brief Runs every command of a batch file and prints a status line for each.
+ * 
+ * The data must already be loaded and the journal open. A failing command does not stop 
+ * the batch; its status line tells what went wrong.
+ * 
+ * @return The number of commands that did not succeed.
+ */
+
+int runBatch(FILE *file) {
+    static BatchReader reader;  // Too large for the stack
+    char *line;
+    int failures = 0, commands = 0, result;
+
+    memset(&reader, 0, sizeof(reader));
+    reader.file = file;
+    while ((result = batchReadLine(&reader, &line)) != 0) {
+        int status = runBatchLine(result == 1 ? line : NULL, reader.lineNumber);
+        if (status == -1) {
+            continue;
+        }
+        if (status != STATUS_OK) {
+            failures++;
+        }
+        if (++commands % BATCH_COMMIT_INTERVAL == 0) {
+            journalIdle();  // Group the journal writes of many commands
+            compactPatientsIdle();
+        }
+    }
+    if (ferror(file)) {
+        printf("%d %s read\n", reader.lineNumber, statusNames[STATUS_IO_ERROR]);
+        failures++;
+    }
+    journalIdle();
+    appointmentStoreSync();
+    fflush(stdout);
+    return failures;
+}
+
+#ifndef _WIN32
+// Functions of the benchmark mode
+
+/*
+ * Functions of the benchmark mode, which measures every operation on synthetic data.
+ * Started with 'hospital --bench PATIENTS [SEED]'. The benchmark works in a new directory
+ * "hospital-bench-XXXXXX" inside the current one, so saved data is never touched, and removes
+ * it at the end. It generates PATIENTS patients and appointments, one doctor and one staff member
+ * per BENCH_PER_DOCTOR patients (at least 10 of each) and BENCH_SHIFTS_PER_STAFF shifts per staff member,
+ * all through the same insert functions as the menu, then times:
+ * - addPatientLookup: The two name lookups made by addPatient (doctor and duplicate patient).
+ * - sortDoctorsByName / sortPatientsByAge: The sorts behind the sorted listings.
+ * - calculateBill, billAllPatients (to stdout), generateReport, saveData and removePatient (deletePatient).
+ * - saveDataBackground: The pause before a background save carries on in its own process.
+ * - loadData: Run in a fresh process, forked before any data was loaded, so it starts from scratch.
+ * Each operation is reported as one record through the output layer (JSON lines unless another format
+ * is chosen), with the count, total seconds, operations per second, median and 99th percentile latency
+ * in microseconds, and the peak resident set size so far in kilobytes. Messages printed by the
+ * operations themselves are discarded while the benchmark runs.
+ */
+
+// Function to get the current time for the benchmark
+long long benchNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Function to get the next pseudo-random number of the benchmark (xorshift, repeatable for a seed)
+unsigned int benchRandom() {
+    benchSeed ^= benchSeed << 13;
+    benchSeed ^= benchSeed >> 17;
+    benchSeed ^= benchSeed << 5;
+    return benchSeed;
+}
+
+// Function to compare two latency samples
+int compareSamples(const void *first, const void *second) {
+    long long a = *(const long long *)first, b = *(const long long *)second;
+    return (a > b) - (a < b);
+}
+
+// Function to start timing a benchmark operation
+
+/**
+ * @brief Starts timing 'expected' calls of an operation, allocating room for their latencies.
+ * 
+ * @return 1 on success, 0 if memory ran out (the operation is then skipped).
+ */
+
+int benchBegin(BenchResult *result, const char *name, int expected) {
+    memset(result, 0, sizeof(BenchResult));
+    result->name = name;
+    result->samples = malloc((expected > 0 ? expected : 1) * sizeof(long long));
+    return result->samples != NULL;
+}
+
+// Function to record the latency of one call of a benchmark operation
+void benchSample(BenchResult *result, long long start) {
+    long long elapsed = benchNow() - start;
+    result->samples[result->count++] = elapsed;
+    result->total += elapsed;
+}
+
+// Function to finish timing a benchmark operation
+
+/**
+ * @brief Computes the percentiles of an operation's latencies and records the peak RSS so far.
+ */
+
+void benchEnd(BenchResult *result) {
+    struct rusage usage;
+    if (result->count > 0) {
+        qsort(result->samples, result->count, sizeof(long long), compareSamples);
+        result->p50 = result->samples[(result->count - 1) / 2];
+        result->p99 = result->samples[(int)((result->count - 1) * 0.99)];
+    }
+    free(result->samples);
+    result->samples = NULL;
+    getrusage(RUSAGE_SELF, &usage);
+    if (result->peakRss < usage.ru_maxrss) {
+        result->peakRss = usage.ru_maxrss;
+    }
+}
+
+// Function to run the process that loads data for the benchmark
+
+/**
+ * @brief Runs in a process forked before any data was loaded: for each byte read from 'requests', 
+ *        forks a child that times loadData and writes the seconds taken and its peak RSS to 'results'.
+ */
+
+void benchLoader(int requests, int results) {
+    char request;
+    while (read(requests, &request, 1) == 1) {
+        pid_t child = fork();
+        if (child == 0) {
+            struct rusage usage;
+            long long start = benchNow();
+            loadData();
+            long long sample[2] = {benchNow() - start, 0};
+            getrusage(RUSAGE_SELF, &usage);
+            sample[1] = usage.ru_maxrss;
+            if (write(results, sample, sizeof(sample)) != sizeof(sample)) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+        if (child > 0) {
+            waitpid(child, NULL, 0);
+        } else {
+            long long failed[2] = {-1, 0};
+            if (write(results, failed, sizeof(failed)) != sizeof(failed)) {
+                break;
+            }
+        }
+    }
+    _exit(0);
+}
+
+// Function to write the results of the benchmark
+
+/**
+ * @brief Writes one record per timed operation through the output layer.
+ */
+
+void benchReport(const BenchResult *results, int resultCount, const char *title) {
+    outputBegin();
+    outputText("\n----- %s -----\n", title);
+    for (int i = 0; i < resultCount; i++) {
+        const BenchResult *result = &results[i];
+        char number[32];
+        if (!outputRecordBegin()) {
+            outputRecordEnd();
+            continue;
+        }
+        outputField("op", "Operation", result->name);
+        outputInt("count", "Count", result->count);
+        sprintf(number, "%.6f", result->total / 1e9);
+        outputNumber("seconds", "Seconds", number);
+        sprintf(number, "%.1f", result->total > 0 ? result->count * 1e9 / result->total : 0.0);
+        outputNumber("opsPerSec", "Operations per Second", number);
+        sprintf(number, "%.3f", result->p50 / 1e3);
+        outputNumber("p50Micros", "Median Latency (us)", number);
+        sprintf(number, "%.3f", result->p99 / 1e3);
+        outputNumber("p99Micros", "99th Percentile Latency (us)", number);
+        sprintf(number, "%ld", result->peakRss);
+        outputNumber("peakRssKB", "Peak RSS (KB)", number);
+        outputRecordEnd();
+    }
+    outputEnd();
+}
+
+// Function to run the benchmark
+
+/**
+ * @brief Generates synthetic data, times every operation and reports the results.
+ * 
+ * @return 0 on success, 1 if the benchmark could not be set up.
+ */
+
+int runBenchmark(int patients, unsigned int seed) {
+    char directory[] = "hospital-bench-XXXXXX";
+    int doctors = patients / BENCH_PER_DOCTOR > 10 ? patients / BENCH_PER_DOCTOR : 10;
+    int staff = doctors;
+    BenchResult results[BENCH_MAX_RESULTS];
+    int resultCount = 0;
+    char name[64];
+
+    benchSeed = seed != 0 ? seed : 1;
+    if (mkdtemp(directory) == NULL || chdir(directory) != 0) {
+        fprintf(stderr, "Could not create a directory for the benchmark.\n");
+        return 1;
+    }
+
+    // Discard what the operations print; the results go to the real stdout at the end
+    fflush(stdout);
+    int realStdout = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    if (realStdout < 0 || devNull < 0) {
+        fprintf(stderr, "Could not redirect the output of the benchmark.\n");
+        return 1;
+    }
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+
+    // Fork the loader before loading anything, so each loadData it times starts from scratch
+    int requestPipe[2], resultPipe[2];
+    if (pipe(requestPipe) != 0 || pipe(resultPipe) != 0) {
+        fprintf(stderr, "Could not create the pipes of the benchmark.\n");
+        return 1;
+    }
+    pid_t loader = fork();
+    if (loader == 0) {
+        close(requestPipe[1]);
+        close(resultPipe[0]);
+        benchLoader(requestPipe[0], resultPipe[1]);
+    }
+    close(requestPipe[0]);
+    close(resultPipe[1]);
+
+    loadData();
+    journalOpen();
+
+    // Generate the data, timing each kind of insert
+    BenchResult *result = &results[resultCount++];
+    if (benchBegin(result, "insertDoctor", doctors)) {
+        for (int i = 0; i < doctors; i++) {
+            sprintf(name, "Doctor%d", i);
+            long long start = benchNow();
+            insertDoctor(name, 30 + benchRandom() % 40, benchSpecialties[benchRandom() % 4], 50 + benchRandom() % 500);
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "insertPatient", patients)) {
+        for (int i = 0; i < patients; i++) {
+            sprintf(name, "Patient%d", i);
+            long long start = benchNow();
+            insertPatient(name, benchRandom() % 100, benchDiagnoses[benchRandom() % 4], i,  // One patient per room
+                benchRandom() % doctors, currentDate());
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "insertStaff", staff)) {
+        for (int i = 0; i < staff; i++) {
+            sprintf(name, "Staff%d", i);
+            long long start = benchNow();
+            insertStaff(name, benchRoles[benchRandom() % 3], "555-0100");
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "insertShift", staff * BENCH_SHIFTS_PER_STAFF)) {
+        for (int i = 0; i < staff * BENCH_SHIFTS_PER_STAFF; i++) {
+            int startTime = (benchRandom() % 16) * 60;
+            long long start = benchNow();
+            insertShift(i / BENCH_SHIFTS_PER_STAFF, benchRandom() % 7, startTime, startTime + 8 * 60,
+                benchRoles[benchRandom() % 3]);
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    // Appointment 'i' goes to doctor i % doctors, in a slot no earlier appointment has taken
+    result = &results[resultCount++];
+    if (benchBegin(result, "insertAppointment", patients)) {
+        int firstDay = daysFromCivil(2026, 1, 1);
+        for (int i = 0; i < patients; i++) {
+            int turn = i / doctors;
+            long long start = benchNow();
+            insertAppointment(benchRandom() % patients, i % doctors, firstDay + turn / CALENDAR_SLOTS, turn % CALENDAR_SLOTS);
+            benchSample(result, start);
+        }
+        appointmentStoreSync();
+        benchEnd(result);
+    }
+    journalCommit();
+
+    // Time the operations on the generated data
+    result = &results[resultCount++];
+    if (benchBegin(result, "addPatientLookup", patients)) {
+        for (int i = 0; i < patients; i++) {
+            char doctorName[64];
+            sprintf(doctorName, "Doctor%u", benchRandom() % doctors);
+            sprintf(name, "Patient%u", benchRandom() % (2 * patients));  // Half of the names are new
+            long long start = benchNow();
+            nameIndexFind(&doctorNameIndex, doctorName);
+            nameIndexFind(&patientNameIndex, name);
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    int doctorKeys[] = {DOCTOR_KEY_NAME}, patientKeys[] = {PATIENT_KEY_AGE};
+    result = &results[resultCount++];
+    if (benchBegin(result, "sortDoctorsByName", BENCH_REPEAT)) {
+        for (int i = 0; i < BENCH_REPEAT; i++) {
+            long long start = benchNow();
+            free(sortRecordOrder(doctorCount, compareDoctors, doctorKeys, 1));
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "sortPatientsByAge", BENCH_REPEAT)) {
+        for (int i = 0; i < BENCH_REPEAT; i++) {
+            long long start = benchNow();
+            free(sortRecordOrder(patientSlotCount, comparePatients, patientKeys, 1));
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "calculateBill", patientSlotCount)) {
+        volatile int total = 0;
+        for (int i = 0; i < patientSlotCount; i++) {
+            long long start = benchNow();
+            total += calculateBill(patientAt(i));
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "billAllPatients", BENCH_REPEAT)) {
+        for (int i = 0; i < BENCH_REPEAT; i++) {
+            int billed;
+            long long total, start = benchNow();
+            billAllPatients("-", &billed, &total);
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "countPatients", BENCH_REPEAT)) {
+        PatientQuery query = {20, 60, 100, 499, -1};
+        volatile int matched = 0;
+        for (int i = 0; i < BENCH_REPEAT; i++) {
+            query.doctorID = i % 2 == 0 ? -1 : (int)(benchRandom() % doctors);
+            long long start = benchNow();
+            matched += countPatients(&query);
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "searchPatients", BENCH_SEARCHES)) {
+        for (int i = 0; i < BENCH_SEARCHES; i++) {
+            int *keys;
+            sprintf(name, "ATIENT%u", benchRandom() % patients);  // Matches the IDs that start with the number
+            long long start = benchNow();
+            searchRecords(SEARCH_PATIENT_NAME, SEARCH_ICONTAINS, name, &keys);
+            benchSample(result, start);
+            free(keys);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "generateReport", BENCH_REPEAT)) {
+        for (int i = 0; i < BENCH_REPEAT; i++) {
+            long long start = benchNow();
+            generateReport();
+            fflush(stdout);
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "saveData", BENCH_REPEAT)) {
+        for (int i = 0; i < BENCH_REPEAT; i++) {
+            long long start = benchNow();
+            saveData();
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "saveDataBackground", BENCH_REPEAT)) {
+        for (int i = 0; i < BENCH_REPEAT; i++) {
+            long long start = benchNow();
+            saveDataBackground();  // Timed until the snapshot is taken, which is all the caller waits for
+            benchSample(result, start);
+            saveWait();
+        }
+        benchEnd(result);
+    }
+
+    result = &results[resultCount++];
+    if (benchBegin(result, "loadData", BENCH_REPEAT)) {
+        long loaderRss = 0;
+        for (int i = 0; i < BENCH_REPEAT; i++) {
+            long long sample[2];
+            if (write(requestPipe[1], "L", 1) != 1 || read(resultPipe[0], sample, sizeof(sample)) != sizeof(sample) ||
+                sample[0] < 0) {
+                break;
+            }
+            result->samples[result->count++] = sample[0];
+            result->total += sample[0];
+            if (loaderRss < sample[1]) {
+                loaderRss = sample[1];
+            }
+        }
+        benchEnd(result);
+        result->peakRss = loaderRss;  // Report the peak RSS of the loading processes instead
+    }
+    close(requestPipe[1]);
+    waitpid(loader, NULL, 0);
+
+    int removals = patients / 10 > 0 ? patients / 10 : 1;
+    result = &results[resultCount++];
+    if (benchBegin(result, "removePatient", removals)) {
+        for (int i = 0; i < removals; i++) {
+            int patientID = benchRandom() % patients;
+            long long start = benchNow();
+            deletePatient(patientID);  // IDs already removed are looked up and refused
+            benchSample(result, start);
+        }
+        benchEnd(result);
+    }
+
+    // Clean up the benchmark directory and report to the real stdout
+    journalClose();
+    appointmentStoreClose();
+    const char *files[] = {"doctors.dat", "patients.dat", "staff.dat", JOURNAL_FILE, APPOINTMENT_STORE_FILE};
+    for (int i = 0; i < 5; i++) {
+        remove(files[i]);
+    }
+    if (chdir("..") == 0) {
+        rmdir(directory);
+    }
+    fflush(stdout);
+    dup2(realStdout, STDOUT_FILENO);
+    close(realStdout);
+
+    char title[64];
+    snprintf(title, sizeof(title), "Benchmark Results (%d patients)", patients);
+    benchReport(results, resultCount, title);
+    return 0;
+}
+#endif
+
+#ifndef _WIN32
+// Functions of the server mode
 
 /*
- * Function to view the schedules of all staff members.
- * This function iterates through all staff members and displays:
- * - Staff member's name and role
- * - Contact information
- * - The shifts assigned to the staff member (day, start time, end time, and role)
- * If no shifts are assigned to a staff member, it will print a message indicating that.
- * If no staff members are available, a message is displayed.
+ * Functions of the server mode, which serves many clients at once over a local Unix-domain socket.
+ * Started with 'hospital --serve SOCKET [THREADS]'. Each client sends batch commands, one per line, and
+ * gets back what the command writes followed by its status line, exactly as in batch mode; 'output'
+ * settings apply to the client's own session.
+ * - The main thread accepts connections and polls every idle client. A client whose command line has
+ *   arrived is queued to THREADS worker threads (one per core by default); a worker runs the client's
+ *   whole lines (up to SERVER_LINE_BUDGET) and hands it back, so any number of clients share the workers.
+ * - Commands that only read run under a shared lock, so views of the data run in parallel on all
+ *   workers; commands that change data take the lock exclusively (see runBatchLine).
+ * - After each change, and still holding the lock, every index that is built on first use is built
+ *   (serverPrepareReads), so commands that only read never change anything. The journal is then
+ *   committed before the reply is sent, with one fsync for all the changes waiting and without
+ *   holding the data lock (serverCommit), which is also where checkpoints and autosaves start.
+ * - Clients may not name files: import is refused with INVALID, and bill-all only takes '-', which
+ *   writes the invoices to the client's own connection (batchFileAllowed).
+ * - SIGINT or SIGTERM stops the server once the running command has finished.
  */
 
-void viewStaffSchedules() {
-    if (staffCount == 0) {
-        printf("No staff members found.\n");
+// Function to take the server's lock for a command
+void serverBegin(int access) {
+    if (!server.running || access == BATCH_SESSION) {
         return;
     }
+    if (access == BATCH_READ) {
+        pthread_rwlock_rdlock(&server.lock);
+        if (!server.readsExclusive) {
+            return;
+        }
+        pthread_rwlock_unlock(&server.lock);  // Some index is not built, so building it must not race
+    }
+    pthread_rwlock_wrlock(&server.lock);
+}
 
-    for (int i = 0; i < staffCount; i++) {
-        printf("\nStaff Member: %s (%s)\n", staff[i].name, staff[i].role);
-        printf("Contact Info: %s\n", staff[i].contactInfo);
-        printf("Assigned Shifts:\n");
+// Function to finish a command in server mode
 
-        // Check if the staff member has any assigned shifts
-        if (staff[i].shiftCount == 0) {
-            printf("  No shifts assigned.\n");
-        } else {
-            for (int j = 0; j < staff[i].shiftCount; j++) {
-                printf("  Day: %s, Shift: %s to %s, Role: %s\n", 
-                    staff[i].schedule[j].day, 
-                    staff[i].schedule[j].startTime, 
-                    staff[i].schedule[j].endTime, 
-                    staff[i].schedule[j].role);
+/**
+ * @brief Releases the lock taken by serverBegin and records the command's statistics. 
+ * A command that changed data first builds the indexes for the reads, releases the 
+ * lock, and then waits until its journal records are on disk (serverCommit).
+ */
+
+void serverEnd(int access, int slot, const char *name, long long started) {
+    if (!server.running) {
+        statsRecord(slot, "batch", name, started);
+        return;
+    }
+    unsigned int sequence = journal.nextSequence;  // Records before this one must be on disk before the reply
+    if (access == BATCH_WRITE) {
+        compactPatientsIdle();
+        server.readsExclusive = !serverPrepareReads();
+    }
+    if (access != BATCH_SESSION) {
+        pthread_rwlock_unlock(&server.lock);
+    }
+    if (access == BATCH_WRITE) {
+        serverCommit(sequence);
+    }
+    pthread_mutex_lock(&server.statsLock);
+    statsRecord(slot, "batch", name, started);
+    pthread_mutex_unlock(&server.statsLock);
+}
+
+// Function to make the changes of a command durable
+
+/**
+ * @brief Commits the journal up to 'sequence', sharing one commit among all the writers waiting for it.
+ * 
+ * Writers queue on 'commitLock' after releasing the data lock, so while one of 
+ * them commits, others finish their commands and add records. The next one to get 
+ * 'commitLock' then commits all those records with a single fsync, and the rest 
+ * find their records already on disk and return at once.
+ * 
+ * The data lock is only held to move the pending records into the journal's 
+ * 'committing' buffer and to flush the appointment store; the fsyncs run under the 
+ * journal's lock alone, which is taken before the data lock is released so that no 
+ * later record can reach the file first. A checkpoint or autosave that is due then takes the data lock again 
+ * just long enough to fork.
+ */
+
+void serverCommit(unsigned int sequence) {
+    pthread_mutex_lock(&server.commitLock);
+    if ((int)(sequence - server.committedSequence) <= 0) {
+        pthread_mutex_unlock(&server.commitLock);
+        return;
+    }
+
+    pthread_rwlock_wrlock(&server.lock);
+    journalLock();
+    size_t length = journal.pendingBytes;
+    memcpy(journal.committing, journal.pending, length);
+    journal.pendingBytes = 0;
+    unsigned int committed = journal.nextSequence;
+    int appointments = -1;
+    if (appointmentStore.file != NULL && appointmentStore.unsynced) {
+        fflush(appointmentStore.file);
+        appointments = dup(fileno(appointmentStore.file));  // Stays valid if the store is reopened
+        appointmentStore.unsynced = 0;
+    }
+    pthread_rwlock_unlock(&server.lock);
+
+    journalWrite(journal.committing, length);
+    if (appointments >= 0) {
+        fsync(appointments);
+        close(appointments);
+    }
+    server.committedSequence = committed;
+    saveCollect();
+    int due = saveDue();
+    journalUnlock();
+
+    if (due) {
+        pthread_rwlock_wrlock(&server.lock);
+        if (saveDue()) {
+            saveDataBackground();
+            saveState.started = statsNow();  // As in saveIdle, even if it failed
+            server.readsExclusive = !serverPrepareReads();  // Compaction can leave indexes to rebuild
+        }
+        pthread_rwlock_unlock(&server.lock);
+    }
+    pthread_mutex_unlock(&server.commitLock);
+}
+
+// Function to build every index the commands that only read may use
+
+/**
+ * @brief Builds the name, ID, appointment, column, text, room and medication indexes if they are stale,
+ * and sorts the medication lists so that listing them only reads.
+ * 
+ * Called with the lock held exclusively, so that commands holding the shared lock 
+ * find every index ready and never rebuild one at the same time as each other.
+ * 
+ * @return 1 if every index is ready, 0 if memory ran out (commands that read then 
+ * run exclusively until a later change succeeds).
+ */
+
+int serverPrepareReads() {
+    NameIndex *nameIndexes[] = {&doctorNameIndex, &patientNameIndex, &staffNameIndex, &roleNameIndex,
+                                &medicationNameIndex, &dosageIndex};
+    int ready = 1;
+    for (int i = 0; i < (int)(sizeof(nameIndexes) / sizeof(nameIndexes[0])); i++) {
+        if (nameIndexes[i]->stale) {
+            nameIndexRebuild(nameIndexes[i]);
+        }
+        ready &= !nameIndexes[i]->stale;
+    }
+    ready &= patientIDMapReady();
+    AppointmentIndex *appointmentIndexes[] = {&doctorAppointmentIndex, &patientAppointmentIndex};
+    for (int i = 0; i < 2; i++) {
+        ready &= !appointmentIndexes[i]->stale || appointmentIndexRebuild(appointmentIndexes[i]);
+    }
+    ready &= !doctorCalendar.stale || calendarRebuild();
+    ready &= patientColumnsReady();
+    for (int i = 0; i < SEARCH_FIELD_COUNT; i++) {
+        ready &= textIndexReady(&textIndexes[i]);
+    }
+    ready &= roomInventoryReady();
+    if (medicationIndexReady()) {
+        for (int i = 0; i < medicationIndex.listCount; i++) {
+            if (!medicationIndex.lists[i].sorted) {
+                medicationIndexSort(&medicationIndex.lists[i]);
             }
         }
+    } else {
+        ready = 0;
     }
+    return ready;
 }
 
-// Function to remove a patient and display their bill before removal
+// Function to stop the server from a signal handler
+void serverStop(int signal) {
+    (void)signal;
+    server.stopping = 1;
+}
+
+// Function to start the session of a new client
+ServerSession *serverSessionOpen(int client) {
+    ServerSession *session = calloc(1, sizeof(ServerSession));  // Pages of the reader's buffer are only touched as it fills
+    int writer = dup(client);
+    FILE *stream = writer >= 0 ? fdopen(writer, "w") : NULL;
+    if (session == NULL || stream == NULL) {
+        if (stream != NULL) {
+            fclose(stream);
+        } else if (writer >= 0) {
+            close(writer);
+        }
+        free(session);
+        return NULL;
+    }
+    session->fd = client;
+    session->stream = stream;
+    session->format = OUTPUT_TEXT;  // Start with the default output settings
+    session->reader.fd = client;
+    session->reader.nonblocking = 1;
+    return session;
+}
+
+// Function to end the session of a client
+void serverSessionClose(ServerSession *session) {
+    fclose(session->stream);
+    close(session->fd);
+    free(session);
+}
+
+// Function to run the commands a client has sent
+
+/**
+ * @brief Runs the whole command lines a client has sent, up to SERVER_LINE_BUDGET of them.
+ * 
+ * The commands are read straight from the socket without waiting, so the worker 
+ * moves on as soon as the client has nothing more to run, and the reply is flushed 
+ * after each command. The session's output settings are restored for the commands 
+ * and kept for its next ones.
+ * 
+ * @return 1 if the client is still connected, or 0 once it has gone.
+ */
+
+int serveClient(ServerSession *session) {
+    output.format = session->format;
+    output.offset = session->offset;
+    output.limit = session->limit;
+    output.stream = session->stream;
+
+    char *line;
+    int result = 1, lines = 0;
+    while (lines < SERVER_LINE_BUDGET && (result = batchReadLine(&session->reader, &line)) != 0 && result != -2) {
+        runBatchLine(result == 1 ? line : NULL, session->reader.lineNumber);
+        outputFlush();
+        lines++;
+        if (ferror(session->stream)) {
+            result = 0;  // The client has gone
+            break;
+        }
+    }
+    session->format = output.format;
+    session->offset = output.offset;
+    session->limit = output.limit;
+    session->ready = lines == SERVER_LINE_BUDGET && result != 0;
+    output.stream = NULL;
+    return result != 0;
+}
+
+// Function to queue a client with commands for the workers
+void serverQueue(ServerSession *session) {
+    pthread_mutex_lock(&server.queueLock);
+    while (server.queueCount == SERVER_QUEUE_SIZE) {
+        pthread_cond_wait(&server.queueFree, &server.queueLock);
+    }
+    server.queue[(server.queueStart + server.queueCount) % SERVER_QUEUE_SIZE] = session;
+    server.queueCount++;
+    pthread_cond_signal(&server.queueReady);
+    pthread_mutex_unlock(&server.queueLock);
+}
+
+// Function to take back a client from a worker
+
+/**
+ * @brief Called by the main thread for each client a worker hands back: closes it if it 
+ * has gone, queues it again at once if it ran out of budget with lines left, and 
+ * otherwise polls it for input again.
+ */
+
+void serverReturn(ServerSession *session) {
+    if (session->closing) {
+        serverSessionClose(session);
+        server.clientCount--;
+    } else if (session->ready) {
+        serverQueue(session);
+    } else {
+        server.idle[server.idleCount++] = session;
+    }
+}
+
+// Function run by each worker thread of the server
+void *serverWorker(void *argument) {
+    (void)argument;
+    while (1) {
+        pthread_mutex_lock(&server.queueLock);
+        while (server.queueCount == 0) {
+            pthread_cond_wait(&server.queueReady, &server.queueLock);
+        }
+        ServerSession *session = server.queue[server.queueStart];
+        server.queueStart = (server.queueStart + 1) % SERVER_QUEUE_SIZE;
+        server.queueCount--;
+        pthread_cond_signal(&server.queueFree);
+        pthread_mutex_unlock(&server.queueLock);
+
+        session->closing = !serveClient(session);
+        long written;  // A pointer is far below PIPE_BUF, so it is written whole
+        do {
+            written = write(server.wake[1], &session, sizeof(session));
+        } while (written < 0 && errno == EINTR);
+    }
+    return NULL;
+}
+
+// Function to run the server
+
+/**
+ * @brief Listens on a Unix-domain socket at 'path' and serves clients with 'threads' 
+ * worker threads until a signal stops it. The data must already be loaded and the journal open.
+ * 
+ * @return 0 after a clean stop, 1 if the server could not be started.
+ */
+
+int runServer(const char *path, int threads) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "The socket path %s is too long.\n", path);
+        return 1;
+    }
+    strcpy(address.sun_path, path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);  // Left behind by a server that did not stop cleanly
+    if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener, SERVER_QUEUE_SIZE) != 0) {
+        fprintf(stderr, "Could not listen on %s.\n", path);
+        return 1;
+    }
+    if (pipe(server.wake) != 0) {
+        fprintf(stderr, "Could not create the server's pipe.\n");
+        return 1;
+    }
+
+    // Prefer waiting writers, so a steady stream of reads cannot hold off changes forever
+    pthread_rwlockattr_t attributes;
+    pthread_rwlockattr_init(&attributes);
+#ifdef __GLIBC__
+    pthread_rwlockattr_setkind_np(&attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&server.lock, &attributes);
+    pthread_mutex_init(&server.statsLock, NULL);
+    pthread_mutex_init(&server.commitLock, NULL);
+    server.committedSequence = journal.nextSequence;
+    pthread_mutex_init(&server.queueLock, NULL);
+    pthread_cond_init(&server.queueReady, NULL);
+    pthread_cond_init(&server.queueFree, NULL);
+    server.readsExclusive = !serverPrepareReads();
+    server.running = 1;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = serverStop;  // Without SA_RESTART, so accept returns when a signal arrives
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);  // A client that disconnects shows up as a write error instead
+
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, serverWorker, NULL) == 0) {
+            pthread_detach(thread);
+            started++;
+        }
+    }
+    if (started == 0) {
+        fprintf(stderr, "Could not start the worker threads.\n");
+        return 1;
+    }
+    printf("Serving on %s with %d worker thread(s).\n", path, started);
+    fflush(stdout);
+
+    static struct pollfd polls[SERVER_MAX_CLIENTS + 2];
+    while (!server.stopping) {
+        // Wait for a client handed back, a new connection or a command from an idle client
+        int count = 0;
+        polls[count].fd = server.wake[0];
+        polls[count++].events = POLLIN;
+        int accepting = server.clientCount < SERVER_MAX_CLIENTS;  // Otherwise new clients wait in the backlog
+        if (accepting) {
+            polls[count].fd = listener;
+            polls[count++].events = POLLIN;
+        }
+        int first = count;
+        for (int i = 0; i < server.idleCount; i++) {
+            polls[count].fd = server.idle[i]->fd;
+            polls[count++].events = POLLIN;
+        }
+        if (poll(polls, count, -1) <= 0) {
+            continue;  // Interrupted by a signal
+        }
+
+        // Clients with input (or that hung up) go to the workers
+        int idleCount = 0;
+        for (int i = 0; i < server.idleCount; i++) {
+            if (polls[first + i].revents != 0) {
+                serverQueue(server.idle[i]);
+            } else {
+                server.idle[idleCount++] = server.idle[i];
+            }
+        }
+        server.idleCount = idleCount;
+
+        if (polls[0].revents != 0) {
+            ServerSession *returned[64];
+            long bytes = read(server.wake[0], returned, sizeof(returned));
+            for (long i = 0; i < bytes / (long)sizeof(returned[0]); i++) {
+                serverReturn(returned[i]);
+            }
+        }
+        if (accepting && polls[1].revents != 0) {
+            int client = accept(listener, NULL, NULL);
+            ServerSession *session = client >= 0 ? serverSessionOpen(client) : NULL;
+            if (session != NULL) {
+                server.idle[server.idleCount++] = session;
+                server.clientCount++;
+            } else if (client >= 0) {
+                close(client);
+            }
+        }
+    }
+
+    // Wait for the running command, then leave the journal committed
+    close(listener);
+    pthread_rwlock_wrlock(&server.lock);
+    journalIdle();
+    appointmentStoreSync();
+    unlink(path);
+    printf("Server stopped.\n");
+    return 0;
+}
+
+// Functions of the load test
 
 /*
- * Function to remove a patient from the system.
- * This function performs the following:
- * - Prompts the user for the patient ID to remove
- * - Displays the patient's bill before removal
- * - Removes the patient from the list by shifting subsequent entries
- * - Decrements the patient count to reflect the removal
- * If the patient ID is invalid, an error message is displayed.
+ * Functions of the load test, which measures a running server.
+ * Started with 'hospital --load-test SOCKET CLIENTS REQUESTS [WRITE_PERCENT]'. Each of CLIENTS threads
+ * connects to the server and sends REQUESTS commands one at a time, waiting for each reply. WRITE_PERCENT
+ * percent of them (10 by default) add or remove a patient of the client's own; the others count patients,
+ * search names and look for a free room. The latencies of reads and writes are reported as in the
+ * benchmark, with the overall number of requests per second.
  */
 
-void removePatient() {
-    printf("Enter the patient ID to remove: ");
-    int patientID = readInteger();
+// Function to connect to the server
+int loadTestConnect(const char *path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection >= 0 && connect(connection, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(connection);
+        return -1;
+    }
+    return connection;
+}
 
-    if (patientID >= 0 && patientID < patientCount) {
-        // Display the bill for the patient
-        int bill = calculateBill(&patients[patientID]);
-        printf("Patient: %s\n", patients[patientID].name);
-        printf("Room Charge: 100\n");  // Example room charge
-        printf("Doctor's Fee: %d\n", doctors[patients[patientID].doctorID].visitingFees);
-        printf("Total Bill: %d\n", bill);
+// Function to send one command and wait for its status line
+int loadTestRequest(FILE *sender, FILE *receiver, const char *command) {
+    char line[OUTPUT_LINE_SIZE], status[32];
+    int lineNumber;
+    if (fprintf(sender, "%s\n", command) < 0 || fflush(sender) != 0) {
+        return STATUS_IO_ERROR;
+    }
+    while (fgets(line, sizeof(line), receiver) != NULL) {
+        if (sscanf(line, "%d %31s", &lineNumber, status) == 2) {
+            for (int i = 0; i < (int)(sizeof(statusNames) / sizeof(statusNames[0])); i++) {
+                if (strcmp(status, statusNames[i]) == 0) {
+                    return i;
+                }
+            }
+        }
+    }
+    return STATUS_IO_ERROR;
+}
 
-        // Remove the patient by shifting subsequent entries
-        for (int i = patientID; i < patientCount - 1; i++) {
-            patients[i] = patients[i + 1];
+// Function to open the streams of a connection to the server
+int loadTestOpen(const char *path, FILE **sender, FILE **receiver) {
+    int connection = loadTestConnect(path);
+    if (connection < 0) {
+        return 0;
+    }
+    int copy = dup(connection);
+    *sender = copy >= 0 ? fdopen(copy, "w") : NULL;
+    *receiver = fdopen(connection, "r");
+    if (*sender == NULL || *receiver == NULL) {
+        if (*sender != NULL) {
+            fclose(*sender);
+        } else if (copy >= 0) {
+            close(copy);
+        }
+        if (*receiver != NULL) {
+            fclose(*receiver);
+        } else {
+            close(connection);
         }
-        patientCount--;
+        return 0;
+    }
+    return 1;
+}
 
-        printf("Patient removed successfully!\n");
-    } else {
-        printf("Invalid patient ID.\n");
+// Function run by each client of the load test
+
+/**
+ * @brief Sends the client's requests one at a time and times each until its status line arrives.
+ * 
+ * Writes alternate between adding a patient named after the client and the request 
+ * (in a room of its own) and removing it again, so the data ends as it started.
+ */
+
+void *loadTestThread(void *argument) {
+    LoadTestClient *client = argument;
+    char command[256];
+    int added = 0;  // 1 while the client's last patient has not been removed
+
+    for (int i = 0; i < client->requestCount; i++) {
+        int write = (int)(((unsigned int)i * 2654435761u + (unsigned int)client->number) % 100) < client->writePercent;
+        if (write && !added) {
+            int room = LOAD_TEST_FIRST_ROOM + (int)(((long long)client->number * client->requestCount + i) % LOAD_TEST_ROOMS);
+            snprintf(command, sizeof(command), "add-patient LoadTest%d_%d 30 Flu %d LoadTestDoctor", client->number, i, room);
+            client->lastPatient = i;
+        } else if (write) {
+            snprintf(command, sizeof(command), "remove-patient LoadTest%d_%d", client->number, client->lastPatient);
+        } else if (i % 3 == 0) {
+            snprintf(command, sizeof(command), "count-patients 20 60 * * *");
+        } else if (i % 3 == 1) {
+            snprintf(command, sizeof(command), "search name prefix LoadTest%d_", client->number);
+        } else {
+            snprintf(command, sizeof(command), "free-room *");
+        }
+
+        long long start = benchNow();
+        int status = loadTestRequest(client->sender, client->receiver, command);
+        benchSample(write ? &client->writes : &client->reads, start);
+        if (status == STATUS_IO_ERROR) {
+            client->errors += client->requestCount - i;  // The connection is gone
+            break;
+        }
+        if (write) {
+            added = !added;
+        }
+        if (status != STATUS_OK) {
+            client->errors++;
+        }
+    }
+    if (added) {
+        snprintf(command, sizeof(command), "remove-patient LoadTest%d_%d", client->number, client->lastPatient);
+        loadTestRequest(client->sender, client->receiver, command);  // Untimed, to leave the data as it was
+    }
+
+    // Hang up at once, so the worker serving this client can take a waiting one
+    fclose(client->sender);
+    fclose(client->receiver);
+    client->sender = client->receiver = NULL;
+    return NULL;
+}
+
+// Function to run the load test
+
+/**
+ * @brief Runs 'clients' clients against the server at 'path' and reports the latencies 
+ * of reads and writes and the overall throughput.
+ * 
+ * @return 0 if every request succeeded, 1 otherwise.
+ */
+
+int runLoadTest(const char *path, int clients, int requests, int writePercent) {
+    LoadTestClient *threads = calloc(clients, sizeof(LoadTestClient));
+    BenchResult results[2];
+    if (threads == NULL || !benchBegin(&results[0], "read", clients * requests) ||
+        !benchBegin(&results[1], "write", clients * requests)) {
+        fprintf(stderr, "Not enough memory for the load test.\n");
+        return 1;
+    }
+
+    // Make sure the doctor of the test patients exists (the reply is DUPLICATE when it does)
+    FILE *sender, *receiver;
+    if (!loadTestOpen(path, &sender, &receiver)) {
+        fprintf(stderr, "Could not connect to %s.\n", path);
+        return 1;
+    }
+    loadTestRequest(sender, receiver, "add-doctor LoadTestDoctor 40 General 100");
+    fclose(sender);
+    fclose(receiver);
+
+    // Connect every client before starting the clock
+    int errors = 0;
+    for (int i = 0; i < clients; i++) {
+        LoadTestClient *client = &threads[i];
+        client->number = i;
+        client->requestCount = requests;
+        client->writePercent = writePercent;
+        if (!loadTestOpen(path, &client->sender, &client->receiver)) {
+            fprintf(stderr, "Could not connect client %d to %s.\n", i, path);
+            errors += requests;
+        } else if (!benchBegin(&client->reads, "read", requests) || !benchBegin(&client->writes, "write", requests)) {
+            errors += requests;
+        }
+    }
+    long long started = benchNow();
+    int running = 0;
+    for (int i = 0; i < clients; i++) {
+        LoadTestClient *client = &threads[i];
+        if (client->reads.samples != NULL && client->writes.samples != NULL &&
+            pthread_create(&client->thread, NULL, loadTestThread, client) == 0) {
+            client->started = 1;
+            running++;
+        }
+    }
+    for (int i = 0; i < clients; i++) {
+        if (threads[i].started) {
+            pthread_join(threads[i].thread, NULL);
+        }
+    }
+    long long elapsed = benchNow() - started;
+
+    // Merge the latencies of all clients
+    for (int i = 0; i < clients; i++) {
+        LoadTestClient *client = &threads[i];
+        BenchResult *parts[2] = {&client->reads, &client->writes};
+        for (int r = 0; r < 2; r++) {
+            if (parts[r]->samples != NULL) {
+                memcpy(results[r].samples + results[r].count, parts[r]->samples, parts[r]->count * sizeof(long long));
+                results[r].count += parts[r]->count;
+                results[r].total += parts[r]->total;
+                free(parts[r]->samples);
+            }
+        }
+        errors += client->errors;
+        if (client->sender != NULL) {
+            fclose(client->sender);  // A client whose thread did not start
+            fclose(client->receiver);
+        }
     }
-}
\ No newline at end of file
+    int served = results[0].count + results[1].count;
+    benchEnd(&results[0]);
+    benchEnd(&results[1]);
+
+    char title[64];
+    snprintf(title, sizeof(title), "Load Test Results (%d clients)", running);
+    benchReport(results, 2, title);
+    printf("%d request(s) in %.3f seconds: %.1f requests per second, %d failed.\n", served, elapsed / 1e9,
+           elapsed > 0 ? served * 1e9 / elapsed : 0.0, errors);
+    free(threads);
+    return errors > 0 ? 1 : 0;
+}
+#endif